@@ -0,0 +1,46 @@
+#include "core/contact_sheet.h"
+
+#include <algorithm>
+
+contact_sheet::contact_sheet(int thumbnail_width, int thumbnail_height, int capacity, texture_array::content kind)
+	: thumbnails(thumbnail_width, thumbnail_height, capacity, kind), count(0), next(0)
+{
+}
+
+void contact_sheet::advance()
+{
+	next  = (next + 1) % thumbnails.get_layers();
+	count = std::min(count + 1, thumbnails.get_layers());
+}
+
+void contact_sheet::push(const cv::Mat &frame)
+{
+	thumbnails.upload(next, frame);
+	advance();
+}
+
+void contact_sheet::push(const texture &frame)
+{
+	thumbnails.copy_from(frame, next);
+	advance();
+}
+
+void contact_sheet::layout(quad_batch &batch, float x, float y, float width, float height, int columns) const
+{
+	if(count == 0 || columns <= 0)
+	{
+		return;
+	}
+
+	float cell_width  = width / columns;
+	float cell_height = cell_width * thumbnails.get_height() / thumbnails.get_width();
+	int rows		  = std::max(1, static_cast<int>(height / cell_height));
+	int shown		  = std::min(count, rows * columns);
+
+	int layers = thumbnails.get_layers();
+	for(int i = 0; i < shown; i++)
+	{
+		int layer = (next - 1 - i + layers) % layers;
+		batch.add(thumbnails, layer, x + (i % columns) * cell_width, y + (i / columns) * cell_height, cell_width, cell_height);
+	}
+}
\ No newline at end of file
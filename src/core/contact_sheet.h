@@ -0,0 +1,49 @@
+#ifndef CORE_CONTACT_SHEET_H
+#define CORE_CONTACT_SHEET_H
+
+#include "core/quad_batch.h"
+#include "core/shader.h"
+#include "core/texture_array.h"
+
+#include <opencv2/core.hpp>
+
+/*
+ * The last frames as thumbnails in a ring of texture array layers,
+ * laid out as a grid through a quad_batch.
+ */
+class contact_sheet
+{
+private:
+	texture_array thumbnails;
+	int count; // filled layers
+	int next;  // layer the next frame goes to
+
+	void advance();
+
+public:
+	contact_sheet(int thumbnail_width, int thumbnail_height, int capacity, texture_array::content kind = texture_array::content::colour);
+
+	/* Add the newest frame, the oldest one is dropped once the sheet is full */
+	void push(const cv::Mat &frame);
+	void push(const texture &frame);
+
+	/* Newest first, row by row, columns thumbnails per row at the thumbnail aspect ratio */
+	void layout(quad_batch &batch, float x, float y, float width, float height, int columns) const;
+
+	void clear()
+	{
+		count = 0;
+		next  = 0;
+	}
+
+	int get_count() const
+	{
+		return count;
+	}
+	int get_capacity() const
+	{
+		return thumbnails.get_layers();
+	}
+};
+
+#endif // CORE_CONTACT_SHEET_H
\ No newline at end of file
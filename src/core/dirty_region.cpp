@@ -0,0 +1,107 @@
+#include "core/dirty_region.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+dirty_region::dirty_region(int width, int height, int tile_size)
+	: width(width), height(height), tile_size(tile_size), columns(0), rows(0), dirty_tiles(0)
+{
+	if(width <= 0 || height <= 0 || tile_size <= 0)
+	{
+		throw std::runtime_error("Dirty region needs a positive size and tile size");
+	}
+
+	columns = (width + tile_size - 1) / tile_size;
+	rows	= (height + tile_size - 1) / tile_size;
+	tiles.assign(static_cast<std::size_t>(columns) * rows, 0);
+}
+
+void dirty_region::add(const cv::Rect &rect)
+{
+	cv::Rect clipped = rect & cv::Rect(0, 0, width, height);
+	if(clipped.empty())
+	{
+		return;
+	}
+
+	int first_column = clipped.x / tile_size;
+	int last_column	 = (clipped.x + clipped.width - 1) / tile_size;
+	int first_row	 = clipped.y / tile_size;
+	int last_row	 = (clipped.y + clipped.height - 1) / tile_size;
+	for(int row = first_row; row <= last_row; row++)
+	{
+		for(int column = first_column; column <= last_column; column++)
+		{
+			unsigned char &tile = tiles[static_cast<std::size_t>(row) * columns + column];
+			dirty_tiles += tile == 0;
+			tile = 1;
+		}
+	}
+}
+
+void dirty_region::add_all()
+{
+	std::fill(tiles.begin(), tiles.end(), 1);
+	dirty_tiles = tiles.size();
+}
+
+void dirty_region::clear()
+{
+	std::fill(tiles.begin(), tiles.end(), 0);
+	dirty_tiles = 0;
+}
+
+void dirty_region::take(std::vector<cv::Rect> &rectangles)
+{
+	rectangles.clear();
+	if(dirty_tiles == 0)
+	{
+		return;
+	}
+
+	// Merged in tile units, a run continues the rectangle above it if it spans the same columns
+	open.clear();
+	for(int row = 0; row < rows; row++)
+	{
+		next_open.clear();
+		const unsigned char *line = &tiles[static_cast<std::size_t>(row) * columns];
+		for(int column = 0; column < columns;)
+		{
+			if(!line[column])
+			{
+				column++;
+				continue;
+			}
+
+			int first = column;
+			while(column < columns && line[column])
+			{
+				column++;
+			}
+
+			auto above = std::find_if(
+				open.begin(),
+				open.end(),
+				[&](std::size_t index) { return rectangles[index].x == first && rectangles[index].width == column - first; });
+			if(above != open.end())
+			{
+				rectangles[*above].height++;
+				next_open.push_back(*above);
+			}
+			else
+			{
+				rectangles.emplace_back(first, row, column - first, 1);
+				next_open.push_back(rectangles.size() - 1);
+			}
+		}
+		open.swap(next_open);
+	}
+
+	for(cv::Rect &rect : rectangles)
+	{
+		rect = cv::Rect(rect.x * tile_size, rect.y * tile_size, rect.width * tile_size, rect.height * tile_size) &
+			   cv::Rect(0, 0, width, height);
+	}
+
+	clear();
+}
\ No newline at end of file
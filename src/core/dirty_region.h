@@ -0,0 +1,55 @@
+#ifndef CORE_DIRTY_REGION_H
+#define CORE_DIRTY_REGION_H
+
+#include <cstddef>
+#include <opencv2/core.hpp>
+#include <vector>
+
+/*
+ * Changed areas of a CPU-side image, tracked on a grid of tiles.
+ * Drawing code marks what it touched with add(), take() merges the marked tiles into few
+ * rectangles (runs of tiles in a row, then equal runs of consecutive rows) and starts over.
+ * Uploading only those rectangles keeps a mostly static overlay from costing a full frame upload.
+ */
+class dirty_region
+{
+private:
+	int width, height;
+	int tile_size;
+	int columns, rows;
+	std::vector<unsigned char> tiles;
+	std::size_t dirty_tiles;
+
+	std::vector<std::size_t> open, next_open; // merged rectangles ending on the previous row
+
+public:
+	dirty_region(int width, int height, int tile_size = 64);
+
+	/* Mark the tiles the rectangle touches, clipped to the image */
+	void add(const cv::Rect &rect);
+	void add_all();
+	void clear();
+
+	/* Merged dirty rectangles in pixels, the region is clean afterwards */
+	void take(std::vector<cv::Rect> &rectangles);
+
+	bool empty() const
+	{
+		return dirty_tiles == 0;
+	}
+	/* Share of the image marked, 0 to 1 */
+	double get_coverage() const
+	{
+		return static_cast<double>(dirty_tiles) / tiles.size();
+	}
+	int get_width() const
+	{
+		return width;
+	}
+	int get_height() const
+	{
+		return height;
+	}
+};
+
+#endif // CORE_DIRTY_REGION_H
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "core/flow_runner.h"
+
+#include "core/frame_recorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+
+flow_runner::flow_runner(thread_pool &pool, std::size_t memory_budget)
+	: pool(pool), dis(pool.get_thread_count()), memory_budget(memory_budget), memory_used(0), peak_memory(0)
+{
+}
+
+std::size_t flow_runner::get_pair_memory(int width, int height)
+{
+	// The newer gray frame, the CV_32FC2 field, the BGR visualization and about twice the field
+	// in Farneback's or DIS's pyramids and buffers
+	return static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * (1 + 8 + 3 + 16);
+}
+
+bool flow_runner::try_reserve(std::size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(memory_mutex);
+	if(memory_budget > 0 && memory_used + bytes > memory_budget)
+	{
+		return false;
+	}
+	memory_used += bytes;
+	peak_memory = std::max(peak_memory, memory_used);
+	return true;
+}
+
+void flow_runner::reserve(std::size_t bytes)
+{
+	std::unique_lock<std::mutex> lock(memory_mutex);
+	memory_condition.wait(lock, [&]() { return memory_budget == 0 || memory_used + bytes <= memory_budget; });
+	memory_used += bytes;
+	peak_memory = std::max(peak_memory, memory_used);
+}
+
+void flow_runner::release(std::size_t bytes)
+{
+	{
+		std::lock_guard<std::mutex> lock(memory_mutex);
+		memory_used -= bytes;
+	}
+	memory_condition.notify_all();
+}
+
+std::size_t flow_runner::get_peak_memory()
+{
+	std::lock_guard<std::mutex> lock(memory_mutex);
+	return peak_memory;
+}
+
+cv::Mat flow_runner::colourize(const cv::Mat &flow, float max_magnitude)
+{
+	cv::Mat parts[2], magnitude, angle;
+	cv::split(flow, parts);
+	cv::cartToPolar(parts[0], parts[1], magnitude, angle, true);
+	magnitude.convertTo(magnitude, CV_32F, 1.0 / max_magnitude);
+	cv::min(magnitude, 1.0, magnitude);
+
+	cv::Mat hsv, bgr;
+	cv::Mat channels[3] = {angle, cv::Mat::ones(angle.size(), CV_32F), magnitude};
+	cv::merge(channels, 3, hsv);
+	cv::cvtColor(hsv, bgr, cv::COLOR_HSV2BGR);
+	bgr.convertTo(bgr, CV_8U, 255.0);
+	return bgr;
+}
+
+cv::Mat flow_runner::compute(const options &settings, const cv::Mat &previous, const cv::Mat &next, std::size_t index)
+{
+	cv::Mat flow;
+	if(settings.method == method::dis)
+	{
+		// Tasks of different runs on one worker never overlap, OpenCV's loops stay on the worker
+		cv::Ptr<cv::DISOpticalFlow> &instance = dis[pool.get_worker_index()];
+		if(!instance)
+		{
+			instance = cv::DISOpticalFlow::create(cv::DISOpticalFlow::PRESET_MEDIUM);
+		}
+		instance->calc(previous, next, flow);
+	}
+	else
+	{
+		cv::calcOpticalFlowFarneback(previous, next, flow, 0.5, 3, 15, 3, 5, 1.2, 0);
+	}
+
+	if(!settings.archive.empty())
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "flow_%06zu.flo", index);
+		std::string path = (std::filesystem::path(settings.archive) / name).string();
+		if(!cv::writeOpticalFlow(path, flow))
+		{
+			throw std::runtime_error("Can't write " + path);
+		}
+	}
+
+	if(settings.video.empty())
+	{
+		return cv::Mat();
+	}
+	return colourize(flow, settings.max_magnitude);
+}
+
+flow_runner::result flow_runner::run(const options &settings, const std::atomic<bool> *stop)
+{
+	cv::VideoCapture capture(settings.input);
+	if(!capture.isOpened())
+	{
+		throw std::runtime_error("Can't open " + settings.input);
+	}
+	const double fps = capture.get(cv::CAP_PROP_FPS) > 0.0 ? capture.get(cv::CAP_PROP_FPS) : 30.0;
+
+	cv::Mat frame, previous;
+	capture >> frame;
+	if(frame.empty())
+	{
+		throw std::runtime_error("Can't read the first frame of " + settings.input);
+	}
+	cv::cvtColor(frame, previous, cv::COLOR_BGR2GRAY);
+
+	result totals;
+	totals.width  = frame.cols;
+	totals.height = frame.rows;
+
+	if(!settings.archive.empty())
+	{
+		std::filesystem::create_directories(settings.archive);
+	}
+	/* Blocks instead of dropping, every pair ends up in the video */
+	std::unique_ptr<frame_recorder> recorder;
+	if(!settings.video.empty())
+	{
+		recorder = std::make_unique<frame_recorder>(settings.video, fps, frame_recorder::backpressure::block);
+	}
+
+	const std::size_t pairs_in_flight = settings.pairs_in_flight > 0 ? settings.pairs_in_flight : 2 * pool.get_thread_count();
+	// A pair larger than the whole budget still runs, alone
+	const std::size_t pair_memory =
+		memory_budget > 0 ? std::min(memory_budget, get_pair_memory(frame.cols, frame.rows)) : get_pair_memory(frame.cols, frame.rows);
+
+	/* Results are taken in the order the pairs were queued, the oldest pair is waited for
+	   before a new one is queued, so pairs_in_flight and the memory budget bound what is alive */
+	std::deque<std::future<cv::Mat>> pending;
+	std::size_t queued = 0;
+	auto retire		   = [&]()
+	{
+		std::future<cv::Mat> oldest = std::move(pending.front());
+		pending.pop_front();
+		cv::Mat visualization;
+		try
+		{
+			visualization = oldest.get();
+		}
+		catch(...)
+		{
+			release(pair_memory);
+			throw;
+		}
+		release(pair_memory);
+		if(recorder)
+		{
+			recorder->push(visualization);
+		}
+		totals.pairs++;
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	try
+	{
+		for(;;)
+		{
+			if(stop && stop->load())
+			{
+				break;
+			}
+			capture >> frame;
+			if(frame.empty())
+			{
+				totals.completed = true;
+				break;
+			}
+			cv::Mat next;
+			cv::cvtColor(frame, next, cv::COLOR_BGR2GRAY);
+
+			if(pending.size() >= pairs_in_flight)
+			{
+				retire();
+			}
+			// Over budget, this run's own oldest pairs make room first, they are the ones it can wait for
+			bool reserved = try_reserve(pair_memory);
+			while(!reserved && !pending.empty())
+			{
+				retire();
+				reserved = try_reserve(pair_memory);
+			}
+			if(!reserved)
+			{
+				reserve(pair_memory);
+			}
+
+			pending.push_back(pool.submit([this, &settings, previous, next, index = queued]() { return compute(settings, previous, next, index); }));
+			previous = next;
+			queued++;
+		}
+		while(!pending.empty())
+		{
+			retire();
+		}
+	}
+	catch(...)
+	{
+		// Queued pairs refer to settings and hold their share of the budget
+		for(std::future<cv::Mat> &queued_pair : pending)
+		{
+			queued_pair.wait();
+			release(pair_memory);
+		}
+		throw;
+	}
+	// The video is finished once the encoder wrote the queued frames, a frame it couldn't write
+	// leaves the video incomplete
+	if(recorder)
+	{
+		frame_recorder::statistics recorded = recorder->finish();
+		recorder.reset();
+		if(recorded.failed > 0 || recorded.encoded != totals.pairs)
+		{
+			throw std::runtime_error(
+				"Can't write " + settings.video + ", " + std::to_string(recorded.encoded) + " of " + std::to_string(totals.pairs)
+				+ " frames encoded");
+		}
+	}
+	totals.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if(!totals.completed)
+	{
+		spdlog::info("{}: stopped after {} pairs", settings.input, totals.pairs);
+	}
+	return totals;
+}
\ No newline at end of file
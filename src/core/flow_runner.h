@@ -0,0 +1,92 @@
+#ifndef CORE_FLOW_RUNNER_H
+#define CORE_FLOW_RUNNER_H
+
+#include "core/thread_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <opencv2/video.hpp>
+#include <string>
+#include <vector>
+
+/*
+ * Dense flow of whole video files on a thread_pool. The flow of frames i and i + 1 doesn't
+ * depend on any other pair, so run() decodes ahead on the calling thread and spreads the pairs
+ * over the workers. Results are written in frame order to a directory of .flo files and/or a
+ * visualization video.
+ * Several threads can call run() at the same time to process several videos on one pool. The
+ * frames and fields in flight of all of them are kept under one memory budget.
+ */
+class flow_runner
+{
+public:
+	enum class method
+	{
+		farneback,
+		dis
+	};
+
+	struct options
+	{
+		std::string input;
+		std::string video;	 // visualization, none if empty
+		std::string archive; // directory of flow_000000.flo and on, none if empty
+		flow_runner::method method = flow_runner::method::farneback;
+		/* Pairs queued at most, 0 - twice the pool's threads */
+		std::size_t pairs_in_flight = 0;
+		/* Flow magnitude (in pixels) shown at full brightness, as in flow_view */
+		float max_magnitude = 16.0f;
+	};
+
+	struct result
+	{
+		int width = 0, height = 0;
+		std::size_t pairs = 0;
+		double seconds	  = 0.0;
+		bool completed	  = false; // false if stopped before the end of the video
+	};
+
+private:
+	thread_pool &pool;
+
+	/* DIS keeps buffers between calls, every worker has an instance of its own */
+	std::vector<cv::Ptr<cv::DISOpticalFlow>> dis;
+
+	std::size_t memory_budget;
+	std::size_t memory_used;
+	std::size_t peak_memory;
+	std::mutex memory_mutex;
+	std::condition_variable memory_condition;
+
+	bool try_reserve(std::size_t bytes);
+	void reserve(std::size_t bytes);
+	void release(std::size_t bytes);
+
+	/* Flow of one pair, written to the archive, and its visualization if one is wanted */
+	cv::Mat compute(const options &settings, const cv::Mat &previous, const cv::Mat &next, std::size_t index);
+
+public:
+	/* memory_budget - bytes the pairs in flight of all runs may take, 0 - unbounded */
+	explicit flow_runner(thread_pool &pool, std::size_t memory_budget = 0);
+
+	flow_runner(const flow_runner &)			= delete;
+	flow_runner &operator=(const flow_runner &) = delete;
+
+	/* Process a whole video. Checks stop between frames, if given. Throws std::runtime_error
+	   if the video can't be read or an output can't be written */
+	result run(const options &settings, const std::atomic<bool> *stop = nullptr);
+
+	/* Bytes a pair of frames of width x height is counted as while in flight */
+	static std::size_t get_pair_memory(int width, int height);
+
+	/* Highest number of bytes reserved for pairs in flight at once */
+	std::size_t get_peak_memory();
+
+	/* CPU version of flow_view's hsv map: hue is the direction, value the magnitude up to max_magnitude */
+	static cv::Mat colourize(const cv::Mat &flow, float max_magnitude);
+};
+
+#endif // CORE_FLOW_RUNNER_H
\ No newline at end of file
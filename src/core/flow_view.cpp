@@ -0,0 +1,143 @@
+#include "core/flow_view.h"
+
+#include "core/gl_state.h"
+#include "core/shader.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	// Full viewport quad built from gl_VertexID, no vertex buffer needed
+	const std::string flow_vertex_shader = "#version 330 core\n"
+										   "\n"
+										   "out vec2 v_TexCoord;\n"
+										   "\n"
+										   "void main() {\n"
+										   "	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+										   "	// Row 0 of the cv::Mat is the top of the image\n"
+										   "	v_TexCoord = vec2(corner.x, 1.0 - corner.y);\n"
+										   "	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);\n"
+										   "}\n";
+
+	const std::string flow_fragment_shader = "#version 330 core\n"
+											 "\n"
+											 "layout(location = 0) out vec4 color;\n"
+											 "\n"
+											 "in vec2 v_TexCoord;\n"
+											 "\n"
+											 "uniform sampler2D u_Flow;\n"
+											 "uniform float u_MaxMagnitude;\n"
+											 "uniform int u_ColourMap;\n"
+											 "\n"
+											 "vec3 hsv_to_rgb(vec3 c)\n"
+											 "{\n"
+											 "	vec4 k = vec4(1.0, 2.0 / 3.0, 1.0 / 3.0, 3.0);\n"
+											 "	vec3 p = abs(fract(c.xxx + k.xyz) * 6.0 - k.www);\n"
+											 "	return c.z * mix(k.xxx, clamp(p - k.xxx, 0.0, 1.0), c.y);\n"
+											 "}\n"
+											 "\n"
+											 "void main()\n"
+											 "{\n"
+											 "	vec2 flow = texture(u_Flow, v_TexCoord).xy;\n"
+											 "	float magnitude = clamp(length(flow) / u_MaxMagnitude, 0.0, 1.0);\n"
+											 "	if(u_ColourMap == 1)\n"
+											 "	{\n"
+											 "		color = vec4(vec3(magnitude), 1.0);\n"
+											 "		return;\n"
+											 "	}\n"
+											 "	float hue = fract(atan(flow.y, flow.x) / 6.28318530718 + 1.0);\n"
+											 "	color = vec4(hsv_to_rgb(vec3(hue, 1.0, magnitude)), 1.0);\n"
+											 "}\n";
+
+	constexpr std::uint64_t u_flow			= name_hash("u_Flow");
+	constexpr std::uint64_t u_max_magnitude = name_hash("u_MaxMagnitude");
+	constexpr std::uint64_t u_colour_map	= name_hash("u_ColourMap");
+} // namespace
+
+flow_view::flow_view(shader_manager &shaders, bool half_float)
+	: program(shaders.get_program("flow_view", flow_vertex_shader, flow_fragment_shader)),
+	  flow_texture(0),
+	  vao(0),
+	  width(0),
+	  height(0),
+	  half_float(half_float),
+	  max_magnitude(16.0f),
+	  map(colour_map::hsv)
+{
+	glGenVertexArrays(1, &vao);
+
+	glGenTextures(1, &flow_texture);
+	gl_state::get().bind_texture(GL_TEXTURE_2D, flow_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+flow_view::~flow_view()
+{
+	gl_state::get().forget_texture(flow_texture);
+	gl_state::get().forget_vertex_array(vao);
+	glDeleteTextures(1, &flow_texture);
+	glDeleteVertexArrays(1, &vao);
+}
+
+void flow_view::upload(const cv::Mat &flow)
+{
+	if(flow.empty() || flow.type() != CV_32FC2)
+	{
+		throw std::runtime_error("Flow field must be a non-empty CV_32FC2 matrix");
+	}
+
+	const cv::Mat *source = &flow;
+	GLenum data_type	  = GL_FLOAT;
+	if(half_float)
+	{
+		flow.convertTo(half_buffer, CV_16F);
+		source	  = &half_buffer;
+		data_type = GL_HALF_FLOAT;
+	}
+
+	gl_state::get().bind_texture(GL_TEXTURE_2D, flow_texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(source->step[0] / source->elemSize()));
+
+	if(flow.cols != width || flow.rows != height)
+	{
+		width  = flow.cols;
+		height = flow.rows;
+		glTexImage2D(
+			GL_TEXTURE_2D, 0, half_float ? GL_RG16F : GL_RG32F, width, height, 0, GL_RG, data_type, source->ptr());
+	}
+	else
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RG, data_type, source->ptr());
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	GLenum error = glGetError();
+	if(error != GL_NO_ERROR)
+	{
+		throw std::runtime_error("OpenGL error after flow field upload: " + std::to_string(error));
+	}
+}
+
+void flow_view::draw() const
+{
+	if(width == 0 || height == 0)
+	{
+		return;
+	}
+
+	program.set(u_flow, 0);
+	program.set(u_max_magnitude, max_magnitude);
+	program.set(u_colour_map, static_cast<int>(map));
+	program.use();
+	gl_state::get().active_texture(0);
+	gl_state::get().bind_texture(GL_TEXTURE_2D, flow_texture);
+
+	gl_state::get().bind_vertex_array(vao);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
\ No newline at end of file
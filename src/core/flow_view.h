@@ -0,0 +1,74 @@
+#ifndef CORE_FLOW_VIEW_H
+#define CORE_FLOW_VIEW_H
+
+// clang-format off
+#include <GL/glew.h>
+#include <GL/gl.h>
+// clang-format on
+
+#include "core/shader_manager.h"
+
+#include <opencv2/core.hpp>
+
+/*
+ * Dense optical flow visualization on the GPU.
+ * The raw CV_32FC2 flow field is uploaded as an RG32F (or RG16F) texture and
+ * the magnitude/angle -> HSV -> RGB conversion is done in the fragment shader,
+ * so recolouring or rescaling costs nothing on the CPU.
+ */
+class flow_view
+{
+public:
+	enum class colour_map
+	{
+		hsv		  = 0, // hue = direction, value = magnitude (same as the OpenCV sample)
+		magnitude = 1  // grayscale magnitude only
+	};
+
+private:
+	shader_program &program;
+	GLuint flow_texture;
+	GLuint vao;
+
+	int width, height;
+	bool half_float;
+	float max_magnitude;
+	colour_map map;
+
+	cv::Mat half_buffer;
+
+public:
+	/* half_float - store the field as RG16F, halves the upload size */
+	flow_view(shader_manager &shaders, bool half_float = false);
+	~flow_view();
+
+	flow_view(const flow_view &)			= delete;
+	flow_view &operator=(const flow_view &) = delete;
+
+	/* Upload a CV_32FC2 flow field, the texture is reallocated only when the size changes */
+	void upload(const cv::Mat &flow);
+
+	/* Draw the flow field over the current viewport */
+	void draw() const;
+
+	/* Flow magnitude (in pixels) that maps to full brightness */
+	void set_max_magnitude(float magnitude)
+	{
+		max_magnitude = magnitude;
+	}
+	float get_max_magnitude() const
+	{
+		return max_magnitude;
+	}
+
+	void set_colour_map(colour_map m)
+	{
+		map = m;
+	}
+	colour_map get_colour_map() const
+	{
+		return map;
+	}
+};
+
+#endif // CORE_FLOW_VIEW_H
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "core/frame_pipeline.h"
+
+namespace
+{
+	// Empty reads in a row after which a source counts as gone
+	constexpr std::size_t max_empty_reads = 30;
+} // namespace
+
+void pipeline_loop::post(std::coroutine_handle<> handle)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ready.push_back(handle);
+	}
+	posted.notify_one();
+}
+
+void pipeline_loop::run_until(std::coroutine_handle<> handle)
+{
+	while(!handle.done())
+	{
+		std::coroutine_handle<> next;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			posted.wait(lock, [this]() { return !ready.empty(); });
+			next = ready.front();
+			ready.pop_front();
+		}
+		next.resume();
+	}
+}
+
+frame_generator<pipeline_frame> camera_frames(pipeline_loop &loop, thread_pool &pool, cv::VideoCapture &capture, std::chrono::milliseconds max_age)
+{
+	auto read = [&capture]()
+	{
+		pipeline_frame frame;
+		if(capture.read(frame.image) && !frame.image.empty())
+		{
+			frame.state = pipeline_frame::status::ok;
+		}
+		frame.captured = std::chrono::steady_clock::now();
+		return frame;
+	};
+
+	std::uint64_t index		= 0;
+	std::size_t empty_reads = 0;
+	auto next				= loop.spawn(pool, read);
+	for(;;)
+	{
+		pipeline_frame frame = co_await next;
+		frame.index			 = index++;
+
+		if(frame.is_ok())
+		{
+			empty_reads = 0;
+		}
+		else if(!capture.isOpened() || ++empty_reads >= max_empty_reads)
+		{
+			co_return;
+		}
+
+		// The next frame is read while the consumer works on this one
+		next = loop.spawn(pool, read);
+
+		if(frame.is_ok() && max_age.count() > 0 && std::chrono::steady_clock::now() - frame.captured > max_age)
+		{
+			frame.state = pipeline_frame::status::late;
+		}
+		co_yield std::move(frame);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,477 @@
+#ifndef CORE_FRAME_PIPELINE_H
+#define CORE_FRAME_PIPELINE_H
+
+#include "core/thread_pool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+/*
+ * Coroutine frame pipelines.
+ * A pipeline is a pipeline_task run by a pipeline_loop on the calling thread, so the pipeline's own
+ * code, GL and window calls included, stays on that thread. Heavy stages are handed to a thread_pool
+ * with pipeline_loop::spawn() and awaited, the pipeline resumes on the loop when they are done.
+ * Spawned stages run while the pipeline goes on, awaiting them later overlaps them with its work.
+ * Frames come from a frame_generator: the consumer awaits next(), the producer runs until its next
+ * co_yield and waits there, so a source never runs ahead of the consumer more than it chooses to.
+ */
+
+class pipeline_loop;
+
+/* Value or exception of a finished coroutine */
+template<typename T>
+struct pipeline_result
+{
+	std::variant<std::monostate, T, std::exception_ptr> value;
+
+	void return_value(T result)
+	{
+		value.template emplace<1>(std::move(result));
+	}
+	void unhandled_exception()
+	{
+		value.template emplace<2>(std::current_exception());
+	}
+	T get()
+	{
+		if(value.index() == 2)
+		{
+			std::rethrow_exception(std::get<2>(value));
+		}
+		return std::move(std::get<1>(value));
+	}
+};
+
+template<>
+struct pipeline_result<void>
+{
+	std::exception_ptr error;
+
+	void return_void()
+	{
+	}
+	void unhandled_exception()
+	{
+		error = std::current_exception();
+	}
+	void get()
+	{
+		if(error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+};
+
+/* Lazily started coroutine, runs when awaited or passed to pipeline_loop::run() */
+template<typename T = void>
+class pipeline_task
+{
+public:
+	struct promise_type : pipeline_result<T>
+	{
+		std::coroutine_handle<> continuation = std::noop_coroutine();
+
+		struct final_awaiter
+		{
+			bool await_ready() noexcept
+			{
+				return false;
+			}
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+			{
+				return handle.promise().continuation;
+			}
+			void await_resume() noexcept
+			{
+			}
+		};
+
+		pipeline_task get_return_object()
+		{
+			return pipeline_task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_always initial_suspend() noexcept
+		{
+			return {};
+		}
+		final_awaiter final_suspend() noexcept
+		{
+			return {};
+		}
+	};
+
+private:
+	std::coroutine_handle<promise_type> handle;
+
+	friend class pipeline_loop;
+
+	explicit pipeline_task(std::coroutine_handle<promise_type> handle) : handle(handle)
+	{
+	}
+
+public:
+	pipeline_task(pipeline_task &&other) noexcept : handle(std::exchange(other.handle, nullptr))
+	{
+	}
+	pipeline_task &operator=(pipeline_task &&other) noexcept
+	{
+		if(this != &other)
+		{
+			if(handle)
+			{
+				handle.destroy();
+			}
+			handle = std::exchange(other.handle, nullptr);
+		}
+		return *this;
+	}
+	~pipeline_task()
+	{
+		if(handle)
+		{
+			handle.destroy();
+		}
+	}
+
+	bool await_ready() const noexcept
+	{
+		return false;
+	}
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+	{
+		handle.promise().continuation = awaiting;
+		return handle;
+	}
+	T await_resume()
+	{
+		return handle.promise().get();
+	}
+};
+
+/* Result of a function spawned on a thread_pool. Awaited once, the destructor waits for the function */
+template<typename T>
+class pipeline_pending
+{
+private:
+	using stored = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+	struct state
+	{
+		pipeline_loop *loop;
+		std::mutex mutex;
+		std::condition_variable finished;
+		bool done = false;
+		std::optional<stored> value;
+		std::exception_ptr error;
+		std::coroutine_handle<> waiting;
+	};
+
+	std::shared_ptr<state> shared;
+
+	friend class pipeline_loop;
+
+	explicit pipeline_pending(std::shared_ptr<state> shared) : shared(std::move(shared))
+	{
+	}
+
+	void wait()
+	{
+		if(shared)
+		{
+			std::unique_lock<std::mutex> lock(shared->mutex);
+			shared->finished.wait(lock, [this]() { return shared->done; });
+		}
+	}
+
+public:
+	pipeline_pending(pipeline_pending &&other) noexcept = default;
+	pipeline_pending &operator=(pipeline_pending &&other)
+	{
+		if(this != &other)
+		{
+			wait();
+			shared = std::move(other.shared);
+		}
+		return *this;
+	}
+	~pipeline_pending()
+	{
+		wait();
+	}
+
+	bool is_done() const
+	{
+		std::lock_guard<std::mutex> lock(shared->mutex);
+		return shared->done;
+	}
+
+	bool await_ready() const
+	{
+		return is_done();
+	}
+	bool await_suspend(std::coroutine_handle<> awaiting)
+	{
+		// Finished meanwhile, no need to go through the loop
+		std::lock_guard<std::mutex> lock(shared->mutex);
+		if(shared->done)
+		{
+			return false;
+		}
+		shared->waiting = awaiting;
+		return true;
+	}
+	T await_resume()
+	{
+		if(shared->error)
+		{
+			std::rethrow_exception(shared->error);
+		}
+		if constexpr(!std::is_void_v<T>)
+		{
+			return std::move(*shared->value);
+		}
+	}
+};
+
+/* Runs a pipeline on the calling thread and resumes it there when its pool stages finish */
+class pipeline_loop
+{
+private:
+	std::mutex mutex;
+	std::condition_variable posted;
+	std::deque<std::coroutine_handle<>> ready;
+
+	/* Resume posted coroutines until handle is done */
+	void run_until(std::coroutine_handle<> handle);
+
+public:
+	pipeline_loop() = default;
+
+	pipeline_loop(const pipeline_loop &)			= delete;
+	pipeline_loop &operator=(const pipeline_loop &) = delete;
+
+	/* Resume handle on the loop's thread, from any thread */
+	void post(std::coroutine_handle<> handle);
+
+	/* Run task to the end, returns its value or rethrows its exception */
+	template<typename T>
+	T run(pipeline_task<T> task)
+	{
+		task.handle.resume();
+		run_until(task.handle);
+		return task.handle.promise().get();
+	}
+
+	/* Start function on the pool now, the awaiting pipeline resumes on the loop with its result */
+	template<typename F>
+	pipeline_pending<std::invoke_result_t<std::decay_t<F>>> spawn(thread_pool &pool, F &&function)
+	{
+		using result_type = std::invoke_result_t<std::decay_t<F>>;
+		using pending	  = pipeline_pending<result_type>;
+
+		auto shared	 = std::make_shared<typename pending::state>();
+		shared->loop = this;
+		pool.submit(
+			[shared, function = std::forward<F>(function)]() mutable
+			{
+				std::optional<typename pending::stored> value;
+				std::exception_ptr error;
+				try
+				{
+					if constexpr(std::is_void_v<result_type>)
+					{
+						function();
+						value.emplace();
+					}
+					else
+					{
+						value.emplace(function());
+					}
+				}
+				catch(...)
+				{
+					error = std::current_exception();
+				}
+
+				std::coroutine_handle<> waiting;
+				{
+					std::lock_guard<std::mutex> lock(shared->mutex);
+					shared->value = std::move(value);
+					shared->error = error;
+					shared->done  = true;
+					waiting		  = shared->waiting;
+				}
+				shared->finished.notify_all();
+				if(waiting)
+				{
+					shared->loop->post(waiting);
+				}
+			});
+		return pending(std::move(shared));
+	}
+};
+
+/* Asynchronous generator, next() resumes the producer until its next co_yield */
+template<typename T>
+class frame_generator
+{
+public:
+	struct promise_type
+	{
+		std::optional<T> current;
+		std::coroutine_handle<> consumer = std::noop_coroutine();
+		std::exception_ptr error;
+
+		/* Back to the consumer at co_yield and at the end */
+		struct transfer
+		{
+			bool await_ready() noexcept
+			{
+				return false;
+			}
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+			{
+				return handle.promise().consumer;
+			}
+			void await_resume() noexcept
+			{
+			}
+		};
+
+		frame_generator get_return_object()
+		{
+			return frame_generator(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_always initial_suspend() noexcept
+		{
+			return {};
+		}
+		transfer final_suspend() noexcept
+		{
+			return {};
+		}
+		transfer yield_value(T value)
+		{
+			current = std::move(value);
+			return {};
+		}
+		void return_void()
+		{
+		}
+		void unhandled_exception()
+		{
+			error = std::current_exception();
+		}
+	};
+
+private:
+	std::coroutine_handle<promise_type> handle;
+
+	explicit frame_generator(std::coroutine_handle<promise_type> handle) : handle(handle)
+	{
+	}
+
+public:
+	struct next_awaiter
+	{
+		std::coroutine_handle<promise_type> handle;
+
+		bool await_ready() const noexcept
+		{
+			return handle.done();
+		}
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+		{
+			handle.promise().consumer = awaiting;
+			return handle;
+		}
+		/* The next value, nullopt once the generator has returned */
+		std::optional<T> await_resume()
+		{
+			promise_type &promise = handle.promise();
+			if(promise.error)
+			{
+				std::rethrow_exception(std::exchange(promise.error, nullptr));
+			}
+			std::optional<T> value = std::move(promise.current);
+			promise.current.reset();
+			return value;
+		}
+	};
+
+	frame_generator(frame_generator &&other) noexcept : handle(std::exchange(other.handle, nullptr))
+	{
+	}
+	frame_generator &operator=(frame_generator &&other) noexcept
+	{
+		if(this != &other)
+		{
+			if(handle)
+			{
+				handle.destroy();
+			}
+			handle = std::exchange(other.handle, nullptr);
+		}
+		return *this;
+	}
+	~frame_generator()
+	{
+		if(handle)
+		{
+			handle.destroy();
+		}
+	}
+
+	next_awaiter next()
+	{
+		return next_awaiter {handle};
+	}
+};
+
+/* Frame of a source. Frames that are empty or late are values, not errors */
+struct pipeline_frame
+{
+	enum class status
+	{
+		ok,
+		/* The device returned nothing this time */
+		empty,
+		/* Older than the source's max_age when the consumer asked for it, worth skipping heavy work */
+		late
+	};
+
+	status state = status::empty;
+	cv::Mat image;
+	std::uint64_t index = 0;
+	std::chrono::steady_clock::time_point captured;
+
+	bool is_ok() const
+	{
+		return state == status::ok;
+	}
+};
+
+/* Frames of capture, read on the pool one frame ahead of the consumer.
+   Ends once the device is closed or returned only empty frames for a while.
+   max_age - frames older than that are marked late, 0 - never */
+frame_generator<pipeline_frame> camera_frames(
+	pipeline_loop &loop,
+	thread_pool &pool,
+	cv::VideoCapture &capture,
+	std::chrono::milliseconds max_age = std::chrono::milliseconds(0));
+
+#endif // CORE_FRAME_PIPELINE_H
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "core/frame_pool.h"
+
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace
+{
+	// Spins before yielding, a pop in progress finishes within a few instructions
+	constexpr int push_spins = 64;
+} // namespace
+
+void frame_handle::release()
+{
+	if(pool)
+	{
+		pool->give_back(index);
+		pool = nullptr;
+	}
+}
+
+cv::Mat &frame_handle::get() const
+{
+	return pool->frames[index];
+}
+
+frame_pool::frame_pool(std::size_t count, int rows, int cols, int type) : free_frames(count), exhausted(0)
+{
+	if(count == 0 || count >= UINT32_MAX)
+	{
+		throw std::runtime_error("Frame pool: invalid frame count " + std::to_string(count));
+	}
+
+	frames.reserve(count);
+	for(std::size_t i = 0; i < count; i++)
+	{
+		frames.emplace_back(rows, cols, type);
+		give_back(static_cast<std::uint32_t>(i));
+	}
+}
+
+frame_pool::~frame_pool()
+{
+	if(get_free_count() != frames.size())
+	{
+		spdlog::warn("Frame pool destroyed with {} frames still in use", frames.size() - get_free_count());
+	}
+}
+
+void frame_pool::give_back(std::uint32_t index)
+{
+	// The queue has room for every frame, but a push fails for a moment while a consumer is
+	// between taking a slot and releasing it. A dropped index would lose the frame for good
+	for(int attempt = 0; !free_frames.try_push(std::move(index)); attempt++)
+	{
+		if(attempt >= push_spins)
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+frame_handle frame_pool::try_acquire()
+{
+	std::uint32_t index;
+	if(!free_frames.try_pop(index))
+	{
+		exhausted.fetch_add(1, std::memory_order_relaxed);
+		return frame_handle();
+	}
+	return frame_handle(this, index);
+}
+
+frame_mailbox::~frame_mailbox()
+{
+	take();
+}
+
+void frame_mailbox::publish(frame_handle frame)
+{
+	if(!frame)
+	{
+		return;
+	}
+	if(frame.pool != &pool)
+	{
+		throw std::runtime_error("Frame mailbox: frame of another pool");
+	}
+
+	// The mailbox owns the frame now, the handle must not give it back
+	std::uint32_t index = frame.index;
+	frame.pool			= nullptr;
+
+	std::uint32_t previous = latest.exchange(index, std::memory_order_acq_rel);
+	if(previous != no_frame)
+	{
+		pool.give_back(previous);
+		replaced.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+frame_handle frame_mailbox::take()
+{
+	std::uint32_t index = latest.exchange(no_frame, std::memory_order_acq_rel);
+	if(index == no_frame)
+	{
+		return frame_handle();
+	}
+	return frame_handle(&pool, index);
+}
\ No newline at end of file
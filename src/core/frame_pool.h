@@ -0,0 +1,163 @@
+#ifndef CORE_FRAME_POOL_H
+#define CORE_FRAME_POOL_H
+
+#include "core/frame_queue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <vector>
+
+class frame_pool;
+
+/*
+ * A frame of a frame_pool. Move-only, the frame goes back to the pool when the handle is
+ * destroyed or released, so stages hand frames on through the queues and never free them.
+ * The pool has to outlive its handles.
+ */
+class frame_handle
+{
+	friend class frame_pool;
+	friend class frame_mailbox;
+
+private:
+	frame_pool *pool	= nullptr;
+	std::uint32_t index = 0;
+
+	frame_handle(frame_pool *pool, std::uint32_t index) : pool(pool), index(index)
+	{
+	}
+
+public:
+	frame_handle() = default;
+	frame_handle(frame_handle &&other) noexcept : pool(other.pool), index(other.index)
+	{
+		other.pool = nullptr;
+	}
+	frame_handle &operator=(frame_handle &&other) noexcept
+	{
+		if(this != &other)
+		{
+			release();
+			pool	   = other.pool;
+			index	   = other.index;
+			other.pool = nullptr;
+		}
+		return *this;
+	}
+	~frame_handle()
+	{
+		release();
+	}
+
+	frame_handle(const frame_handle &)			  = delete;
+	frame_handle &operator=(const frame_handle &) = delete;
+
+	/* Give the frame back to the pool now, the handle is empty afterwards */
+	void release();
+
+	explicit operator bool() const
+	{
+		return pool != nullptr;
+	}
+
+	cv::Mat &get() const;
+	cv::Mat &operator*() const
+	{
+		return get();
+	}
+	cv::Mat *operator->() const
+	{
+		return &get();
+	}
+
+	std::uint32_t get_index() const
+	{
+		return index;
+	}
+};
+
+/*
+ * Frames of one size and type allocated up front. try_acquire() takes a free frame without
+ * allocating or locking, the free list is an mpmc_queue of frame indices. Writing into a frame
+ * with the same size and type reuses its buffer, OpenCV's create() doesn't reallocate then.
+ */
+class frame_pool
+{
+	friend class frame_handle;
+	friend class frame_mailbox;
+
+private:
+	std::vector<cv::Mat> frames;
+	mpmc_queue<std::uint32_t> free_frames;
+	std::atomic<std::size_t> exhausted;
+
+	void give_back(std::uint32_t index);
+
+public:
+	/* count frames of rows x cols of type */
+	frame_pool(std::size_t count, int rows, int cols, int type);
+	~frame_pool();
+
+	frame_pool(const frame_pool &)			  = delete;
+	frame_pool &operator=(const frame_pool &) = delete;
+
+	/* A free frame, an empty handle if all frames are in use */
+	frame_handle try_acquire();
+
+	std::size_t get_frame_count() const
+	{
+		return frames.size();
+	}
+
+	/* Approximate while frames are taken and released */
+	std::size_t get_free_count() const
+	{
+		return free_frames.size();
+	}
+
+	/* try_acquire() calls that found no free frame */
+	std::size_t get_exhausted_count() const
+	{
+		return exhausted.load(std::memory_order_relaxed);
+	}
+};
+
+/*
+ * Latest-only slot for a display: publish() replaces the frame held, the replaced frame goes back
+ * to the pool unread, and take() gets the newest one. A slow reader never holds up the writer
+ * and always shows the freshest frame. One atomic exchange per call, no lock.
+ */
+class frame_mailbox
+{
+private:
+	static constexpr std::uint32_t no_frame = UINT32_MAX;
+
+	frame_pool &pool;
+	alignas(cache_line) std::atomic<std::uint32_t> latest;
+	std::atomic<std::size_t> replaced;
+
+public:
+	explicit frame_mailbox(frame_pool &pool) : pool(pool), latest(no_frame), replaced(0)
+	{
+	}
+	~frame_mailbox();
+
+	frame_mailbox(const frame_mailbox &)			= delete;
+	frame_mailbox &operator=(const frame_mailbox &) = delete;
+
+	/* frame has to come from the mailbox's pool */
+	void publish(frame_handle frame);
+
+	/* The newest frame, an empty handle if none was published since the last take() */
+	frame_handle take();
+
+	/* Frames replaced before anyone took them */
+	std::size_t get_replaced_count() const
+	{
+		return replaced.load(std::memory_order_relaxed);
+	}
+};
+
+#endif // CORE_FRAME_POOL_H
\ No newline at end of file
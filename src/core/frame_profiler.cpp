@@ -0,0 +1,207 @@
+#include "core/frame_profiler.h"
+
+#include <stdexcept>
+
+namespace
+{
+	float milliseconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<float, std::milli>(duration).count();
+	}
+} // namespace
+
+frame_profiler::frame_profiler(std::size_t frames_in_flight)
+	: frames(frames_in_flight), current(0), in_frame(false), gpu_timing(GLEW_VERSION_3_3 || GLEW_ARB_timer_query), late_frames(0)
+{
+	if(frames_in_flight == 0)
+	{
+		throw std::runtime_error("Frame profiler needs at least one frame in flight");
+	}
+
+	for(frame &slot : frames)
+	{
+		slot.gpu_reference = 0;
+		slot.last_query	   = 0;
+		slot.pending	   = false;
+	}
+}
+
+frame_profiler::~frame_profiler()
+{
+	for(frame &slot : frames)
+	{
+		if(!slot.queries.empty())
+		{
+			glDeleteQueries(static_cast<GLsizei>(slot.queries.size()), slot.queries.data());
+		}
+	}
+}
+
+void frame_profiler::begin_frame()
+{
+	if(in_frame)
+	{
+		end_frame();
+	}
+
+	// The slot about to be reused is the oldest one, its queries had frames_in_flight frames to finish
+	current		= (current + 1) % frames.size();
+	frame &slot = frames[current];
+	if(slot.pending)
+	{
+		resolve(slot, false);
+	}
+
+	slot.passes.clear();
+	slot.cpu_start = std::chrono::steady_clock::now();
+	if(gpu_timing)
+	{
+		// Returns the GL time once the previous commands reached the GPU, without waiting for them to finish
+		glGetInteger64v(GL_TIMESTAMP, &slot.gpu_reference);
+	}
+	slot.cpu_reference = std::chrono::steady_clock::now();
+	in_frame		   = true;
+}
+
+void frame_profiler::end_frame()
+{
+	if(!in_frame)
+	{
+		return;
+	}
+
+	while(!open.empty())
+	{
+		end();
+	}
+	frames[current].pending = true;
+	in_frame				= false;
+}
+
+void frame_profiler::begin(const char *name)
+{
+	if(!in_frame)
+	{
+		return;
+	}
+
+	frame &slot		  = frames[current];
+	std::size_t index = slot.passes.size();
+	slot.passes.push_back(recorded_pass {name, static_cast<int>(open.size()), std::chrono::steady_clock::now(), {}});
+	open.push_back(index);
+
+	if(gpu_timing)
+	{
+		if(slot.queries.size() < 2 * (index + 1))
+		{
+			slot.queries.resize(2 * (index + 1));
+			glGenQueries(2, &slot.queries[2 * index]);
+		}
+		glQueryCounter(slot.queries[2 * index], GL_TIMESTAMP);
+		slot.last_query = 2 * index;
+	}
+}
+
+void frame_profiler::end()
+{
+	if(!in_frame || open.empty())
+	{
+		return;
+	}
+
+	frame &slot		  = frames[current];
+	std::size_t index = open.back();
+	open.pop_back();
+
+	slot.passes[index].cpu_end = std::chrono::steady_clock::now();
+	if(gpu_timing)
+	{
+		glQueryCounter(slot.queries[2 * index + 1], GL_TIMESTAMP);
+		slot.last_query = 2 * index + 1;
+	}
+}
+
+void frame_profiler::finish()
+{
+	end_frame();
+
+	// Oldest first, the last passes read back are the newest frame's
+	for(std::size_t i = 1; i <= frames.size(); i++)
+	{
+		frame &slot = frames[(current + i) % frames.size()];
+		if(slot.pending)
+		{
+			resolve(slot, true);
+		}
+	}
+}
+
+void frame_profiler::resolve(frame &resolved, bool wait)
+{
+	resolved.pending = false;
+
+	// Queries complete in the order they were issued, the last one issued being available means
+	// all of them are. With nested passes that is an outer pass's end, not the last pass's
+	bool gpu_times = gpu_timing && !resolved.passes.empty();
+	if(gpu_times && !wait)
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(resolved.queries[resolved.last_query], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(!available)
+		{
+			gpu_times = false;
+			late_frames++;
+		}
+	}
+
+	// GL time of a query on the CPU timeline of the frame
+	float gpu_offset = milliseconds(resolved.cpu_reference - resolved.cpu_start);
+	auto gpu_time	 = [&](std::size_t query)
+	{
+		GLuint64 timestamp = 0;
+		glGetQueryObjectui64v(resolved.queries[query], GL_QUERY_RESULT, &timestamp);
+		return gpu_offset + static_cast<float>(static_cast<GLint64>(timestamp) - resolved.gpu_reference) / 1.0e6f;
+	};
+
+	last.resize(resolved.passes.size());
+	for(std::size_t i = 0; i < resolved.passes.size(); i++)
+	{
+		const recorded_pass &recorded = resolved.passes[i];
+		pass &result				  = last[i];
+
+		result.name		  = recorded.name;
+		result.depth	  = recorded.depth;
+		result.cpu_start  = milliseconds(recorded.cpu_begin - resolved.cpu_start);
+		result.cpu_time	  = milliseconds(recorded.cpu_end - recorded.cpu_begin);
+		result.gpu_start  = -1.0f;
+		result.gpu_time	  = -1.0f;
+		if(gpu_times)
+		{
+			result.gpu_start = gpu_time(2 * i);
+			result.gpu_time	 = gpu_time(2 * i + 1) - result.gpu_start;
+		}
+
+		summary *total = nullptr;
+		for(summary &candidate : totals)
+		{
+			if(candidate.name == result.name)
+			{
+				total = &candidate;
+				break;
+			}
+		}
+		if(!total)
+		{
+			totals.emplace_back();
+			total		= &totals.back();
+			total->name = result.name;
+		}
+		total->cpu_time += result.cpu_time;
+		total->frames++;
+		if(gpu_times)
+		{
+			total->gpu_time += result.gpu_time;
+			total->gpu_frames++;
+		}
+	}
+}
\ No newline at end of file
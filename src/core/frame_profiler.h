@@ -0,0 +1,139 @@
+#ifndef CORE_FRAME_PROFILER_H
+#define CORE_FRAME_PROFILER_H
+
+// clang-format off
+#include <GL/glew.h>
+#include <GL/gl.h>
+// clang-format on
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * CPU and GPU time of the named passes of a frame on one timeline.
+ * A pass takes a steady_clock time and a GL_TIMESTAMP query at its begin and end. The queries come
+ * from a ring of per-frame pools and are read back frames_in_flight frames later, when the GPU is
+ * long done with them, so reading them never stalls. Timestamps rather than GL_TIME_ELAPSED because
+ * elapsed queries can't nest and only timestamps place the GPU work next to the CPU stages: the GL
+ * clock is sampled with the CPU clock at the frame start.
+ * All calls are made on the render thread.
+ */
+class frame_profiler
+{
+public:
+	struct pass
+	{
+		std::string name;
+		int depth;					// nesting, 0 for the passes of the frame itself
+		float cpu_start, cpu_time;	// milliseconds, from the frame start
+		float gpu_start, gpu_time;	// on the same clock, negative if there is no GPU time
+	};
+
+	struct summary
+	{
+		std::string name;
+		double cpu_time		   = 0.0; // milliseconds, summed over frames
+		double gpu_time		   = 0.0;
+		std::size_t frames	   = 0;
+		std::size_t gpu_frames = 0; // frames the GPU time was read back for
+	};
+
+	/* Times a pass until the end of the scope */
+	class scope
+	{
+	private:
+		frame_profiler &profiler;
+
+	public:
+		scope(frame_profiler &profiler, const char *name) : profiler(profiler)
+		{
+			profiler.begin(name);
+		}
+		~scope()
+		{
+			profiler.end();
+		}
+
+		scope(const scope &)			= delete;
+		scope &operator=(const scope &) = delete;
+	};
+
+private:
+	struct recorded_pass
+	{
+		const char *name;
+		int depth;
+		std::chrono::steady_clock::time_point cpu_begin, cpu_end;
+	};
+
+	struct frame
+	{
+		std::vector<GLuint> queries; // begin and end timestamp of every pass, grows to the most passes seen
+		std::vector<recorded_pass> passes;
+		std::size_t last_query; // index of the query issued last, an outer pass's end when passes nest
+		std::chrono::steady_clock::time_point cpu_start;
+		std::chrono::steady_clock::time_point cpu_reference;
+		GLint64 gpu_reference; // GL time at cpu_reference
+		bool pending;
+	};
+
+	std::vector<frame> frames;
+	std::size_t current;
+	std::vector<std::size_t> open; // passes begun and not ended yet
+	bool in_frame;
+	bool gpu_timing;
+
+	std::vector<pass> last;
+	std::vector<summary> totals;
+	std::size_t late_frames;
+
+	/* wait - block until the queries are available instead of counting the frame late */
+	void resolve(frame &resolved, bool wait);
+
+public:
+	/* frames_in_flight - frames until the queries of a frame are read back */
+	frame_profiler(std::size_t frames_in_flight = 4);
+	~frame_profiler();
+
+	frame_profiler(const frame_profiler &)			  = delete;
+	frame_profiler &operator=(const frame_profiler &) = delete;
+
+	void begin_frame();
+	/* Passes still open are closed */
+	void end_frame();
+
+	/* End the frame and wait for the queries of the frames still in flight, call before reading
+	   the totals at the end of a run or the last frames_in_flight frames are missing from them */
+	void finish();
+
+	/* name must outlive the frame, string literals are meant */
+	void begin(const char *name);
+	void end();
+
+	/* Passes of the latest frame whose queries were read back */
+	const std::vector<pass> &get_last_passes() const
+	{
+		return last;
+	}
+
+	/* Totals by pass name, in the order the passes were first seen */
+	const std::vector<summary> &get_totals() const
+	{
+		return totals;
+	}
+
+	/* Frames whose queries weren't available in time, their GPU times are missing */
+	std::size_t get_late_frames() const
+	{
+		return late_frames;
+	}
+
+	bool has_gpu_timing() const
+	{
+		return gpu_timing;
+	}
+};
+
+#endif // CORE_FRAME_PROFILER_H
\ No newline at end of file
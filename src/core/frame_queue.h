@@ -0,0 +1,203 @@
+#ifndef CORE_FRAME_QUEUE_H
+#define CORE_FRAME_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/*
+ * Bounded lock-free ring queues for handing frames between pipeline stages.
+ * The capacity is rounded up to a power of two and allocated once, push and pop never allocate
+ * or block: try_push() fails when the queue is full, try_pop() when it is empty, and the caller
+ * decides whether to drop, retry or wait. Indices written by different sides live on different
+ * cache lines so producers and consumers don't invalidate each other's lines.
+ * Meant for cheap movable values like frame_handle, see core/frame_pool.
+ */
+
+constexpr std::size_t cache_line = 64;
+
+/* Smallest power of two holding capacity values */
+inline std::size_t ring_capacity(std::size_t capacity)
+{
+	std::size_t result = 2;
+	while(result < capacity)
+	{
+		result <<= 1;
+	}
+	return result;
+}
+
+/* One producer thread and one consumer thread */
+template<typename T>
+class spsc_queue
+{
+private:
+	const std::size_t mask;
+	std::unique_ptr<T[]> slots;
+
+	// The consumer's line: its index and its last seen copy of the producer's, which saves
+	// reading the shared index on most calls
+	alignas(cache_line) std::atomic<std::size_t> head;
+	std::size_t cached_tail;
+	// The producer's line
+	alignas(cache_line) std::atomic<std::size_t> tail;
+	std::size_t cached_head;
+
+public:
+	explicit spsc_queue(std::size_t capacity)
+		: mask(ring_capacity(capacity) - 1), slots(new T[mask + 1]), head(0), cached_tail(0), tail(0), cached_head(0)
+	{
+	}
+
+	spsc_queue(const spsc_queue &)			  = delete;
+	spsc_queue &operator=(const spsc_queue &) = delete;
+
+	/* Producer only. false if full, value is left untouched then */
+	bool try_push(T &&value)
+	{
+		std::size_t position = tail.load(std::memory_order_relaxed);
+		if(position - cached_head > mask)
+		{
+			cached_head = head.load(std::memory_order_acquire);
+			if(position - cached_head > mask)
+			{
+				return false;
+			}
+		}
+		slots[position & mask] = std::move(value);
+		tail.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	/* Consumer only. false if empty */
+	bool try_pop(T &value)
+	{
+		std::size_t position = head.load(std::memory_order_relaxed);
+		if(position == cached_tail)
+		{
+			cached_tail = tail.load(std::memory_order_acquire);
+			if(position == cached_tail)
+			{
+				return false;
+			}
+		}
+		value = std::move(slots[position & mask]);
+		head.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	/* Approximate while both sides are running */
+	std::size_t size() const
+	{
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+	std::size_t capacity() const
+	{
+		return mask + 1;
+	}
+};
+
+/* Any number of producers and consumers. Every slot carries a sequence number telling whether it is
+   free for the producer of that lap or filled for its consumer, one compare-and-swap per operation */
+template<typename T>
+class mpmc_queue
+{
+private:
+	struct alignas(cache_line) slot
+	{
+		std::atomic<std::size_t> sequence;
+		T value;
+	};
+
+	const std::size_t mask;
+	std::unique_ptr<slot[]> slots;
+
+	alignas(cache_line) std::atomic<std::size_t> head;
+	alignas(cache_line) std::atomic<std::size_t> tail;
+
+public:
+	explicit mpmc_queue(std::size_t capacity) : mask(ring_capacity(capacity) - 1), slots(new slot[mask + 1]), head(0), tail(0)
+	{
+		for(std::size_t i = 0; i <= mask; i++)
+		{
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	mpmc_queue(const mpmc_queue &)			  = delete;
+	mpmc_queue &operator=(const mpmc_queue &) = delete;
+
+	/* false if full, value is left untouched then */
+	bool try_push(T &&value)
+	{
+		std::size_t position = tail.load(std::memory_order_relaxed);
+		for(;;)
+		{
+			slot &target		  = slots[position & mask];
+			std::size_t sequence  = target.sequence.load(std::memory_order_acquire);
+			std::ptrdiff_t offset = static_cast<std::ptrdiff_t>(sequence - position);
+			if(offset == 0)
+			{
+				if(tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					target.value = std::move(value);
+					target.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if(offset < 0)
+			{
+				// The consumer of the previous lap hasn't taken it yet
+				return false;
+			}
+			else
+			{
+				position = tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/* false if empty */
+	bool try_pop(T &value)
+	{
+		std::size_t position = head.load(std::memory_order_relaxed);
+		for(;;)
+		{
+			slot &source		  = slots[position & mask];
+			std::size_t sequence  = source.sequence.load(std::memory_order_acquire);
+			std::ptrdiff_t offset = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+			if(offset == 0)
+			{
+				if(head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					value = std::move(source.value);
+					source.sequence.store(position + mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if(offset < 0)
+			{
+				return false;
+			}
+			else
+			{
+				position = head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/* Approximate while producers or consumers are running */
+	std::size_t size() const
+	{
+		std::size_t pushed = tail.load(std::memory_order_acquire);
+		std::size_t popped = head.load(std::memory_order_acquire);
+		return pushed > popped ? pushed - popped : 0;
+	}
+	std::size_t capacity() const
+	{
+		return mask + 1;
+	}
+};
+
+#endif // CORE_FRAME_QUEUE_H
\ No newline at end of file
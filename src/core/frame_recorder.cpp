@@ -0,0 +1,398 @@
+#include "core/frame_recorder.h"
+
+#include "core/gl_state.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+	// Long enough for any frame, a lost context must not hang the recorder
+	constexpr GLuint64 fence_timeout = 1000000000;
+
+	std::string lowercase_extension(const std::string &path)
+	{
+		std::string extension = std::filesystem::path(path).extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+		return extension;
+	}
+} // namespace
+
+frame_recorder::frame_recorder(const std::string &path, double fps, backpressure policy, std::size_t ring_size, std::size_t queue_size)
+	: path(path),
+	  fps(fps),
+	  policy(policy),
+	  video(false),
+	  ring(ring_size, readback {0, nullptr}),
+	  ring_head(0),
+	  ring_pending(0),
+	  ring_width(0),
+	  ring_height(0),
+	  queue_size(queue_size),
+	  reserved(0),
+	  stopping(false),
+	  captured(0),
+	  encoded(0),
+	  dropped(0),
+	  failed(0)
+{
+	if(ring_size == 0 || queue_size == 0)
+	{
+		throw std::runtime_error("Frame recorder needs at least one readback and one queued frame");
+	}
+
+	std::string extension = lowercase_extension(path);
+	video				  = extension == ".avi" || extension == ".mp4" || extension == ".mkv";
+	if(!video)
+	{
+		std::filesystem::create_directories(path);
+	}
+
+	encoder = std::thread(&frame_recorder::encoder_loop, this);
+}
+
+frame_recorder::~frame_recorder()
+{
+	if(encoder.joinable())
+	{
+		finish();
+	}
+}
+
+frame_recorder::statistics frame_recorder::finish()
+{
+	if(!encoder.joinable())
+	{
+		return get_statistics();
+	}
+
+	if(ring_width > 0)
+	{
+		while(ring_pending > 0)
+		{
+			retire(true);
+		}
+		release_ring();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		stopping = true;
+	}
+	queue_condition.notify_all();
+	encoder.join();
+
+	spdlog::info(
+		"Recorded {}: {} frames, {} encoded, {} dropped, {} failed",
+		path,
+		captured.load(),
+		encoded.load(),
+		dropped.load(),
+		failed.load());
+	return get_statistics();
+}
+
+void frame_recorder::allocate_ring(int width, int height)
+{
+	gl_state &state = gl_state::get();
+	for(readback &slot : ring)
+	{
+		glGenBuffers(1, &slot.buffer);
+		state.bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(width) * height * 4, nullptr, GL_STREAM_READ);
+	}
+	state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	ring_width	= width;
+	ring_height = height;
+}
+
+void frame_recorder::release_ring()
+{
+	for(readback &slot : ring)
+	{
+		gl_state::get().forget_buffer(slot.buffer);
+		glDeleteBuffers(1, &slot.buffer);
+		slot.buffer = 0;
+	}
+	ring_width	= 0;
+	ring_height = 0;
+}
+
+void frame_recorder::capture(int width, int height)
+{
+	captured++;
+	if(width <= 0 || height <= 0)
+	{
+		return;
+	}
+
+	// A resized window gets a new ring, the readbacks of the old size are finished first
+	if(width != ring_width || height != ring_height)
+	{
+		if(ring_width > 0)
+		{
+			while(ring_pending > 0)
+			{
+				retire(true);
+			}
+			release_ring();
+		}
+		allocate_ring(width, height);
+	}
+
+	// Readbacks finish in order, the first one in flight ends the scan
+	while(ring_pending > 0 && retire(false))
+	{
+	}
+
+	if(ring_pending == ring.size())
+	{
+		if(policy == backpressure::drop)
+		{
+			drop();
+			return;
+		}
+		retire(true);
+	}
+
+	readback &slot	= ring[ring_head];
+	gl_state &state = gl_state::get();
+
+	// BGRA rows are always 4 byte aligned and the format drivers read back without converting
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, state.get_default_framebuffer());
+	state.bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+	state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	ring_head = (ring_head + 1) % ring.size();
+	ring_pending++;
+}
+
+bool frame_recorder::retire(bool wait)
+{
+	readback &slot = ring[(ring_head + ring.size() - ring_pending) % ring.size()];
+
+	GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? fence_timeout : 0);
+	if(status == GL_TIMEOUT_EXPIRED && !wait)
+	{
+		return false;
+	}
+
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+	ring_pending--;
+
+	if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+	{
+		failed++;
+		return true;
+	}
+
+	cv::Mat pixels;
+	if(!reserve(pixels))
+	{
+		drop();
+		return true;
+	}
+
+	// The only copy on the render thread, the encoder never touches GL
+	pixels.create(ring_height, ring_width, CV_8UC4);
+	std::size_t size = pixels.total() * pixels.elemSize();
+
+	gl_state &state = gl_state::get();
+	state.bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(size), GL_MAP_READ_BIT);
+	if(mapped)
+	{
+		std::memcpy(pixels.data, mapped, size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	if(!mapped)
+	{
+		failed++;
+		cancel(std::move(pixels));
+		return true;
+	}
+
+	commit(std::move(pixels), true);
+	return true;
+}
+
+bool frame_recorder::push(const cv::Mat &frame)
+{
+	captured++;
+	if(frame.empty() || frame.depth() != CV_8U)
+	{
+		failed++;
+		return false;
+	}
+
+	cv::Mat pixels;
+	if(!reserve(pixels))
+	{
+		drop();
+		return false;
+	}
+
+	frame.copyTo(pixels);
+	commit(std::move(pixels), false);
+	return true;
+}
+
+bool frame_recorder::reserve(cv::Mat &pixels)
+{
+	std::unique_lock<std::mutex> lock(queue_mutex);
+	if(policy == backpressure::block)
+	{
+		space_condition.wait(lock, [this]() { return queue.size() + reserved < queue_size; });
+	}
+	else if(queue.size() + reserved >= queue_size)
+	{
+		return false;
+	}
+
+	reserved++;
+	if(!free_frames.empty())
+	{
+		pixels = std::move(free_frames.back());
+		free_frames.pop_back();
+	}
+	return true;
+}
+
+void frame_recorder::commit(cv::Mat &&pixels, bool from_gl)
+{
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		reserved--;
+		queue.push_back(queued_frame {std::move(pixels), from_gl});
+	}
+	queue_condition.notify_one();
+}
+
+void frame_recorder::cancel(cv::Mat &&pixels)
+{
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		reserved--;
+		free_frames.push_back(std::move(pixels));
+	}
+	space_condition.notify_one();
+}
+
+void frame_recorder::drop()
+{
+	// The output has a gap from here on, said once so a slow encoder doesn't flood the log
+	if(dropped++ == 0)
+	{
+		spdlog::warn("Recorder {} can't keep up, dropping frames", path);
+	}
+}
+
+frame_recorder::statistics frame_recorder::get_statistics() const
+{
+	statistics result;
+	result.captured = captured.load();
+	result.encoded	= encoded.load();
+	result.dropped	= dropped.load();
+	result.failed	= failed.load();
+	return result;
+}
+
+void frame_recorder::encoder_loop()
+{
+	cv::VideoWriter writer;
+	cv::Size frame_size;
+	cv::Mat converted, resized;
+	std::size_t index = 0;
+
+	for(;;)
+	{
+		queued_frame frame;
+		{
+			std::unique_lock<std::mutex> lock(queue_mutex);
+			queue_condition.wait(lock, [this]() { return stopping || !queue.empty(); });
+			if(queue.empty())
+			{
+				return;
+			}
+			frame = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		try
+		{
+			// GL rows start at the bottom, the swizzle and flip are done here rather than on the render thread
+			cv::Mat output = frame.pixels;
+			if(output.channels() != 3)
+			{
+				cv::cvtColor(output, converted, output.channels() == 1 ? cv::COLOR_GRAY2BGR : cv::COLOR_BGRA2BGR);
+				output = converted;
+			}
+			if(frame.from_gl)
+			{
+				cv::flip(output, converted, 0);
+				output = converted;
+			}
+
+			if(video)
+			{
+				if(!writer.isOpened())
+				{
+					frame_size = output.size();
+					int fourcc = lowercase_extension(path) == ".avi" ? cv::VideoWriter::fourcc('M', 'J', 'P', 'G')
+																	 : cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+					if(!writer.open(path, fourcc, fps, frame_size))
+					{
+						throw std::runtime_error("Can't open video " + path + " for writing");
+					}
+				}
+				// A video has one frame size, frames of a resized window are scaled to it
+				if(output.size() != frame_size)
+				{
+					cv::resize(output, resized, frame_size);
+					output = resized;
+				}
+				writer.write(output);
+			}
+			else
+			{
+				char name[32];
+				std::snprintf(name, sizeof(name), "frame_%06zu.png", index);
+				if(!cv::imwrite((std::filesystem::path(path) / name).string(), output))
+				{
+					throw std::runtime_error("Can't write frame " + std::string(name));
+				}
+			}
+			index++;
+			encoded++;
+		}
+		catch(const std::exception &e)
+		{
+			if(failed++ == 0)
+			{
+				spdlog::error("Recorder: {}", e.what());
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			free_frames.push_back(std::move(frame.pixels));
+		}
+		space_condition.notify_one();
+	}
+}
\ No newline at end of file
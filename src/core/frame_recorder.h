@@ -0,0 +1,127 @@
+#ifndef CORE_FRAME_RECORDER_H
+#define CORE_FRAME_RECORDER_H
+
+// clang-format off
+#include <GL/glew.h>
+#include <GL/gl.h>
+// clang-format on
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Records frames to a video (.avi, .mp4, .mkv) or a directory of PNGs without stalling rendering.
+ * capture() reads the framebuffer into the next pixel pack buffer of a ring and fences it, the
+ * buffer is mapped a few frames later once the fence signalled, so glReadPixels never waits for the GPU.
+ * GPU frames and the cv::Mat frames given to push() go through a bounded queue to an encoder thread.
+ * Under backpressure frames are dropped and counted, or waited for when every frame must be kept.
+ * GL is only touched by capture() and the destructor, on the thread whose context is current.
+ */
+class frame_recorder
+{
+public:
+	enum class backpressure
+	{
+		drop, // a full ring or queue drops the new frame, rendering never waits
+		block // rendering waits for the GPU and the encoder, for offline runs
+	};
+
+	struct statistics
+	{
+		std::size_t captured = 0; // frames handed to the recorder
+		std::size_t encoded	 = 0;
+		std::size_t dropped	 = 0; // frames lost to backpressure
+		std::size_t failed	 = 0; // frames the encoder couldn't write
+	};
+
+private:
+	struct readback
+	{
+		GLuint buffer;
+		GLsync fence; // nullptr while the buffer is free
+	};
+
+	struct queued_frame
+	{
+		cv::Mat pixels;
+		bool from_gl; // BGRA, bottom row first
+	};
+
+	std::string path;
+	double fps;
+	backpressure policy;
+	bool video;
+
+	std::vector<readback> ring;
+	std::size_t ring_head;	  // next buffer to read into
+	std::size_t ring_pending; // fenced buffers, the oldest one is ring_pending behind ring_head
+	int ring_width, ring_height;
+
+	std::deque<queued_frame> queue;
+	std::vector<cv::Mat> free_frames; // pixels of encoded frames, reused for new ones
+	std::size_t queue_size;
+	std::size_t reserved; // places taken by frames being copied
+	std::mutex queue_mutex;
+	std::condition_variable queue_condition;
+	std::condition_variable space_condition;
+	bool stopping;
+
+	std::atomic<std::size_t> captured, encoded, dropped, failed;
+	std::thread encoder;
+
+	void encoder_loop();
+
+	/* Take a place in the queue and a recycled buffer for the frame, false if the frame is dropped */
+	bool reserve(cv::Mat &pixels);
+	void commit(cv::Mat &&pixels, bool from_gl);
+	void cancel(cv::Mat &&pixels);
+	void drop();
+
+	void allocate_ring(int width, int height);
+	void release_ring();
+
+	/* Hand the oldest pending readback to the encoder once its fence signalled.
+	   false if it is still in flight and wait isn't set */
+	bool retire(bool wait);
+
+public:
+	/* ring_size - readbacks in flight, queue_size - frames waiting for the encoder.
+	   Throws std::runtime_error if a size is 0 or the output directory can't be created */
+	frame_recorder(
+		const std::string &path,
+		double fps				= 30.0,
+		backpressure policy		= backpressure::drop,
+		std::size_t ring_size	= 3,
+		std::size_t queue_size	= 8);
+	/* Finishes the recording if finish() wasn't called */
+	~frame_recorder();
+
+	frame_recorder(const frame_recorder &)			  = delete;
+	frame_recorder &operator=(const frame_recorder &) = delete;
+
+	/* Start reading back the window's framebuffer, call after drawing and before the swap */
+	void capture(int width, int height);
+
+	/* Queue a copy of an 8-bit gray, BGR or BGRA frame, false if it was dropped */
+	bool push(const cv::Mat &frame);
+
+	statistics get_statistics() const;
+
+	/* Wait for the frames in flight and the encoder, the final statistics. No frames may be
+	   given afterwards */
+	statistics finish();
+
+	const std::string &get_path() const
+	{
+		return path;
+	}
+};
+
+#endif // CORE_FRAME_RECORDER_H
\ No newline at end of file
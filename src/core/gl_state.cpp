@@ -0,0 +1,221 @@
+#include "core/gl_state.h"
+
+#include <initializer_list>
+
+gl_state::gl_state() : default_framebuffer(0)
+{
+	invalidate();
+}
+
+gl_state &gl_state::get()
+{
+	// Each render thread has its own context current
+	thread_local gl_state state;
+	return state;
+}
+
+GLuint *gl_state::buffer_slot(GLenum target)
+{
+	switch(target)
+	{
+		case GL_ARRAY_BUFFER:
+			return &array_buffer;
+		case GL_PIXEL_UNPACK_BUFFER:
+			return &pixel_unpack_buffer;
+		case GL_PIXEL_PACK_BUFFER:
+			return &pixel_pack_buffer;
+		case GL_UNIFORM_BUFFER:
+			return &uniform_buffer;
+		default:
+			return nullptr;
+	}
+}
+
+void gl_state::bind_buffer(GLenum target, GLuint id)
+{
+	GLuint *slot = buffer_slot(target);
+	if(!slot)
+	{
+		frame.issued++;
+		glBindBuffer(target, id);
+		return;
+	}
+
+	if(changed(*slot, id))
+	{
+		glBindBuffer(target, id);
+	}
+}
+
+void gl_state::bind_texture(GLenum target, GLuint id)
+{
+	int index;
+	switch(target)
+	{
+		case GL_TEXTURE_2D:
+			index = target_2d;
+			break;
+		case GL_TEXTURE_2D_ARRAY:
+			index = target_2d_array;
+			break;
+		default:
+			frame.issued++;
+			glBindTexture(target, id);
+			return;
+	}
+
+	// Unit unknown after invalidate(), bind without recording
+	if(active_unit >= texture_units)
+	{
+		frame.issued++;
+		glBindTexture(target, id);
+		return;
+	}
+
+	if(changed(textures[active_unit][index], id))
+	{
+		glBindTexture(target, id);
+	}
+}
+
+void gl_state::set_enabled(GLenum cap, bool enabled)
+{
+	int index;
+	switch(cap)
+	{
+		case GL_BLEND:
+			index = cap_blend;
+			break;
+		case GL_DEPTH_TEST:
+			index = cap_depth_test;
+			break;
+		case GL_SCISSOR_TEST:
+			index = cap_scissor_test;
+			break;
+		case GL_CULL_FACE:
+			index = cap_cull_face;
+			break;
+		default:
+			index = -1;
+			break;
+	}
+
+	if(index >= 0 && capabilities[index] == static_cast<int>(enabled))
+	{
+		frame.skipped++;
+		return;
+	}
+	if(index >= 0)
+	{
+		capabilities[index] = enabled;
+	}
+
+	frame.issued++;
+	if(enabled)
+	{
+		glEnable(cap);
+	}
+	else
+	{
+		glDisable(cap);
+	}
+}
+
+void gl_state::blend_func(GLenum source, GLenum destination)
+{
+	if(blend_source == source && blend_destination == destination)
+	{
+		frame.skipped++;
+		return;
+	}
+
+	blend_source	  = source;
+	blend_destination = destination;
+	frame.issued++;
+	glBlendFunc(source, destination);
+}
+
+void gl_state::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if(viewport_rect[0] == x && viewport_rect[1] == y && viewport_rect[2] == width && viewport_rect[3] == height)
+	{
+		frame.skipped++;
+		return;
+	}
+
+	viewport_rect[0] = x;
+	viewport_rect[1] = y;
+	viewport_rect[2] = width;
+	viewport_rect[3] = height;
+	frame.issued++;
+	glViewport(x, y, width, height);
+}
+
+void gl_state::forget_program(GLuint id)
+{
+	if(program == id)
+	{
+		program = unknown;
+	}
+}
+
+void gl_state::forget_vertex_array(GLuint id)
+{
+	if(vertex_array == id)
+	{
+		vertex_array = unknown;
+	}
+}
+
+void gl_state::forget_buffer(GLuint id)
+{
+	for(GLuint *slot : {&array_buffer, &pixel_unpack_buffer, &pixel_pack_buffer, &uniform_buffer})
+	{
+		if(*slot == id)
+		{
+			*slot = unknown;
+		}
+	}
+}
+
+void gl_state::forget_texture(GLuint id)
+{
+	for(auto &unit : textures)
+	{
+		for(GLuint &bound : unit)
+		{
+			if(bound == id)
+			{
+				bound = unknown;
+			}
+		}
+	}
+}
+
+void gl_state::invalidate()
+{
+	program				= unknown;
+	vertex_array		= unknown;
+	array_buffer		= unknown;
+	pixel_unpack_buffer = unknown;
+	pixel_pack_buffer	= unknown;
+	uniform_buffer		= unknown;
+	active_unit			= unknown;
+	for(auto &unit : textures)
+	{
+		for(GLuint &bound : unit)
+		{
+			bound = unknown;
+		}
+	}
+	for(int &cap : capabilities)
+	{
+		cap = -1;
+	}
+	blend_source	  = unknown;
+	blend_destination = unknown;
+	for(GLint &value : viewport_rect)
+	{
+		value = -1;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+#ifndef CORE_GL_STATE_H
+#define CORE_GL_STATE_H
+
+// clang-format off
+#include <GL/glew.h>
+#include <GL/gl.h>
+// clang-format on
+
+#include <cstddef>
+
+/*
+ * Shadow of the GL state the renderer changes most: program, vertex array, buffers,
+ * texture units, blend, depth and viewport.
+ * Calls that wouldn't change anything are skipped and counted. There is one instance per
+ * render thread, code that changes state behind its back (ImGui) calls invalidate() afterwards.
+ * Deleting a bound object must go through the forget_* calls, GL reuses the names.
+ */
+class gl_state
+{
+public:
+	struct counters
+	{
+		std::size_t issued	= 0; // state calls passed on to GL
+		std::size_t skipped = 0; // state calls that were already in effect
+	};
+
+	static constexpr std::size_t texture_units = 16;
+
+private:
+	static constexpr GLuint unknown = ~0u;
+
+	// Tracked texture targets, others are passed through
+	enum texture_target
+	{
+		target_2d,
+		target_2d_array,
+		target_count
+	};
+
+	// Tracked capabilities
+	enum capability
+	{
+		cap_blend,
+		cap_depth_test,
+		cap_scissor_test,
+		cap_cull_face,
+		cap_count
+	};
+
+	GLuint program;
+	GLuint vertex_array;
+	GLuint array_buffer;
+	GLuint pixel_unpack_buffer;
+	GLuint pixel_pack_buffer;
+	GLuint uniform_buffer;
+	GLuint active_unit;
+	GLuint textures[texture_units][target_count];
+	int capabilities[cap_count]; // -1 unknown
+	GLenum blend_source, blend_destination;
+	GLint viewport_rect[4];
+	GLuint default_framebuffer;
+
+	counters frame;
+	counters last_frame;
+
+	gl_state();
+
+	GLuint *buffer_slot(GLenum target);
+
+	bool changed(GLuint &current, GLuint value)
+	{
+		if(current == value)
+		{
+			frame.skipped++;
+			return false;
+		}
+		current = value;
+		frame.issued++;
+		return true;
+	}
+
+public:
+	/* State of the context current on this thread */
+	static gl_state &get();
+
+	gl_state(const gl_state &)			  = delete;
+	gl_state &operator=(const gl_state &) = delete;
+
+	void use_program(GLuint id)
+	{
+		if(changed(program, id))
+		{
+			glUseProgram(id);
+		}
+	}
+
+	void bind_vertex_array(GLuint id)
+	{
+		if(changed(vertex_array, id))
+		{
+			glBindVertexArray(id);
+		}
+	}
+
+	/* GL_ELEMENT_ARRAY_BUFFER belongs to the vertex array and is always passed through */
+	void bind_buffer(GLenum target, GLuint id);
+
+	void active_texture(GLuint unit)
+	{
+		if(changed(active_unit, unit))
+		{
+			glActiveTexture(GL_TEXTURE0 + unit);
+		}
+	}
+
+	/* Bind to the active unit */
+	void bind_texture(GLenum target, GLuint id);
+
+	void set_enabled(GLenum cap, bool enabled);
+	void blend_func(GLenum source, GLenum destination);
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	void forget_program(GLuint id);
+	void forget_vertex_array(GLuint id);
+	void forget_buffer(GLuint id);
+	void forget_texture(GLuint id);
+
+	/* Everything is unknown until set again */
+	void invalidate();
+
+	/* Framebuffer that stands in for the window's, 0 unless rendering headless.
+	   Code that binds its own framebuffers restores this one */
+	void set_default_framebuffer(GLuint id)
+	{
+		default_framebuffer = id;
+	}
+	GLuint get_default_framebuffer() const
+	{
+		return default_framebuffer;
+	}
+
+	/* Close the frame's counters, call once per presented frame */
+	void end_frame()
+	{
+		last_frame = frame;
+		frame	   = counters();
+	}
+
+	const counters &get_last_frame() const
+	{
+		return last_frame;
+	}
+};
+
+#endif // CORE_GL_STATE_H
\ No newline at end of file
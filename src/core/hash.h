@@ -0,0 +1,43 @@
+#ifndef CORE_HASH_H
+#define CORE_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/* 64-bit FNV-1a */
+constexpr std::uint64_t fnv1a_64(const char *data, std::size_t size, std::uint64_t hash = 14695981039346656037ull)
+{
+	for(std::size_t i = 0; i < size; i++)
+	{
+		hash ^= static_cast<std::uint8_t>(data[i]);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/* Fast non-cryptographic hash of a large buffer, 8 bytes per step */
+inline std::uint64_t hash_bytes(const void *data, std::size_t size)
+{
+	const unsigned char *bytes = static_cast<const unsigned char *>(data);
+	std::uint64_t hash		   = 14695981039346656037ull ^ (size * 0x9E3779B97F4A7C15ull);
+
+	std::size_t i = 0;
+	for(; i + 8 <= size; i += 8)
+	{
+		std::uint64_t word;
+		std::memcpy(&word, bytes + i, 8);
+		hash ^= word * 0x9E3779B97F4A7C15ull;
+		hash = (hash << 31 | hash >> 33) * 0xC2B2AE3D27D4EB4Full;
+	}
+
+	hash = fnv1a_64(reinterpret_cast<const char *>(bytes + i), size - i, hash);
+
+	// Final avalanche
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+#endif // CORE_HASH_H
\ No newline at end of file
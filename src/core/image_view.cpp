@@ -0,0 +1,330 @@
+#include "core/image_view.h"
+
+#include "core/gl_state.h"
+#include "core/shader.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	// Full viewport quad built from gl_VertexID, no vertex buffer needed
+	const std::string image_vertex_shader = "#version 330 core\n"
+											"\n"
+											"out vec2 v_TexCoord;\n"
+											"\n"
+											"void main() {\n"
+											"	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+											"	// Row 0 of the cv::Mat is the top of the image\n"
+											"	v_TexCoord = vec2(corner.x, 1.0 - corner.y);\n"
+											"	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);\n"
+											"}\n";
+
+	const std::string image_fragment_shader = "#version 330 core\n"
+											  "\n"
+											  "layout(location = 0) out vec4 color;\n"
+											  "\n"
+											  "in vec2 v_TexCoord;\n"
+											  "\n"
+											  "uniform sampler2D u_Texture;\n"
+											  "\n"
+											  "void main()\n"
+											  "{\n"
+											  "	color = texture(u_Texture, v_TexCoord);\n"
+											  "}\n";
+
+	// Both chroma planes of I420 share one texture, U rows on top of the V rows
+	const std::string yuv_fragment_shader = "#version 330 core\n"
+											"\n"
+											"layout(location = 0) out vec4 color;\n"
+											"\n"
+											"in vec2 v_TexCoord;\n"
+											"\n"
+											"uniform sampler2D u_Luma;\n"
+											"uniform sampler2D u_Chroma;\n"
+											"uniform int u_Layout; // 0 - I420, 1 - NV12, 2 - YUYV\n"
+											"\n"
+											"void main()\n"
+											"{\n"
+											"	vec3 yuv;\n"
+											"	if(u_Layout == 2)\n"
+											"	{\n"
+											"		// One Y0 U Y1 V texel per two pixels\n"
+											"		ivec2 size	= textureSize(u_Luma, 0);\n"
+											"		ivec2 pixel = min(ivec2(v_TexCoord * vec2(size.x * 2, size.y)), ivec2(size.x * 2 - 1, size.y - 1));\n"
+											"		vec4 pair	= texelFetch(u_Luma, ivec2(pixel.x / 2, pixel.y), 0);\n"
+											"		yuv			= vec3((pixel.x & 1) == 0 ? pair.r : pair.b, pair.g, pair.a);\n"
+											"	}\n"
+											"	else if(u_Layout == 1)\n"
+											"	{\n"
+											"		yuv = vec3(texture(u_Luma, v_TexCoord).r, texture(u_Chroma, v_TexCoord).rg);\n"
+											"	}\n"
+											"	else\n"
+											"	{\n"
+											"		// Kept off the seam between the U and V rows\n"
+											"		float half_texel = 0.5 / float(textureSize(u_Chroma, 0).y);\n"
+											"		float row		 = clamp(v_TexCoord.y * 0.5, half_texel, 0.5 - half_texel);\n"
+											"		yuv				 = vec3(\n"
+											"			  texture(u_Luma, v_TexCoord).r,\n"
+											"			  texture(u_Chroma, vec2(v_TexCoord.x, row)).r,\n"
+											"			  texture(u_Chroma, vec2(v_TexCoord.x, row + 0.5)).r);\n"
+											"	}\n"
+											"\n"
+											"	// BT.601 limited range, columns are the Y, U and V weights\n"
+											"	yuv -= vec3(16.0 / 255.0, 0.5, 0.5);\n"
+											"	color = vec4(mat3(1.164, 1.164, 1.164, 0.0, -0.392, 2.017, 1.596, -0.813, 0.0) * yuv, 1.0);\n"
+											"}\n";
+
+	constexpr std::uint64_t u_texture = name_hash("u_Texture");
+	constexpr std::uint64_t u_luma	  = name_hash("u_Luma");
+	constexpr std::uint64_t u_chroma  = name_hash("u_Chroma");
+	constexpr std::uint64_t u_layout  = name_hash("u_Layout");
+
+	void pixel_format(int type, GLenum &format, GLint &internal_format)
+	{
+		switch(type)
+		{
+			case CV_8UC1:
+				format			= GL_RED;
+				internal_format = GL_R8;
+				break;
+			case CV_8UC3:
+				format			= GL_BGR;
+				internal_format = GL_RGB8;
+				break;
+			case CV_8UC4:
+				format			= GL_BGRA;
+				internal_format = GL_RGBA8;
+				break;
+			default:
+				throw std::runtime_error("Unsupported cv::Mat type for image_view: " + std::to_string(type));
+		}
+	}
+
+	void set_sampling(GLuint texture)
+	{
+		gl_state::get().bind_texture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+} // namespace
+
+image_view::image_view(shader_manager &shaders)
+	: program(shaders.get_program("image_view", image_vertex_shader, image_fragment_shader)),
+	  yuv_program(shaders.get_program("image_view_yuv", image_vertex_shader, yuv_fragment_shader)),
+	  image_texture(0),
+	  chroma_texture(0),
+	  vao(0),
+	  width(0),
+	  height(0),
+	  type(-1),
+	  layout(-1)
+{
+	glGenVertexArrays(1, &vao);
+
+	glGenTextures(1, &image_texture);
+	set_sampling(image_texture);
+	glGenTextures(1, &chroma_texture);
+	set_sampling(chroma_texture);
+}
+
+image_view::~image_view()
+{
+	gl_state::get().forget_texture(image_texture);
+	gl_state::get().forget_texture(chroma_texture);
+	gl_state::get().forget_vertex_array(vao);
+	glDeleteTextures(1, &image_texture);
+	glDeleteTextures(1, &chroma_texture);
+	glDeleteVertexArrays(1, &vao);
+}
+
+void image_view::upload_plane(
+	GLuint texture,
+	GLint internal_format,
+	GLenum format,
+	int plane_width,
+	int plane_height,
+	int row_length,
+	const unsigned char *pixels,
+	bool reallocate)
+{
+	gl_state::get().bind_texture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+
+	if(reallocate)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, internal_format, plane_width, plane_height, 0, format, GL_UNSIGNED_BYTE, pixels);
+		GLint swizzle_rgba[] = {GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA};
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle_rgba);
+	}
+	else
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, plane_width, plane_height, format, GL_UNSIGNED_BYTE, pixels);
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+void image_view::upload(const cv::Mat &image)
+{
+	GLenum format;
+	GLint internal_format;
+	pixel_format(image.type(), format, internal_format);
+
+	bool reallocate = image.cols != width || image.rows != height || image.type() != type || layout != -1;
+	width			= image.cols;
+	height			= image.rows;
+	type			= image.type();
+	layout			= -1;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	upload_plane(image_texture, internal_format, format, width, height, static_cast<int>(image.step[0] / image.elemSize()), image.ptr(), reallocate);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	stats.uploaded_bytes += image.total() * image.elemSize();
+	stats.full_uploads++;
+
+	// Gray frames are shown as gray, not red
+	if(reallocate && type == CV_8UC1)
+	{
+		GLint swizzle_gray[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle_gray);
+	}
+
+	GLenum error = glGetError();
+	if(error != GL_NO_ERROR)
+	{
+		throw std::runtime_error("OpenGL error after image upload: " + std::to_string(error));
+	}
+}
+
+void image_view::upload(const cv::Mat &frame, yuv_layout yuv)
+{
+	const bool packed = yuv == yuv_layout::yuyv;
+	if(frame.type() != (packed ? CV_8UC2 : CV_8UC1))
+	{
+		throw std::runtime_error("Unsupported cv::Mat type for a YUV frame: " + std::to_string(frame.type()));
+	}
+
+	int frame_width	 = frame.cols;
+	int frame_height = packed ? frame.rows : frame.rows * 2 / 3;
+	if(frame_width % 2 != 0 || frame_height % 2 != 0 || (!packed && frame.rows % 3 != 0))
+	{
+		throw std::runtime_error("Bad YUV frame size " + std::to_string(frame.cols) + "x" + std::to_string(frame.rows));
+	}
+	if(yuv == yuv_layout::i420 && !frame.isContinuous())
+	{
+		// Chroma rows are half as long as the luma rows, only a continuous frame has them packed
+		throw std::runtime_error("I420 frames must be continuous");
+	}
+
+	bool reallocate = frame_width != width || frame_height != height || static_cast<int>(yuv) != layout;
+	width			= frame_width;
+	height			= frame_height;
+	type			= frame.type();
+	layout			= static_cast<int>(yuv);
+
+	int row_length = static_cast<int>(frame.step[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	switch(yuv)
+	{
+		case yuv_layout::i420:
+			upload_plane(image_texture, GL_R8, GL_RED, width, height, row_length, frame.ptr(), reallocate);
+			upload_plane(chroma_texture, GL_R8, GL_RED, width / 2, height, width / 2, frame.ptr(height), reallocate);
+			break;
+		case yuv_layout::nv12:
+			upload_plane(image_texture, GL_R8, GL_RED, width, height, row_length, frame.ptr(), reallocate);
+			upload_plane(chroma_texture, GL_RG8, GL_RG, width / 2, height / 2, row_length / 2, frame.ptr(height), reallocate);
+			break;
+		case yuv_layout::yuyv:
+			// Every texel is two pixels, the shader picks the luma by column
+			upload_plane(image_texture, GL_RGBA8, GL_RGBA, width / 2, height, row_length / 4, frame.ptr(), reallocate);
+			break;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	stats.uploaded_bytes += frame.total() * frame.elemSize();
+	stats.full_uploads++;
+
+	GLenum error = glGetError();
+	if(error != GL_NO_ERROR)
+	{
+		throw std::runtime_error("OpenGL error after YUV upload: " + std::to_string(error));
+	}
+}
+
+void image_view::upload(const cv::Mat &image, dirty_region &dirty)
+{
+	// A new size or type needs the whole image, and past half of it one call beats many
+	if(image.cols != width || image.rows != height || image.type() != type || layout != -1 || dirty.get_width() != width ||
+	   dirty.get_height() != height || dirty.get_coverage() > 0.5)
+	{
+		dirty.clear();
+		upload(image);
+		return;
+	}
+
+	GLenum format;
+	GLint internal_format;
+	pixel_format(image.type(), format, internal_format);
+
+	dirty.take(dirty_rectangles);
+	if(dirty_rectangles.empty())
+	{
+		stats.saved_bytes += image.total() * image.elemSize();
+		return;
+	}
+
+	// Rectangles are read straight out of the image, the row length skips the rest of each row
+	gl_state::get().bind_texture(GL_TEXTURE_2D, image_texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(image.step[0] / image.elemSize()));
+
+	std::size_t bytes = 0;
+	for(const cv::Rect &rect : dirty_rectangles)
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, format, GL_UNSIGNED_BYTE, image.ptr(rect.y, rect.x));
+		bytes += static_cast<std::size_t>(rect.area()) * image.elemSize();
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	stats.uploaded_bytes += bytes;
+	stats.saved_bytes += image.total() * image.elemSize() - bytes;
+	stats.partial_uploads++;
+	stats.rectangles += dirty_rectangles.size();
+}
+
+void image_view::draw() const
+{
+	if(width == 0 || height == 0)
+	{
+		return;
+	}
+
+	gl_state &state = gl_state::get();
+	if(layout != -1)
+	{
+		yuv_program.set(u_luma, 0);
+		yuv_program.set(u_chroma, 1);
+		yuv_program.set(u_layout, layout);
+		yuv_program.use();
+		state.active_texture(1);
+		state.bind_texture(GL_TEXTURE_2D, chroma_texture);
+		state.active_texture(0);
+		state.bind_texture(GL_TEXTURE_2D, image_texture);
+
+		state.bind_vertex_array(vao);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		return;
+	}
+
+	program.set(u_texture, 0);
+	program.use();
+	state.active_texture(0);
+	state.bind_texture(GL_TEXTURE_2D, image_texture);
+
+	state.bind_vertex_array(vao);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef CORE_IMAGE_VIEW_H
+#define CORE_IMAGE_VIEW_H
+
+// clang-format off
+#include <GL/glew.h>
+#include <GL/gl.h>
+// clang-format on
+
+#include "core/dirty_region.h"
+#include "core/shader_manager.h"
+
+#include <cstddef>
+#include <opencv2/core.hpp>
+#include <vector>
+
+/*
+ * Streaming texture for 8-bit cv::Mat frames (gray, BGR or BGRA) and raw YUV camera frames.
+ * The frame is uploaded in its own channel order, no cvtColor is needed. YUV frames are uploaded
+ * as their luma and chroma planes, at 1.5 or 2 bytes per pixel, and converted in the fragment shader.
+ */
+class image_view
+{
+public:
+	/* Layouts in OpenCV's convention: i420 and nv12 are CV_8UC1 with height * 3 / 2 rows,
+	   the luma plane followed by the chroma, yuyv is CV_8UC2 */
+	enum class yuv_layout
+	{
+		i420, // U plane, then V plane, both subsampled 2x2
+		nv12, // interleaved UV plane subsampled 2x2
+		yuyv  // packed Y0 U Y1 V, chroma subsampled horizontally
+	};
+
+	struct statistics
+	{
+		std::size_t uploaded_bytes	= 0;
+		std::size_t saved_bytes		= 0; // left out by uploading only the dirty rectangles
+		std::size_t full_uploads	= 0;
+		std::size_t partial_uploads = 0;
+		std::size_t rectangles		= 0; // uploaded by the partial uploads
+	};
+
+private:
+	shader_program &program;
+	shader_program &yuv_program;
+	GLuint image_texture; // luma plane of YUV frames, both planes for yuyv
+	GLuint chroma_texture;
+	GLuint vao;
+
+	int width, height, type;
+	int layout; // -1 for cv::Mat frames, else the yuv_layout
+
+	std::vector<cv::Rect> dirty_rectangles;
+	statistics stats;
+
+	void upload_plane(GLuint texture, GLint internal_format, GLenum format, int plane_width, int plane_height, int row_length, const unsigned char *pixels, bool reallocate);
+
+public:
+	image_view(shader_manager &shaders);
+	~image_view();
+
+	image_view(const image_view &)			  = delete;
+	image_view &operator=(const image_view &) = delete;
+
+	/* Upload a CV_8UC1, CV_8UC3 (BGR) or CV_8UC4 (BGRA) frame */
+	void upload(const cv::Mat &image);
+
+	/* Upload only the parts of the image marked in dirty, the region is clean afterwards.
+	   The first upload, a new size or type, or a mostly dirty region upload the whole image */
+	void upload(const cv::Mat &image, dirty_region &dirty);
+
+	/* Upload a raw YUV frame, BT.601 limited range like the cameras deliver.
+	   Width and height must be even, i420 frames must be continuous */
+	void upload(const cv::Mat &frame, yuv_layout yuv);
+
+	/* Draw the image over the current viewport */
+	void draw() const;
+
+	const statistics &get_statistics() const
+	{
+		return stats;
+	}
+
+	int get_width() const
+	{
+		return width;
+	}
+	int get_height() const
+	{
+		return height;
+	}
+};
+
+#endif // CORE_IMAGE_VIEW_H
\ No newline at end of file
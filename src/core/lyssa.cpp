@@ -5,7 +5,20 @@
 #include <GL/gl.h>
 // clang-format on
 
+#include "core/frame_profiler.h"
+#include "core/frame_recorder.h"
+#include "core/gl_state.h"
+#include "core/parallel_runtime.h"
+#include "core/perf_overlay.h"
+#include "core/quad_batch.h"
 #include "core/shader.h"
+#include "core/texture_cache.h"
+#include "core/texture_array.h"
+#include "core/texture_loader.h"
+#include "core/thread_pool.h"
+#include "core/tiled_image.h"
+#include "core/tiled_view.h"
+#include "core/window.h"
 
 #include <SDL_events.h>
 #include <SDL_keycode.h>
@@ -18,9 +31,18 @@
 // OpenCV
 #include <opencv2/opencv.hpp>
 // std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <exception>
+#include <map>
+#include <memory>
+#include <numeric>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 // helper to check and display for shader compiler errors
 bool check_shader_compile_status(GLuint obj)
@@ -64,8 +86,6 @@ void bind_cvmat_to_gl_texture(cv::Mat &image_mat, GLuint &texture)
 	}
 	else
 	{
-		//glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
 		glGenTextures(1, &texture);
 
 		// Error check
@@ -77,7 +97,7 @@ void bind_cvmat_to_gl_texture(cv::Mat &image_mat, GLuint &texture)
 			throw std::runtime_error(_error);
 		}
 
-		glBindTexture(GL_TEXTURE_2D, texture);
+		gl_state::get().bind_texture(GL_TEXTURE_2D, texture);
 
 		GLenum error_bind = glGetError();
 		if(error_bind != GL_NO_ERROR)
@@ -128,66 +148,101 @@ void bind_cvmat_to_gl_texture(cv::Mat &image_mat, GLuint &texture)
 	}
 }
 
+// Fit the quad in the vertex buffer to the aspect ratio of the image
+void fit_quad(GLuint buffer, const texture &image)
+{
+	float *scale = image.get_scale_normalized();
+	float h = scale[1], w = scale[0];
+	free(scale);
+
+	float positions[] = {-w, -h, 0.0, 0.0, -w, h, 0.0, 1.0, w, -h, 1.0, 0.0, w, h, 1.0, 1.0};
+
+	gl_state::get().bind_buffer(GL_ARRAY_BUFFER, buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(positions), positions);
+}
+
+// Fit a tiled image of the given size into the same quad as fit_quad, pixel rows grow downwards
+glm::mat4 fit_tiled_image(int width, int height)
+{
+	float scale = 2.0f / static_cast<float>(std::max(width, height));
+	return glm::scale(glm::mat4(1.0f), glm::vec3(scale, -scale, 1.0f)) *
+		   glm::translate(glm::mat4(1.0f), glm::vec3(-0.5f * width, -0.5f * height, 0.0f));
+}
+
 int main(int argc, char *argv[])
 {
-	if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0)
+	// lyssa [--shaders <directory>] [--headless [--frames <count>]] [--dump <directory or .avi/.mp4/.mkv>] [images or .lyt tiled images...]
+	std::string shader_directory;
+	std::vector<std::string> images;
+	bool headless			= false;
+	std::size_t frame_count = 100;
+	std::string dump_path;
+	for(int i = 1; i < argc; i++)
 	{
-		spdlog::error("Error: {}", SDL_GetError());
-		return -1;
+		std::string argument = argv[i];
+		if(argument == "--shaders" && i + 1 < argc)
+		{
+			shader_directory = argv[++i];
+		}
+		else if(argument == "--headless")
+		{
+			headless = true;
+		}
+		else if(argument == "--frames" && i + 1 < argc)
+		{
+			frame_count = static_cast<std::size_t>(std::max(1, std::atoi(argv[++i])));
+		}
+		else if(argument == "--dump" && i + 1 < argc)
+		{
+			dump_path = argv[++i];
+		}
+		else
+		{
+			images.push_back(argument);
+		}
 	}
 
-	// Decide GL+GLSL versions
-#if defined(IMGUI_IMPL_OPENGL_ES2)
-	// GL ES 2.0 + GLSL 100
-	const char *glsl_version = "#version 100";
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
-#elif defined(__APPLE__)
-	// GL 3.2 Core + GLSL 150
-	const char *glsl_version = "#version 150";
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG); // Always required on Mac
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
-#else
-	// GL 3.0 + GLSL 130
-	const char *glsl_version = "#version 130";
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
-#endif
-
-	SDL_Window *window = SDL_CreateWindow("OpenGL Test", 0, 0, 800, 800, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
-
-	if(!window)
+	// The watcher compiles on a second context shared through SDL, a headless EGL context has none
+	if(headless && !shader_directory.empty())
 	{
-		spdlog::error("Error: {}", SDL_GetError());
+		spdlog::error("Error: --shaders can't be used with --headless, shader hot reload needs a window");
 		return -1;
 	}
 
-	SDL_GLContext context = SDL_GL_CreateContext(window);
-
-	if(!context)
+	std::unique_ptr<window> main_window;
+	try
 	{
-		spdlog::error("Error: {}", SDL_GetError());
+		main_window = std::make_unique<window>("OpenGL Test", 800, 800, headless ? window::mode::headless : window::mode::visible);
+	}
+	catch(std::exception &e)
+	{
+		spdlog::error("Error: {}", e.what());
 		return -1;
 	}
 
-	// Enable glew experimental, this enables some more OpenGL extensions.
-	glewExperimental = GL_TRUE;
-	if(glewInit() != GLEW_OK)
+	if(headless)
 	{
-		spdlog::error("Failed to initialize GLEW");
-		return -1;
+		spdlog::info("Headless rendering on {}", reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
 	}
+
+	// Shaders in the directory are picked up while running, missing ones are written out to edit
+	if(!shader_directory.empty())
+	{
+		try
+		{
+			main_window->get_shaders().watch(shader_directory);
+		}
+		catch(std::exception &e)
+		{
+			spdlog::error("Error: {}", e.what());
+		}
+	}
+
 	// Set some OpenGL settings
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClearDepth(1.0f);
 	// we are drawing 3d objects so we want depth testing
-	glEnable(GL_DEPTH_TEST);
+	gl_state::get().set_enabled(GL_DEPTH_TEST, true);
 
 	// texture handle
 	GLuint buffer_texture_with_mat;
@@ -203,7 +258,7 @@ int main(int argc, char *argv[])
 							  "\n"
 							  "void main() {\n"
 							  "	v_TexCoord = texCoord;\n"
-							  "	gl_Position = position;\n"
+							  "	gl_Position = u_MVP * position;\n"
 							  "}\n";
 
 	std::string frag_shader = "#version 330 core\n"
@@ -219,28 +274,85 @@ int main(int argc, char *argv[])
 							  "	color = texture(u_Texture, v_TexCoord);\n"
 							  "}\n";
 
-	GLuint texture_shader;
+	shader_program *texture_shader;
 	try
 	{
-		texture_shader = create_program(vert_shader, frag_shader);
+		texture_shader = &main_window->get_shaders().get_program("texture", vert_shader, frag_shader);
 	}
 	catch(std::exception &e)
 	{
 		spdlog::error("Error with creating program: {}", e.what());
+		return -1;
+	}
+	texture_shader->set(name_hash("u_Texture"), 0);
+	constexpr std::uint64_t u_mvp = name_hash("u_MVP");
+	texture_shader->use();
+
+	gl_state::get().set_enabled(GL_BLEND, true);
+	gl_state::get().blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	// Images are decoded in the background, the window stays responsive while they load
+	thread_pool decode_pool;
+	// OpenCV's loops run on the same workers instead of a second machine-sized set of threads
+	parallel_runtime runtime(decode_pool);
+	texture_loader loader(decode_pool);
+	// Recently shown images stay resident up to the budget for instant re-display
+	texture_cache cache(loader, 256 * 1024 * 1024);
+
+	if(images.empty())
+	{
+		images.push_back("test.png");
 	}
-	glUseProgram(texture_shader);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	texture texture("test.png");
-	texture.bind();
-	glUniform1i(glGetUniformLocation(texture_shader, "u_Texture"), 0); // glUseProgram(redP_shader);
+	// The current image and its neighbours are held, left/right arrows browse
+	std::size_t current_image = 0;
+	std::map<std::size_t, std::shared_ptr<async_texture>> loaded_images;
+	auto request_images = [&]()
+	{
+		std::size_t first = current_image > 0 ? current_image - 1 : 0;
+		std::size_t last  = std::min(current_image + 2, images.size() - 1);
+		for(auto it = loaded_images.begin(); it != loaded_images.end();)
+		{
+			it = (it->first < first || it->first > last) ? loaded_images.erase(it) : std::next(it);
+		}
+		for(std::size_t i = first; i <= last; i++)
+		{
+			// Tiled images are streamed by tiled_view, never loaded whole
+			if(loaded_images.find(i) == loaded_images.end() && !is_tiled_image_file(images[i]))
+			{
+				loaded_images[i] = cache.acquire(images[i]);
+			}
+		}
+	};
+	request_images();
+	const texture *shown_texture = nullptr;
+
+	// The current tiled image and its tile cache
+	std::unique_ptr<tiled_image> tiled;
+	std::unique_ptr<tiled_view> tiled_viewer;
+	std::size_t tiled_index = images.size();
+
+	// Wheel zooms at the cursor, dragging pans, 0 resets. Only u_MVP changes, nothing is uploaded
+	float zoom = 1.0f;
+	glm::vec2 pan(0.0f, 0.0f);
+	auto reset_camera = [&]()
+	{
+		zoom = 1.0f;
+		pan	 = glm::vec2(0.0f, 0.0f);
+	};
+	auto camera = [&]()
+	{
+		return glm::translate(glm::mat4(1.0f), glm::vec3(pan, 0.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(zoom, zoom, 1.0f));
+	};
 
-	//Scaling the Verts:
-	float *scale = texture.get_scale_normalized();
+	// g toggles a grid of the images seen so far, thumbnails are GPU copies in one texture array
+	texture_array thumbnails(256, 256, static_cast<int>(std::min<std::size_t>(images.size(), 256)));
+	std::vector<bool> has_thumbnail(static_cast<std::size_t>(thumbnails.get_layers()), false);
+	quad_batch batch(main_window->get_shaders());
+	bool show_grid = false;
 
-	// Verts
-	float h = scale[1], w = scale[0];
+	// Verts, fitted to the image by fit_quad once it is loaded
+	float h = 1.0, w = 1.0;
 	float positions[] = {
 		-w,
 		-h,
@@ -283,30 +395,105 @@ int main(int argc, char *argv[])
 
 	GLuint vao;
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	gl_state::get().bind_vertex_array(vao);
 
 	GLuint buffer;
 	glGenBuffers(1, &buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer);
-	glBufferData(GL_ARRAY_BUFFER, 4 * 4 * sizeof(float), positions, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 4, (char *)0 + 0 * sizeof(GLfloat));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 4, (char *)0 + 2 * sizeof(GLfloat));
+	gl_state::get().bind_buffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, 4 * 4 * sizeof(float), positions, GL_DYNAMIC_DRAW);
+
+	// A reload can move or drop the attributes, they are looked up again for every new program.
+	// An attribute the program doesn't use comes back as -1 and is left disabled
+	std::vector<GLint> enabled_attributes;
+	std::uint64_t attributes_generation = 0;
+	auto setup_attributes = [&]()
+	{
+		gl_state::get().bind_vertex_array(vao);
+		gl_state::get().bind_buffer(GL_ARRAY_BUFFER, buffer);
+		for(GLint location : enabled_attributes)
+		{
+			glDisableVertexAttribArray(location);
+		}
+		enabled_attributes.clear();
+
+		GLint position_attribute  = texture_shader->get_attribute_location(name_hash("position"));
+		GLint tex_coord_attribute = texture_shader->get_attribute_location(name_hash("texCoord"));
+		if(position_attribute >= 0)
+		{
+			glEnableVertexAttribArray(position_attribute);
+			glVertexAttribPointer(position_attribute, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 4, (char *)0 + 0 * sizeof(GLfloat));
+			enabled_attributes.push_back(position_attribute);
+		}
+		if(tex_coord_attribute >= 0)
+		{
+			glEnableVertexAttribArray(tex_coord_attribute);
+			glVertexAttribPointer(tex_coord_attribute, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 4, (char *)0 + 2 * sizeof(GLfloat));
+			enabled_attributes.push_back(tex_coord_attribute);
+		}
+		attributes_generation = texture_shader->get_generation();
+	};
+	setup_attributes();
 
 	GLuint ibo;
 	glGenBuffers(1, &ibo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	gl_state::get().bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(GLuint), indices, GL_STATIC_DRAW);
 
+	// CPU and GPU time of the passes, read back a few frames late
+	frame_profiler profiler;
+
+	// F1 toggles frame times, renderer counters and the pass timeline, there is nothing to show it on headless
+	std::unique_ptr<perf_overlay> overlay;
+	if(!headless)
+	{
+		overlay = std::make_unique<perf_overlay>(*main_window);
+		overlay->set_profiler(&profiler);
+	}
+
+	// Headless runs time frame_count frames once the images are loaded
+	std::vector<double> frame_times;
+
+	// Frames are read back asynchronously, a headless dump keeps every frame, a visible one drops frames rather than stutter
+	std::unique_ptr<frame_recorder> recorder;
+	if(!dump_path.empty())
+	{
+		try
+		{
+			recorder = std::make_unique<frame_recorder>(
+				dump_path,
+				30.0,
+				headless ? frame_recorder::backpressure::block : frame_recorder::backpressure::drop);
+		}
+		catch(std::exception &e)
+		{
+			spdlog::error("Error: {}", e.what());
+		}
+	}
+	auto record_frame = [&]()
+	{
+		frame_profiler::scope pass(profiler, "readback");
+		int drawable_width, drawable_height;
+		main_window->get_drawable_size(drawable_width, drawable_height);
+		recorder->capture(drawable_width, drawable_height);
+	};
+
 	bool exit = false;
 
 	SDL_Event event;
 
 	while(!exit)
 	{
-		while(SDL_PollEvent(&event))
+		auto frame_start = std::chrono::steady_clock::now();
+		profiler.begin_frame();
+
+		profiler.begin("events");
+		while(!headless && SDL_PollEvent(&event))
 		{
+			if(overlay->process_event(event))
+			{
+				continue;
+			}
+
 			switch(event.type)
 			{
 				case SDL_KEYDOWN:
@@ -316,6 +503,31 @@ int main(int argc, char *argv[])
 						case SDLK_ESCAPE:
 							exit = true;
 							break;
+						case SDLK_F1:
+							overlay->set_visible(!overlay->is_visible());
+							break;
+						case SDLK_g:
+							show_grid = !show_grid;
+							break;
+						case SDLK_0:
+							reset_camera();
+							break;
+						case SDLK_RIGHT:
+							if(current_image + 1 < images.size())
+							{
+								current_image++;
+								request_images();
+								reset_camera();
+							}
+							break;
+						case SDLK_LEFT:
+							if(current_image > 0)
+							{
+								current_image--;
+								request_images();
+								reset_camera();
+							}
+							break;
 						default:
 							break;
 					}
@@ -323,6 +535,28 @@ int main(int argc, char *argv[])
 				case SDL_MOUSEBUTTONDOWN:
 					spdlog::info("Touch x: {} y: {}", event.button.x, event.button.y);
 					break;
+				case SDL_MOUSEMOTION:
+					if(event.motion.state & SDL_BUTTON_LMASK)
+					{
+						pan += glm::vec2(
+							2.0f * event.motion.xrel / main_window->get_width(),
+							-2.0f * event.motion.yrel / main_window->get_height());
+					}
+					break;
+				case SDL_MOUSEWHEEL:
+				{
+					// The point under the cursor stays in place
+					int mouse_x, mouse_y;
+					SDL_GetMouseState(&mouse_x, &mouse_y);
+					glm::vec2 cursor(
+						2.0f * mouse_x / main_window->get_width() - 1.0f,
+						1.0f - 2.0f * mouse_y / main_window->get_height());
+					float factor = std::pow(1.25f, static_cast<float>(event.wheel.y));
+					factor		 = std::clamp(zoom * factor, 0.05f, 65536.0f) / zoom;
+					pan			 = cursor - (cursor - pan) * factor;
+					zoom *= factor;
+					break;
+				}
 				case SDL_QUIT:
 					exit = true;
 					break;
@@ -330,22 +564,109 @@ int main(int argc, char *argv[])
 					break;
 			}
 		}
+		profiler.end();
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// // Texture
-		// try
-		// {
-		// 	cv::Mat image = cv::imread("test.png");
+		profiler.begin("uploads");
+		cache.update();
+		main_window->get_shaders().update();
+		profiler.end();
 
-		// 	bind_cvmat_to_gl_texture(image, buffer_texture_with_mat);
-		// }
-		// catch(std::exception &e)
-		// {
-		// 	spdlog::error("Error: {}", e.what());
-		// }
+		profiler.begin("thumbnails");
+		for(const auto &[index, handle] : loaded_images)
+		{
+			if(index < has_thumbnail.size() && !has_thumbnail[index] && handle->is_ready())
+			{
+				has_thumbnail[index] = true;
+				try
+				{
+					thumbnails.copy_from(handle->get(), static_cast<int>(index));
+				}
+				catch(std::exception &e)
+				{
+					spdlog::debug("No thumbnail for {}: {}", images[index], e.what());
+				}
+			}
+		}
+		profiler.end();
 
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+		profiler.begin("draw");
+		if(show_grid)
+		{
+			int columns		= static_cast<int>(std::ceil(std::sqrt(static_cast<double>(has_thumbnail.size()))));
+			float cell_size = static_cast<float>(main_window->get_width()) / columns;
+			batch.begin(main_window->get_width(), main_window->get_height());
+			for(std::size_t i = 0; i < has_thumbnail.size(); i++)
+			{
+				if(has_thumbnail[i])
+				{
+					batch.add(thumbnails, static_cast<int>(i), (i % columns) * cell_size, (i / columns) * cell_size, cell_size, cell_size);
+				}
+			}
+			batch.end();
+		}
+		else if(is_tiled_image_file(images[current_image]))
+		{
+			if(tiled_index != current_image)
+			{
+				tiled_index = current_image;
+				tiled_viewer.reset();
+				tiled.reset();
+				try
+				{
+					tiled		 = std::make_unique<tiled_image>(images[current_image]);
+					tiled_viewer = std::make_unique<tiled_view>(main_window->get_shaders(), *tiled);
+				}
+				catch(std::exception &e)
+				{
+					tiled.reset();
+					spdlog::error("Error: {}", e.what());
+				}
+			}
+
+			if(tiled_viewer)
+			{
+				tiled_viewer->draw(
+					camera() * fit_tiled_image(tiled->get_width(), tiled->get_height()),
+					main_window->get_width(),
+					main_window->get_height());
+			}
+		}
+		else
+		{
+			// Uploads the uniforms again if the program was reloaded
+			texture_shader->set_matrix(u_mvp, glm::value_ptr(camera()));
+			texture_shader->use();
+			if(texture_shader->get_generation() != attributes_generation)
+			{
+				setup_attributes();
+			}
+			gl_state::get().bind_vertex_array(vao);
+
+			const async_texture &image = *loaded_images[current_image];
+			if(&image.get() != shown_texture)
+			{
+				shown_texture = &image.get();
+				fit_quad(buffer, *shown_texture);
+			}
+			image.bind();
+
+			// // Texture
+			// try
+			// {
+			// 	cv::Mat image = cv::imread("test.png");
+
+			// 	bind_cvmat_to_gl_texture(image, buffer_texture_with_mat);
+			// }
+			// catch(std::exception &e)
+			// {
+			// 	spdlog::error("Error: {}", e.what());
+			// }
+
+			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+		}
+		profiler.end();
 
 		// check for errors
 		GLenum error = glGetError();
@@ -355,14 +676,69 @@ int main(int argc, char *argv[])
 			break;
 		}
 
-		SDL_GL_SwapWindow(window);
+		if(overlay)
+		{
+			frame_profiler::scope pass(profiler, "overlay");
+			overlay->draw();
+		}
+
+		// Frames showing placeholders aren't counted, the GPU is waited for and dumping isn't timed
+		if(headless && loader.get_pending_count() == 0)
+		{
+			glFinish();
+			frame_times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count());
+			if(recorder)
+			{
+				record_frame();
+			}
+			exit = frame_times.size() >= frame_count;
+		}
+		else if(!headless && recorder)
+		{
+			record_frame();
+		}
+
+		profiler.begin("swap");
+		main_window->swap();
+		profiler.end();
+		profiler.end_frame();
+		gl_state::get().end_frame();
 	}
 
 	glDeleteTextures(1, &buffer_texture_with_mat);
 
-	SDL_GL_DeleteContext(context);
-	SDL_DestroyWindow(window);
-	SDL_Quit();
+	if(!frame_times.empty())
+	{
+		std::vector<double> sorted = frame_times;
+		std::sort(sorted.begin(), sorted.end());
+		spdlog::info(
+			"Headless: {} frames, mean {:.3f} ms, median {:.3f} ms, p95 {:.3f} ms, max {:.3f} ms",
+			sorted.size(),
+			std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size(),
+			sorted[sorted.size() / 2],
+			sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)],
+			sorted.back());
+	}
+
+	// The frames still in flight are part of the totals too
+	profiler.finish();
+	for(const frame_profiler::summary &total : profiler.get_totals())
+	{
+		spdlog::info(
+			"Pass {}: CPU {:.3f} ms, GPU {:.3f} ms average",
+			total.name,
+			total.cpu_time / total.frames,
+			total.gpu_frames > 0 ? total.gpu_time / total.gpu_frames : 0.0);
+	}
+
+	const texture_cache::statistics &cache_stats = cache.get_statistics();
+	spdlog::info(
+		"Texture cache: {} hits, {} misses, {} content hits, {} evictions, {} MiB resident",
+		cache_stats.hits,
+		cache_stats.misses,
+		cache_stats.content_hits,
+		cache_stats.evictions,
+		cache_stats.resident_bytes / (1024 * 1024));
 
 	return 0;
 }
\ No newline at end of file
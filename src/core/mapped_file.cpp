@@ -0,0 +1,68 @@
+#include "core/mapped_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mapped_file::mapped_file(const std::string &path, access pattern) : mapping(nullptr), length(0)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+	{
+		throw std::runtime_error("Failed opening file: " + path + ": " + std::strerror(errno));
+	}
+
+	struct stat file_stat;
+	if(fstat(fd, &file_stat) != 0)
+	{
+		std::string _error = "Failed reading file size: " + path + ": " + std::strerror(errno);
+		close(fd);
+		throw std::runtime_error(_error);
+	}
+
+	length = static_cast<std::size_t>(file_stat.st_size);
+	if(length == 0)
+	{
+		close(fd);
+		return;
+	}
+
+	mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps its own reference to the file
+	close(fd);
+
+	if(mapping == MAP_FAILED)
+	{
+		mapping = nullptr;
+		throw std::runtime_error("Failed mapping file: " + path + ": " + std::strerror(errno));
+	}
+
+	madvise(mapping, length, pattern == access::sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+}
+
+void mapped_file::will_need(std::size_t offset, std::size_t size) const
+{
+	if(!mapping || offset >= length)
+	{
+		return;
+	}
+	size = std::min(size, length - offset);
+
+	// madvise needs a page aligned address
+	static const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	std::size_t aligned				   = offset - offset % page_size;
+	madvise(static_cast<unsigned char *>(mapping) + aligned, size + (offset - aligned), MADV_WILLNEED);
+}
+
+mapped_file::~mapped_file()
+{
+	if(mapping)
+	{
+		munmap(mapping, length);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef CORE_MAPPED_FILE_H
+#define CORE_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/*
+ * Read-only memory mapping of a whole file.
+ * Throws std::runtime_error if the file can't be opened or mapped.
+ * Only for files nobody rewrites while they are mapped (assets), touching pages of a file
+ * truncated meanwhile raises SIGBUS.
+ */
+class mapped_file
+{
+public:
+	/* Access pattern hint passed to madvise */
+	enum class access
+	{
+		sequential, // decoded front to back
+		random		// tiles and other scattered reads
+	};
+
+private:
+	void *mapping;
+	std::size_t length;
+
+public:
+	mapped_file(const std::string &path, access pattern = access::sequential);
+	~mapped_file();
+
+	mapped_file(const mapped_file &)			= delete;
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	/* Start reading a range in the background, ranges outside of the file are clipped */
+	void will_need(std::size_t offset, std::size_t size) const;
+
+	const unsigned char *data() const
+	{
+		return static_cast<const unsigned char *>(mapping);
+	}
+	std::size_t size() const
+	{
+		return length;
+	}
+};
+
+#endif // CORE_MAPPED_FILE_H
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "core/parallel_runtime.h"
+
+#include <algorithm>
+#include <atomic>
+#include <opencv2/core.hpp>
+#include <opencv2/core/version.hpp>
+#include <spdlog/spdlog.h>
+
+// The parallel backend API appeared in OpenCV 4.5.2
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && (CV_VERSION_MINOR > 5 || (CV_VERSION_MINOR == 5 && CV_VERSION_REVISION >= 2)))
+#define LYSSA_OPENCV_PARALLEL_BACKEND
+#include <opencv2/core/parallel/parallel_backend.hpp>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+	// The caller of a loop runs chunks too, a loop can use one thread more than the pool has
+	std::size_t clamp_workers(const thread_pool &pool, std::size_t workers)
+	{
+		return workers == 0 ? pool.get_thread_count() + 1 : std::min(workers, pool.get_thread_count() + 1);
+	}
+
+	// Budget of the stage running on this thread, 0 - the runtime's
+	thread_local int stage_workers = 0;
+
+	// OpenCV doesn't hand out its current backend, the one installed last is remembered to restore
+	// it when a nested runtime ends
+	std::shared_ptr<opencv_parallel_backend> installed_backend;
+} // namespace
+
+/* OpenCV's parallel_for_ on a thread_pool, serial once detached */
+class opencv_parallel_backend
+#ifdef LYSSA_OPENCV_PARALLEL_BACKEND
+	: public cv::parallel::ParallelForAPI
+#endif
+{
+private:
+	std::atomic<thread_pool *> pool;
+	std::atomic<int> workers;
+
+public:
+	opencv_parallel_backend(thread_pool &pool, int workers) : pool(&pool), workers(workers)
+	{
+	}
+
+	void detach()
+	{
+		pool.store(nullptr);
+	}
+
+	int get_workers() const
+	{
+		return workers.load();
+	}
+	void set_workers(int count)
+	{
+		workers.store(count);
+	}
+
+#ifdef LYSSA_OPENCV_PARALLEL_BACKEND
+	void parallel_for(int tasks, FN_parallel_for_body_cb_t body_callback, void *callback_data) override
+	{
+		thread_pool *current = pool.load();
+		int limit			 = getNumThreads();
+		if(!current || limit <= 1)
+		{
+			body_callback(0, tasks, callback_data);
+			return;
+		}
+
+		current->parallel_for(
+			0,
+			tasks,
+			[&](int start, int end) { body_callback(start, end, callback_data); },
+			static_cast<std::size_t>(std::min(limit, static_cast<int>(current->get_thread_count()) + 1)));
+	}
+
+	int getThreadNum() const override
+	{
+		// Threads outside the pool share the index after the workers
+		thread_pool *current = pool.load();
+		if(!current)
+		{
+			return 0;
+		}
+		int index = current->get_worker_index();
+		return index >= 0 ? index : static_cast<int>(current->get_thread_count());
+	}
+
+	int getNumThreads() const override
+	{
+		// OpenCV splits a loop by this, the stage's budget holds for loops this thread starts
+		return stage_workers > 0 ? stage_workers : workers.load();
+	}
+
+	int setNumThreads(int count) override
+	{
+		int previous		 = workers.load();
+		thread_pool *current = pool.load();
+		if(current && (count <= 0 || count > static_cast<int>(current->get_thread_count()) + 1))
+		{
+			count = static_cast<int>(current->get_thread_count()) + 1;
+		}
+		workers.store(count > 0 ? count : 1);
+		return previous;
+	}
+
+	const char *getName() const override
+	{
+		return "lyssa";
+	}
+#endif
+};
+
+parallel_runtime::parallel_runtime(thread_pool &pool, std::size_t opencv_workers)
+	: pool(pool), previous_framework(cv::currentParallelFramework() ? cv::currentParallelFramework() : ""),
+	  previous_opencv_threads(cv::getNumThreads()), previous_openmp_threads(0)
+{
+	std::size_t budget = clamp_workers(pool, opencv_workers);
+	backend			   = std::make_shared<opencv_parallel_backend>(pool, static_cast<int>(budget));
+
+#ifdef LYSSA_OPENCV_PARALLEL_BACKEND
+	if(previous_framework == "lyssa")
+	{
+		previous_backend = installed_backend;
+	}
+	installed_backend = backend;
+	// OpenCV's thread count isn't propagated, the budget is ours
+	cv::parallel::setParallelForBackend(backend, false);
+#else
+	cv::setNumThreads(static_cast<int>(budget));
+#endif
+
+#ifdef _OPENMP
+	// Sets this thread's cap only, regions other threads start keep their own
+	previous_openmp_threads = omp_get_max_threads();
+	omp_set_dynamic(0);
+	omp_set_num_threads(static_cast<int>(budget));
+#endif
+
+	spdlog::debug(
+		"Parallel runtime: {} workers, OpenCV loops {} with up to {} threads",
+		pool.get_thread_count(),
+		is_routed() ? "on the pool" : "on OpenCV's threads",
+		budget);
+}
+
+parallel_runtime::~parallel_runtime()
+{
+	// Loops still running or started from a stale reference run serially once the pool may be gone
+	backend->detach();
+#ifdef LYSSA_OPENCV_PARALLEL_BACKEND
+	installed_backend = previous_backend;
+	if(previous_backend)
+	{
+		cv::parallel::setParallelForBackend(previous_backend, false);
+	}
+	// Built-in frameworks aren't selectable by name, an empty backend falls back to the built-in one
+	else if(previous_framework.empty() || !cv::parallel::setParallelForBackend(previous_framework, false))
+	{
+		cv::parallel::setParallelForBackend(std::shared_ptr<cv::parallel::ParallelForAPI>(), false);
+	}
+#endif
+	cv::setNumThreads(previous_opencv_threads);
+
+#ifdef _OPENMP
+	omp_set_num_threads(previous_openmp_threads);
+#endif
+}
+
+void parallel_runtime::set_opencv_workers(std::size_t workers)
+{
+	std::size_t budget = clamp_workers(pool, workers);
+	backend->set_workers(static_cast<int>(budget));
+#ifndef LYSSA_OPENCV_PARALLEL_BACKEND
+	cv::setNumThreads(static_cast<int>(budget));
+#endif
+#ifdef _OPENMP
+	omp_set_num_threads(static_cast<int>(budget));
+#endif
+}
+
+std::size_t parallel_runtime::get_opencv_workers() const
+{
+	return static_cast<std::size_t>(backend->get_workers());
+}
+
+bool parallel_runtime::is_routed()
+{
+#ifdef LYSSA_OPENCV_PARALLEL_BACKEND
+	return true;
+#else
+	return false;
+#endif
+}
+
+parallel_runtime::stage_scope::stage_scope(std::size_t workers) : previous_workers(stage_workers), previous_openmp_threads(0)
+{
+	int budget	  = static_cast<int>(std::max<std::size_t>(1, workers));
+	stage_workers = budget;
+#ifdef _OPENMP
+	previous_openmp_threads = omp_get_max_threads();
+	omp_set_num_threads(budget);
+#endif
+}
+
+parallel_runtime::stage_scope::~stage_scope()
+{
+	stage_workers = previous_workers;
+#ifdef _OPENMP
+	omp_set_num_threads(previous_openmp_threads);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef CORE_PARALLEL_RUNTIME_H
+#define CORE_PARALLEL_RUNTIME_H
+
+#include "core/thread_pool.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+class opencv_parallel_backend;
+
+/*
+ * Puts OpenCV's and OpenMP's parallel loops under a thread_pool while alive.
+ * OpenCV's parallel_for_ runs on the pool within a core budget instead of on OpenCV's own threads.
+ * OpenMP regions can't be moved onto the pool and are capped to the same budget. OpenMP keeps
+ * that cap per thread, it holds only for regions started by the thread that created the runtime
+ * (or called set_opencv_workers), regions started from pool workers or other threads aren't capped.
+ * The libraries, the pipeline stages and our own tasks then share one set of threads instead of
+ * each sizing itself to the whole machine.
+ * The runtime's budget holds for every OpenCV loop in the process. A stage that needs a budget of
+ * its own opens a stage_scope on the thread it runs on.
+ * Destroy it after the last OpenCV call that may run in parallel, OpenCV goes back to the backend
+ * and thread count it had before. Runtimes may nest if destroyed in reverse order.
+ */
+class parallel_runtime
+{
+private:
+	thread_pool &pool;
+	std::shared_ptr<opencv_parallel_backend> backend;
+	/* What OpenCV ran its loops on before, an enclosing runtime's backend or a framework by name */
+	std::shared_ptr<opencv_parallel_backend> previous_backend;
+	std::string previous_framework;
+	int previous_opencv_threads;
+	int previous_openmp_threads;
+
+public:
+	/* opencv_workers - threads a single OpenCV loop may use, the caller included. 0 - the whole pool */
+	parallel_runtime(thread_pool &pool, std::size_t opencv_workers = 0);
+	~parallel_runtime();
+
+	parallel_runtime(const parallel_runtime &)			  = delete;
+	parallel_runtime &operator=(const parallel_runtime &) = delete;
+
+	/* The OpenMP cap changes only for the calling thread */
+	void set_opencv_workers(std::size_t workers);
+	std::size_t get_opencv_workers() const;
+
+	/* OpenCV's loops run on the pool, false if this OpenCV has no parallel backend API and only
+	   its thread count is limited */
+	static bool is_routed();
+
+	/* Budget of one stage: OpenCV loops and OpenMP regions the constructing thread starts use at
+	   most workers threads while alive, whatever the runtime's budget is. Scopes nest. Without a
+	   routed backend only the OpenMP cap holds, OpenCV's thread count is process-wide */
+	class stage_scope
+	{
+	private:
+		int previous_workers;
+		int previous_openmp_threads;
+
+	public:
+		explicit stage_scope(std::size_t workers);
+		~stage_scope();
+
+		stage_scope(const stage_scope &)			= delete;
+		stage_scope &operator=(const stage_scope &) = delete;
+	};
+};
+
+#endif // CORE_PARALLEL_RUNTIME_H
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "core/perf_overlay.h"
+
+#include "core/gl_state.h"
+
+#include <algorithm>
+#include <imgui.h>
+#include <imgui_impl_opengl3.h>
+#include <imgui_impl_sdl.h>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+	/* One row of bars for the CPU and one for the GPU, nested passes are drawn thinner on top of their parents */
+	void draw_timeline(const std::vector<frame_profiler::pass> &passes)
+	{
+		const float width		= 360.0f;
+		const float row_height	= 14.0f;
+		const float label_width = 32.0f;
+
+		float span = 0.0f;
+		for(const frame_profiler::pass &pass : passes)
+		{
+			span = std::max(span, pass.cpu_start + pass.cpu_time);
+			span = std::max(span, pass.gpu_start + pass.gpu_time);
+		}
+		if(span <= 0.0f)
+		{
+			return;
+		}
+		float scale = (width - label_width) / span;
+
+		ImDrawList *draw_list = ImGui::GetWindowDrawList();
+		ImVec2 origin		  = ImGui::GetCursorScreenPos();
+		ImU32 text_colour	  = ImGui::GetColorU32(ImGuiCol_Text);
+		draw_list->AddText(origin, text_colour, "CPU");
+		draw_list->AddText(ImVec2(origin.x, origin.y + row_height), text_colour, "GPU");
+
+		auto bar = [&](float start, float time, int row, int depth, ImU32 colour)
+		{
+			if(time < 0.0f)
+			{
+				return;
+			}
+			float inset = std::min(2.0f * depth, row_height / 2.0f - 1.0f);
+			float x0	= origin.x + label_width + std::max(start, 0.0f) * scale;
+			float x1	= std::max(x0 + 1.0f, origin.x + label_width + (start + time) * scale);
+			float y0	= origin.y + row * row_height + inset;
+			draw_list->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y0 + row_height - 2.0f * inset - 1.0f), colour);
+		};
+
+		for(std::size_t i = 0; i < passes.size(); i++)
+		{
+			const frame_profiler::pass &pass = passes[i];
+			ImU32 colour					 = ImColor::HSV(0.13f * static_cast<float>(i), 0.6f, 0.85f);
+			bar(pass.cpu_start, pass.cpu_time, 0, pass.depth, colour);
+			bar(pass.gpu_start, pass.gpu_time, 1, pass.depth, colour);
+		}
+		ImGui::Dummy(ImVec2(width, 2.0f * row_height));
+		ImGui::Text("%.2f ms from the frame start", span);
+
+		for(std::size_t i = 0; i < passes.size(); i++)
+		{
+			const frame_profiler::pass &pass = passes[i];
+			ImGui::TextColored(
+				ImColor::HSV(0.13f * static_cast<float>(i), 0.6f, 0.85f),
+				"%*s%-12s",
+				2 * pass.depth,
+				"",
+				pass.name.c_str());
+			ImGui::SameLine();
+			if(pass.gpu_time >= 0.0f)
+			{
+				ImGui::Text("CPU %6.3f ms  GPU %6.3f ms", pass.cpu_time, pass.gpu_time);
+			}
+			else
+			{
+				ImGui::Text("CPU %6.3f ms  GPU -", pass.cpu_time);
+			}
+		}
+	}
+} // namespace
+
+perf_overlay::perf_overlay(window &display)
+	: display(display), visible(false), frame_index(0), last_frame(std::chrono::steady_clock::now()), profiler(nullptr)
+{
+	frame_times.fill(0.0f);
+
+	IMGUI_CHECKVERSION();
+	ImGui::CreateContext();
+	// Stations are restarted often, don't leave an imgui.ini behind
+	ImGui::GetIO().IniFilename = nullptr;
+	ImGui::StyleColorsDark();
+
+	ImGui_ImplSDL2_InitForOpenGL(display.get_sdl_window(), display.get_context());
+	ImGui_ImplOpenGL3_Init(display.get_glsl_version());
+}
+
+perf_overlay::~perf_overlay()
+{
+	ImGui_ImplOpenGL3_Shutdown();
+	ImGui_ImplSDL2_Shutdown();
+	ImGui::DestroyContext();
+}
+
+bool perf_overlay::process_event(const SDL_Event &event)
+{
+	if(!visible)
+	{
+		return false;
+	}
+
+	ImGui_ImplSDL2_ProcessEvent(&event);
+	const ImGuiIO &io = ImGui::GetIO();
+	return io.WantCaptureMouse || io.WantCaptureKeyboard;
+}
+
+void perf_overlay::draw()
+{
+	auto now = std::chrono::steady_clock::now();
+	frame_times[frame_index] = std::chrono::duration<float, std::milli>(now - last_frame).count();
+	frame_index				 = (frame_index + 1) % frame_times.size();
+	last_frame				 = now;
+
+	if(!visible)
+	{
+		return;
+	}
+
+	ImGui_ImplOpenGL3_NewFrame();
+	ImGui_ImplSDL2_NewFrame();
+	ImGui::NewFrame();
+
+	ImGui::SetNextWindowPos(ImVec2(8.0f, 8.0f), ImGuiCond_Always);
+	ImGui::SetNextWindowBgAlpha(0.6f);
+	ImGui::Begin(
+		"Performance",
+		nullptr,
+		ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing |
+			ImGuiWindowFlags_NoNav);
+
+	float average = std::accumulate(frame_times.begin(), frame_times.end(), 0.0f) / frame_times.size();
+	float worst	  = *std::max_element(frame_times.begin(), frame_times.end());
+	ImGui::Text("%.2f ms/frame (%.1f FPS), worst %.2f ms", average, average > 0.0f ? 1000.0f / average : 0.0f, worst);
+	ImGui::PlotLines("##frame_times", frame_times.data(), static_cast<int>(frame_times.size()), static_cast<int>(frame_index), nullptr, 0.0f, worst, ImVec2(240.0f, 40.0f));
+
+	ImGui::Separator();
+	const gl_state::counters &state_calls = gl_state::get().get_last_frame();
+	std::size_t total					  = state_calls.issued + state_calls.skipped;
+	ImGui::Text(
+		"GL state calls: %zu issued, %zu skipped (%.0f%%)",
+		state_calls.issued,
+		state_calls.skipped,
+		total > 0 ? 100.0f * state_calls.skipped / total : 0.0f);
+
+	const shader_manager::statistics &shaders = display.get_shaders().get_statistics();
+	ImGui::Text(
+		"Shaders: %zu cached, %zu compiled, %zu reloads, %zu failed",
+		shaders.binary_hits,
+		shaders.binary_misses,
+		shaders.reloads,
+		shaders.reload_failures);
+
+	if(profiler && !profiler->get_last_passes().empty())
+	{
+		ImGui::Separator();
+		draw_timeline(profiler->get_last_passes());
+	}
+
+	ImGui::End();
+
+	ImGui::Render();
+	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+	// ImGui sets its own program, buffers, textures and blend state
+	gl_state::get().invalidate();
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef CORE_PERF_OVERLAY_H
+#define CORE_PERF_OVERLAY_H
+
+#include "core/frame_profiler.h"
+#include "core/window.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+/*
+ * ImGui overlay with the frame time history, the renderer's per-frame counters and,
+ * given a frame_profiler, the CPU and GPU timeline of the passes of a recent frame.
+ * Drawn last, right before the swap.
+ */
+class perf_overlay
+{
+private:
+	window &display;
+	bool visible;
+
+	std::array<float, 240> frame_times; // milliseconds, ring
+	std::size_t frame_index;
+	std::chrono::steady_clock::time_point last_frame;
+	const frame_profiler *profiler;
+
+public:
+	perf_overlay(window &display);
+	~perf_overlay();
+
+	perf_overlay(const perf_overlay &)			  = delete;
+	perf_overlay &operator=(const perf_overlay &) = delete;
+
+	/* Feed every SDL event, returns true if the overlay used it */
+	bool process_event(const SDL_Event &event);
+
+	/* Record the frame time and draw the overlay if visible */
+	void draw();
+
+	/* Passes to show, nullptr hides the timeline. The profiler must outlive the overlay */
+	void set_profiler(const frame_profiler *passes)
+	{
+		profiler = passes;
+	}
+
+	void set_visible(bool show)
+	{
+		visible = show;
+	}
+	bool is_visible() const
+	{
+		return visible;
+	}
+};
+
+#endif // CORE_PERF_OVERLAY_H
\ No newline at end of file
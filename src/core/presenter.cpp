@@ -0,0 +1,216 @@
+#include "core/presenter.h"
+
+#include "core/gl_state.h"
+
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+
+presenter::presenter(const std::string &title, std::size_t columns, std::size_t rows, int view_width, int view_height)
+	: display(title, static_cast<int>(columns) * view_width, static_cast<int>(rows) * view_height),
+	  columns(columns),
+	  rows(rows),
+	  view_width(view_width),
+	  view_height(view_height),
+	  quit(false),
+	  swap_interval(0),
+	  frame_started(false),
+	  last_present_time(0),
+	  total_present_time(0),
+	  presented_frames(0)
+{
+	if(columns == 0 || rows == 0)
+	{
+		throw std::runtime_error("Presenter needs at least one view");
+	}
+
+	for(std::size_t i = 0; i < columns * rows; i++)
+	{
+		views.push_back(std::make_unique<image_view>(display.get_shaders()));
+	}
+
+	// Lowest latency by default, vsync can be turned on with set_swap_interval
+	set_swap_interval(0);
+
+	gl_state::get().set_enabled(GL_DEPTH_TEST, false);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void presenter::begin_frame()
+{
+	if(!frame_started)
+	{
+		frame_started = true;
+		frame_start	  = std::chrono::steady_clock::now();
+	}
+}
+
+void presenter::select(std::size_t view)
+{
+	if(view >= views.size())
+	{
+		throw std::out_of_range("Presenter view index out of range: " + std::to_string(view));
+	}
+
+	begin_frame();
+
+	// Views are laid out from the top-left corner, GL viewports from the bottom-left
+	int drawable_width, drawable_height;
+	display.get_drawable_size(drawable_width, drawable_height);
+
+	int width  = drawable_width / static_cast<int>(columns);
+	int height = drawable_height / static_cast<int>(rows);
+	int x	   = static_cast<int>(view % columns) * width;
+	int y	   = static_cast<int>(rows - 1 - view / columns) * height;
+
+	gl_state::get().viewport(x, y, width, height);
+}
+
+void presenter::show(std::size_t view, const cv::Mat &image)
+{
+	select(view);
+	if(image.empty())
+	{
+		return;
+	}
+
+	views[view]->upload(image);
+	views[view]->draw();
+}
+
+void presenter::show(std::size_t view, const cv::Mat &image, dirty_region &dirty)
+{
+	select(view);
+	if(image.empty())
+	{
+		return;
+	}
+
+	views[view]->upload(image, dirty);
+	views[view]->draw();
+}
+
+void presenter::show(std::size_t view, const cv::Mat &frame, image_view::yuv_layout layout)
+{
+	select(view);
+	if(frame.empty())
+	{
+		return;
+	}
+
+	views[view]->upload(frame, layout);
+	views[view]->draw();
+}
+
+void presenter::redraw(std::size_t view, std::size_t source_view)
+{
+	if(source_view >= views.size())
+	{
+		throw std::out_of_range("Presenter view index out of range: " + std::to_string(source_view));
+	}
+
+	select(view);
+	views[source_view]->draw();
+}
+
+void presenter::present()
+{
+	if(recorder)
+	{
+		int drawable_width, drawable_height;
+		display.get_drawable_size(drawable_width, drawable_height);
+		recorder->capture(drawable_width, drawable_height);
+	}
+
+	display.swap();
+	gl_state::get().end_frame();
+
+	if(frame_started)
+	{
+		frame_started	  = false;
+		last_present_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - frame_start);
+		total_present_time += last_present_time;
+		presented_frames++;
+
+		if(presented_frames % 300 == 0)
+		{
+			const gl_state::counters &state_calls = gl_state::get().get_last_frame();
+			std::size_t uploaded_bytes = 0, saved_bytes = 0;
+			for(const std::unique_ptr<image_view> &view : views)
+			{
+				uploaded_bytes += view->get_statistics().uploaded_bytes;
+				saved_bytes += view->get_statistics().saved_bytes;
+			}
+			spdlog::debug(
+				"Presenter: last frame {} us, average {} us, {} GL state calls, {} skipped, {} MiB uploaded, {} MiB saved by dirty rectangles",
+				last_present_time.count(),
+				total_present_time.count() / static_cast<long long>(presented_frames),
+				state_calls.issued,
+				state_calls.skipped,
+				uploaded_bytes / (1024 * 1024),
+				saved_bytes / (1024 * 1024));
+		}
+	}
+
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	// Edited shaders are swapped in between frames
+	display.get_shaders().update();
+}
+
+void presenter::start_recording(const std::string &path, double fps)
+{
+	recorder = std::make_unique<frame_recorder>(path, fps);
+	spdlog::info("Recording to {}", path);
+}
+
+void presenter::stop_recording()
+{
+	// Waits for the readbacks in flight and the encoder
+	recorder.reset();
+}
+
+const std::vector<SDL_Keycode> &presenter::poll()
+{
+	keys.clear();
+
+	SDL_Event event;
+	while(SDL_PollEvent(&event))
+	{
+		switch(event.type)
+		{
+			case SDL_KEYDOWN:
+				if(event.key.keysym.sym == SDLK_ESCAPE)
+				{
+					quit = true;
+				}
+				keys.push_back(event.key.keysym.sym);
+				break;
+			case SDL_QUIT:
+				quit = true;
+				break;
+			default:
+				break;
+		}
+	}
+
+	return keys;
+}
+
+void presenter::set_swap_interval(int interval)
+{
+	if(SDL_GL_SetSwapInterval(interval) != 0)
+	{
+		// Adaptive vsync is not supported everywhere
+		if(interval == -1 && SDL_GL_SetSwapInterval(1) == 0)
+		{
+			spdlog::warn("Adaptive vsync is not supported, using vsync");
+			swap_interval = 1;
+			return;
+		}
+		spdlog::warn("Can't set swap interval {}: {}", interval, SDL_GetError());
+		return;
+	}
+	swap_interval = interval;
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#ifndef CORE_PRESENTER_H
+#define CORE_PRESENTER_H
+
+#include "core/frame_recorder.h"
+#include "core/image_view.h"
+#include "core/window.h"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+/*
+ * Replacement for cv::imshow/cv::waitKey in the tools.
+ * Several views (camera, tracks, flow) are tiled as viewports of one SDL/GL window,
+ * events are polled without blocking and the swap interval is under our control.
+ */
+class presenter
+{
+private:
+	window display;
+	std::size_t columns, rows;
+	int view_width, view_height;
+	std::vector<std::unique_ptr<image_view>> views;
+
+	std::vector<SDL_Keycode> keys;
+	bool quit;
+	int swap_interval;
+
+	bool frame_started;
+	std::chrono::steady_clock::time_point frame_start;
+	std::chrono::microseconds last_present_time;
+	std::chrono::microseconds total_present_time;
+	std::size_t presented_frames;
+
+	std::unique_ptr<frame_recorder> recorder;
+
+public:
+	/* The window is a columns x rows grid of view_width x view_height views */
+	presenter(const std::string &title, std::size_t columns, std::size_t rows, int view_width, int view_height);
+
+	/* Set the viewport to the given view, for custom drawing like flow_view::draw() */
+	void select(std::size_t view);
+
+	/* Upload a frame into the view and draw it */
+	void show(std::size_t view, const cv::Mat &image);
+
+	/* Upload the parts of an overlay that changed since the last show, see image_view::upload */
+	void show(std::size_t view, const cv::Mat &image, dirty_region &dirty);
+
+	/* Upload a raw YUV camera frame into the view and draw it, converted to RGB on the GPU */
+	void show(std::size_t view, const cv::Mat &frame, image_view::yuv_layout layout);
+
+	/* Draw the frame already uploaded to source_view into view, without uploading it again */
+	void redraw(std::size_t view, std::size_t source_view);
+
+	/* Swap buffers and clear the back buffer for the next frame */
+	void present();
+
+	/* Record the presented frames to a video or a directory of PNGs.
+	   Frames are dropped rather than slowing the tool down when the encoder falls behind */
+	void start_recording(const std::string &path, double fps = 30.0);
+	void stop_recording();
+	bool is_recording() const
+	{
+		return recorder != nullptr;
+	}
+
+	/* Drain pending events without blocking, returns the keys pressed since the last call */
+	const std::vector<SDL_Keycode> &poll();
+
+	/* Window closed or Esc pressed */
+	bool quit_requested() const
+	{
+		return quit;
+	}
+
+	/* 0 - immediate, 1 - vsync, -1 - adaptive vsync (falls back to vsync) */
+	void set_swap_interval(int interval);
+	int get_swap_interval() const
+	{
+		return swap_interval;
+	}
+
+	/* Time from the first upload of the last frame until its swap returned */
+	std::chrono::microseconds get_last_present_time() const
+	{
+		return last_present_time;
+	}
+
+	const image_view &get_view(std::size_t view) const
+	{
+		return *views.at(view);
+	}
+
+	std::size_t get_view_count() const
+	{
+		return columns * rows;
+	}
+
+	window &get_window()
+	{
+		return display;
+	}
+
+private:
+	void begin_frame();
+};
+
+#endif // CORE_PRESENTER_H
\ No newline at end of file
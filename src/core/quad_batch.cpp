@@ -0,0 +1,183 @@
+#include "core/quad_batch.h"
+
+#include "core/gl_state.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <string>
+
+namespace
+{
+	// One instance per quad, corners from gl_VertexID
+	const std::string batch_vertex_shader = "#version 330 core\n"
+											"\n"
+											"layout(location = 0) in vec4 a_Rect;\n"
+											"layout(location = 1) in vec4 a_TexRect;\n"
+											"layout(location = 2) in float a_Layer;\n"
+											"\n"
+											"uniform mat4 u_MVP;\n"
+											"\n"
+											"out vec3 v_TexCoord;\n"
+											"\n"
+											"void main() {\n"
+											"	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+											"	vec2 position = a_Rect.xy + corner * a_Rect.zw;\n"
+											"	v_TexCoord = vec3(mix(a_TexRect.xy, a_TexRect.zw, corner), a_Layer);\n"
+											"	gl_Position = u_MVP * vec4(position, 0.0, 1.0);\n"
+											"}\n";
+
+	const std::string batch_fragment_shader = "#version 330 core\n"
+											  "\n"
+											  "layout(location = 0) out vec4 color;\n"
+											  "\n"
+											  "in vec3 v_TexCoord;\n"
+											  "\n"
+											  "uniform sampler2DArray u_Layers;\n"
+											  "uniform int u_Flow;\n"
+											  "uniform float u_MaxMagnitude;\n"
+											  "\n"
+											  "vec3 hsv_to_rgb(vec3 c)\n"
+											  "{\n"
+											  "	vec4 k = vec4(1.0, 2.0 / 3.0, 1.0 / 3.0, 3.0);\n"
+											  "	vec3 p = abs(fract(c.xxx + k.xyz) * 6.0 - k.www);\n"
+											  "	return c.z * mix(k.xxx, clamp(p - k.xxx, 0.0, 1.0), c.y);\n"
+											  "}\n"
+											  "\n"
+											  "void main()\n"
+											  "{\n"
+											  "	vec4 texel = texture(u_Layers, v_TexCoord);\n"
+											  "	if(u_Flow == 0)\n"
+											  "	{\n"
+											  "		color = vec4(texel.rgb, 1.0);\n"
+											  "		return;\n"
+											  "	}\n"
+											  "	float magnitude = clamp(length(texel.xy) / u_MaxMagnitude, 0.0, 1.0);\n"
+											  "	float hue = fract(atan(texel.y, texel.x) / 6.28318530718 + 1.0);\n"
+											  "	color = vec4(hsv_to_rgb(vec3(hue, 1.0, magnitude)), 1.0);\n"
+											  "}\n";
+
+	constexpr std::uint64_t u_mvp			= name_hash("u_MVP");
+	constexpr std::uint64_t u_layers		= name_hash("u_Layers");
+	constexpr std::uint64_t u_flow			= name_hash("u_Flow");
+	constexpr std::uint64_t u_max_magnitude = name_hash("u_MaxMagnitude");
+} // namespace
+
+quad_batch::quad_batch(shader_manager &shaders)
+	: program(shaders.get_program("quad_batch", batch_vertex_shader, batch_fragment_shader)),
+	  capacity(0),
+	  transform(1.0f),
+	  max_magnitude(16.0f),
+	  last_draw_calls(0),
+	  last_quads(0)
+{
+	glGenVertexArrays(1, &vao);
+	gl_state::get().bind_vertex_array(vao);
+	glGenBuffers(1, &instance_buffer);
+	gl_state::get().bind_buffer(GL_ARRAY_BUFFER, instance_buffer);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(quad), (void *)offsetof(quad, x));
+	glVertexAttribDivisor(0, 1);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(quad), (void *)offsetof(quad, u0));
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(quad), (void *)offsetof(quad, layer));
+	glVertexAttribDivisor(2, 1);
+}
+
+quad_batch::~quad_batch()
+{
+	gl_state::get().forget_buffer(instance_buffer);
+	gl_state::get().forget_vertex_array(vao);
+	glDeleteBuffers(1, &instance_buffer);
+	glDeleteVertexArrays(1, &vao);
+}
+
+void quad_batch::begin(int width, int height)
+{
+	// Pixel rows grow downwards
+	begin(glm::ortho(0.0f, static_cast<float>(std::max(width, 1)), static_cast<float>(std::max(height, 1)), 0.0f));
+}
+
+void quad_batch::begin(const glm::mat4 &transform)
+{
+	this->transform = transform;
+	queued.clear();
+}
+
+void quad_batch::add(const texture_array &source, int layer, float x, float y, float width, float height)
+{
+	add(source, layer, x, y, width, height, 0.0f, 0.0f, 1.0f, 1.0f);
+}
+
+void quad_batch::add(
+	const texture_array &source, int layer, float x, float y, float width, float height, float u0, float v0, float u1, float v1)
+{
+	queued.push_back({&source, {x, y, width, height, u0, v0, u1, v1, static_cast<float>(layer)}});
+}
+
+void quad_batch::end()
+{
+	last_draw_calls = 0;
+	last_quads		= queued.size();
+	if(queued.empty())
+	{
+		return;
+	}
+
+	// Grouped by array so each array is one draw, by layer for texture cache locality
+	std::stable_sort(queued.begin(), queued.end(), [](const queued_quad &a, const queued_quad &b) {
+		if(a.source != b.source)
+		{
+			return a.source->get_id() < b.source->get_id();
+		}
+		return a.instance.layer < b.instance.layer;
+	});
+
+	instances.resize(queued.size());
+	for(std::size_t i = 0; i < queued.size(); i++)
+	{
+		instances[i] = queued[i].instance;
+	}
+
+	// Orphan every frame, the previous frame's instances may still be read by the GPU
+	gl_state::get().bind_buffer(GL_ARRAY_BUFFER, instance_buffer);
+	capacity = std::max(capacity, instances.size());
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(quad), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(quad), instances.data());
+
+	program.set_matrix(u_mvp, glm::value_ptr(transform));
+	program.set(u_layers, 0);
+	program.set(u_max_magnitude, max_magnitude);
+	gl_state::get().bind_vertex_array(vao);
+
+	std::size_t first = 0;
+	while(first < queued.size())
+	{
+		const texture_array *source = queued[first].source;
+		std::size_t last			= first;
+		while(last < queued.size() && queued[last].source == source)
+		{
+			last++;
+		}
+
+		program.set(u_flow, source->get_content() == texture_array::content::flow ? 1 : 0);
+		program.use();
+		source->bind(0);
+
+		// Instance offset through the attribute base, GL 3.3 has no base instance
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(quad), (void *)(first * sizeof(quad) + offsetof(quad, x)));
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(quad), (void *)(first * sizeof(quad) + offsetof(quad, u0)));
+		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(quad), (void *)(first * sizeof(quad) + offsetof(quad, layer)));
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(last - first));
+
+		last_draw_calls++;
+		first = last;
+	}
+
+	queued.clear();
+}
\ No newline at end of file
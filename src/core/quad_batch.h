@@ -0,0 +1,91 @@
+#ifndef CORE_QUAD_BATCH_H
+#define CORE_QUAD_BATCH_H
+
+// clang-format off
+#include <GL/glew.h>
+#include <GL/gl.h>
+// clang-format on
+
+#include "core/shader_manager.h"
+#include "core/texture_array.h"
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+/*
+ * Batched image quads from texture arrays.
+ * Quads are collected between begin() and end(), sorted by texture array and layer,
+ * streamed into one instance buffer and drawn with one instanced draw per texture array.
+ * Flow arrays are colourized like flow_view.
+ */
+class quad_batch
+{
+private:
+	struct quad
+	{
+		float x, y, width, height; // transformed by u_MVP
+		float u0, v0, u1, v1;
+		float layer;
+	};
+
+	struct queued_quad
+	{
+		const texture_array *source;
+		quad instance;
+	};
+
+	shader_program &program;
+	GLuint vao;
+	GLuint instance_buffer;
+	std::size_t capacity; // instances the buffer holds
+
+	std::vector<queued_quad> queued;
+	std::vector<quad> instances;
+
+	glm::mat4 transform;
+	float max_magnitude;
+
+	std::size_t last_draw_calls;
+	std::size_t last_quads;
+
+public:
+	quad_batch(shader_manager &shaders);
+	~quad_batch();
+
+	quad_batch(const quad_batch &)			  = delete;
+	quad_batch &operator=(const quad_batch &) = delete;
+
+	/* Start a batch for a target (usually the current viewport) of the given size in pixels,
+	   quads are placed in pixels with the origin at the top-left corner */
+	void begin(int width, int height);
+
+	/* Start a batch with quads placed in any space, transform maps it to clip space */
+	void begin(const glm::mat4 &transform);
+
+	/* Layer of the array at (x, y) with the given size, the array must outlive end() */
+	void add(const texture_array &source, int layer, float x, float y, float width, float height);
+
+	/* Part of a layer, u/v in [0, 1] with v = 0 at the top row */
+	void add(const texture_array &source, int layer, float x, float y, float width, float height, float u0, float v0, float u1, float v1);
+
+	/* Sort, upload and draw everything added since begin() */
+	void end();
+
+	/* Flow magnitude drawn at full brightness */
+	void set_max_magnitude(float magnitude)
+	{
+		max_magnitude = magnitude;
+	}
+
+	std::size_t get_last_draw_calls() const
+	{
+		return last_draw_calls;
+	}
+	std::size_t get_last_quads() const
+	{
+		return last_quads;
+	}
+};
+
+#endif // CORE_QUAD_BATCH_H
\ No newline at end of file
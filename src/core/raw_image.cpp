@@ -0,0 +1,172 @@
+#include "core/raw_image.h"
+
+#include "core/mapped_file.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <stdexcept>
+#include <system_error>
+
+namespace
+{
+	constexpr char raw_magic[4]			= {'L', 'Y', 'R', 'I'};
+	constexpr std::uint32_t raw_version = 1;
+	constexpr std::uint32_t raw_rgba8	= 1;
+	constexpr std::size_t raw_alignment = 4096;
+
+	struct file_header
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint32_t format;
+		std::uint32_t reserved;
+		std::uint64_t data_offset;
+	};
+} // namespace
+
+raw_image::raw_image(const unsigned char *data, std::size_t size) : pixels(nullptr), width(0), height(0)
+{
+	file_header header;
+	if(size < sizeof(header))
+	{
+		throw std::runtime_error("Not a raw image");
+	}
+	std::memcpy(&header, data, sizeof(header));
+
+	if(std::memcmp(header.magic, raw_magic, sizeof(raw_magic)) != 0)
+	{
+		throw std::runtime_error("Not a raw image");
+	}
+	if(header.version != raw_version || header.format != raw_rgba8)
+	{
+		throw std::runtime_error("Unsupported raw image version " + std::to_string(header.version) + " format " + std::to_string(header.format));
+	}
+	if(header.width == 0 || header.height == 0 || header.width > 65536 || header.height > 65536)
+	{
+		throw std::runtime_error("Corrupt raw image header");
+	}
+
+	width  = static_cast<int>(header.width);
+	height = static_cast<int>(header.height);
+	if(header.data_offset < sizeof(header) || size < header.data_offset || size - header.data_offset < get_size_bytes())
+	{
+		throw std::runtime_error("Truncated raw image");
+	}
+	pixels = data + header.data_offset;
+}
+
+void raw_image::write(const std::string &path, const cv::Mat &image)
+{
+	if(image.empty() || image.depth() != CV_8U)
+	{
+		throw std::runtime_error("Raw images are written from 8-bit images");
+	}
+
+	cv::Mat rgba;
+	switch(image.channels())
+	{
+		case 1:
+			cv::cvtColor(image, rgba, cv::COLOR_GRAY2RGBA);
+			break;
+		case 3:
+			cv::cvtColor(image, rgba, cv::COLOR_BGR2RGBA);
+			break;
+		case 4:
+			cv::cvtColor(image, rgba, cv::COLOR_BGRA2RGBA);
+			break;
+		default:
+			throw std::runtime_error("Unsupported channel count for a raw image: " + std::to_string(image.channels()));
+	}
+	cv::flip(rgba, rgba, 0);
+
+	file_header header;
+	std::memcpy(header.magic, raw_magic, sizeof(raw_magic));
+	header.version	   = raw_version;
+	header.width	   = static_cast<std::uint32_t>(rgba.cols);
+	header.height	   = static_cast<std::uint32_t>(rgba.rows);
+	header.format	   = raw_rgba8;
+	header.reserved	   = 0;
+	header.data_offset = raw_alignment;
+
+	// Written aside and renamed, a reader never maps a half written image
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		static const char zeros[raw_alignment] = {};
+		file.write(zeros, raw_alignment - sizeof(header));
+		for(int y = 0; y < rgba.rows; y++)
+		{
+			file.write(reinterpret_cast<const char *>(rgba.ptr(y)), static_cast<std::streamsize>(rgba.cols) * 4);
+		}
+
+		if(!file)
+		{
+			throw std::runtime_error("Can't write raw image " + temporary);
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if(error)
+	{
+		throw std::runtime_error("Can't store raw image " + path + ": " + error.message());
+	}
+}
+
+bool is_raw_image_file(const std::string &path)
+{
+	std::size_t dot = path.find_last_of('.');
+	if(dot == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+	return extension == "lyr";
+}
+
+cv::Mat read_image(const std::string &path, int flags)
+{
+	mapped_file file(path);
+
+	cv::Mat image;
+	if(is_raw_image_file(path))
+	{
+		raw_image raw(file.data(), file.size());
+		cv::Mat rgba(raw.get_height(), raw.get_width(), CV_8UC4, const_cast<unsigned char *>(raw.get_pixels()));
+		int conversion = flags == cv::IMREAD_GRAYSCALE ? cv::COLOR_RGBA2GRAY
+						 : flags == cv::IMREAD_COLOR   ? cv::COLOR_RGBA2BGR
+													   : cv::COLOR_RGBA2BGRA;
+		cv::cvtColor(rgba, image, conversion);
+		cv::flip(image, image, 0);
+		return image;
+	}
+
+	// imdecode reads the mapping in place, cv::imread would copy the file into a buffer first.
+	// A Mat's columns are an int, files too large for one are left to cv::imread
+	if(file.size() > static_cast<std::size_t>(INT_MAX))
+	{
+		image = cv::imread(path, flags);
+	}
+	else
+	{
+		cv::Mat encoded(1, static_cast<int>(file.size()), CV_8UC1, const_cast<unsigned char *>(file.data()));
+		image = cv::imdecode(encoded, flags);
+	}
+	if(image.empty())
+	{
+		throw std::runtime_error("Failed decoding image: " + path);
+	}
+	return image;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef CORE_RAW_IMAGE_H
+#define CORE_RAW_IMAGE_H
+
+#include <cstddef>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <string>
+
+/*
+ * Raw image container (.lyr) uploaded without decoding.
+ * Pixels are RGBA8, bottom row first like the textures loaded by stb_image, and start on a
+ * 4 KiB boundary, so a mapped file goes to glTexImage2D as it is.
+ * raw_image only parses the container, the memory it was given must outlive it.
+ */
+class raw_image
+{
+private:
+	const unsigned char *pixels;
+	int width, height;
+
+public:
+	/* Throws std::runtime_error if the data isn't a valid container */
+	raw_image(const unsigned char *data, std::size_t size);
+
+	/* Swizzle and flip an 8-bit gray, BGR or BGRA image and write it to path.
+	   Throws std::runtime_error if the image is unsupported or the file can't be written */
+	static void write(const std::string &path, const cv::Mat &image);
+
+	/* Tightly packed RGBA8 rows, bottom row first */
+	const unsigned char *get_pixels() const
+	{
+		return pixels;
+	}
+	int get_width() const
+	{
+		return width;
+	}
+	int get_height() const
+	{
+		return height;
+	}
+	std::size_t get_size_bytes() const
+	{
+		return static_cast<std::size_t>(width) * height * 4;
+	}
+};
+
+/* File extension of raw images */
+bool is_raw_image_file(const std::string &path);
+
+/* Decode an image file from a mapping with cv::imdecode, raw images are only converted back to BGR(A) or gray.
+   Throws std::runtime_error if the file can't be read or decoded */
+cv::Mat read_image(const std::string &path, int flags = cv::IMREAD_UNCHANGED);
+
+#endif // CORE_RAW_IMAGE_H
\ No newline at end of file
@@ -1,7 +1,14 @@
 #include "core/shader.h"
 
+#include "core/mapped_file.h"
+#include "core/raw_image.h"
+
 #include <SDL2/SDL.h>
+#include <algorithm>
+#include <cctype>
+#include <climits>
 #include <exception>
+#include <gli/gli.hpp>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
 #include <string>
@@ -11,6 +18,8 @@
 
 std::string read_file(std::string file_name)
 {
+	// Read, not mapped: shader sources are rewritten by editors while they are watched, and a
+	// mapped file truncated under the reader raises SIGBUS instead of a load error
 	SDL_RWops *file = SDL_RWFromFile(file_name.c_str(), "rb");
 	size_t size;
 
@@ -35,87 +44,15 @@ std::string read_file(std::string file_name)
 
 GLuint load_shader(std::string vertex_file_path, std::string fragment_file_path)
 {
-	// shaders
-	std::string vertex_shader;
-	std::string fragment_shader;
-
 	try
 	{
-		vertex_shader	= read_file("simple_vertex_shader.vert");
-		fragment_shader = read_file("simple_fragment_shader.frag");
+		return create_program(read_file(vertex_file_path), read_file(fragment_file_path));
 	}
 	catch(std::exception &e)
 	{
 		spdlog::error("Error: {}", e.what());
-		return NULL;
-	}
-
-	// States
-	GLint result = GL_FALSE;
-	int info_log_length;
-
-	// Create the shaders
-	GLuint vertex_shader_id	  = glCreateShader(GL_VERTEX_SHADER);
-	GLuint fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
-
-	// Compile vertex shader
-	char const *vertex_source_pointer = vertex_shader.c_str();
-	glShaderSource(vertex_shader_id, 1, &vertex_source_pointer, NULL);
-	glCompileShader(vertex_shader_id);
-
-	// Check vertex shader
-	glGetShaderiv(vertex_shader_id, GL_COMPILE_STATUS, &result);
-	glGetShaderiv(vertex_shader_id, GL_INFO_LOG_LENGTH, &info_log_length);
-
-	if(info_log_length > 0)
-	{
-		std::vector<char> vertex_shader_error_message(info_log_length + 1);
-		glGetShaderInfoLog(vertex_shader_id, info_log_length, NULL, &vertex_shader_error_message[0]);
-		spdlog::error("{}", &vertex_shader_error_message[0]);
-		return NULL;
-	}
-
-	// Compile fragment shader
-	char const *fragment_source_pointer = fragment_shader.c_str();
-	glShaderSource(fragment_shader_id, 1, &fragment_source_pointer, NULL);
-	glCompileShader(fragment_shader_id);
-
-	// Check fragment shader
-	glGetShaderiv(fragment_shader_id, GL_COMPILE_STATUS, &result);
-	glGetShaderiv(fragment_shader_id, GL_INFO_LOG_LENGTH, &info_log_length);
-
-	if(info_log_length > 0)
-	{
-		std::vector<char> fragment_shader_error_message(info_log_length + 1);
-		glGetShaderInfoLog(fragment_shader_id, info_log_length, NULL, &fragment_shader_error_message[0]);
-		spdlog::error("{}", &fragment_shader_error_message[0]);
-		return NULL;
-	}
-
-	// Link the program
-	GLuint program_id = glCreateProgram();
-	glAttachShader(program_id, vertex_shader_id);
-	glAttachShader(program_id, fragment_shader_id);
-	glLinkProgram(program_id);
-
-	// Check the program
-	glGetProgramiv(program_id, GL_LINK_STATUS, &result);
-	glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &info_log_length);
-	if(info_log_length > 0)
-	{
-		std::vector<char> program_error_message(info_log_length + 1);
-		glGetProgramInfoLog(program_id, info_log_length, NULL, &program_error_message[0]);
-		spdlog::error("{}", &program_error_message[0]);
-		return NULL;
+		return 0;
 	}
-
-	glDetachShader(program_id, vertex_shader_id);
-	glDetachShader(program_id, fragment_shader_id);
-
-	glDeleteShader(vertex_shader_id);
-	glDeleteShader(fragment_shader_id);
-
-	return program_id;
 }
 
 GLuint compile_shader(unsigned int type, const std::string &source)
@@ -129,52 +66,226 @@ GLuint compile_shader(unsigned int type, const std::string &source)
 	glGetShaderiv(id, GL_COMPILE_STATUS, &result);
 	if(result == GL_FALSE)
 	{
-		int length;
+		int length = 0;
 		glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
-		char *message = (char *)malloc(length);
-		glGetShaderInfoLog(id, length, &length, message);
-		throw std::runtime_error("Compile shader error");
+		std::string message(length > 0 ? length : 1, '\0');
+		glGetShaderInfoLog(id, static_cast<GLsizei>(message.size()), nullptr, &message[0]);
 		glDeleteShader(id);
-		return 0;
+		throw std::runtime_error(
+			std::string("Compile ") + (type == GL_VERTEX_SHADER ? "vertex" : "fragment") + " shader error: " + message.c_str());
 	}
 	return id;
 }
 
-GLuint create_program(const std::string &vertex_shader, const std::string &fragment_shader)
+GLuint create_program(const std::string &vertex_shader, const std::string &fragment_shader, bool retrievable_binary)
 {
+	unsigned int vs = compile_shader(GL_VERTEX_SHADER, vertex_shader);
+	unsigned int fs;
+	try
+	{
+		fs = compile_shader(GL_FRAGMENT_SHADER, fragment_shader);
+	}
+	catch(...)
+	{
+		glDeleteShader(vs);
+		throw;
+	}
+
 	unsigned int program = glCreateProgram();
-	unsigned int vs		 = compile_shader(GL_VERTEX_SHADER, vertex_shader);
-	unsigned int fs		 = compile_shader(GL_FRAGMENT_SHADER, fragment_shader);
+	if(retrievable_binary)
+	{
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 
 	glAttachShader(program, vs);
 	glAttachShader(program, fs);
 	glLinkProgram(program);
-	glValidateProgram(program);
 
+	glDetachShader(program, vs);
+	glDetachShader(program, fs);
 	glDeleteShader(vs);
 	glDeleteShader(fs);
 
+	int result;
+	glGetProgramiv(program, GL_LINK_STATUS, &result);
+	if(result == GL_FALSE)
+	{
+		int length = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+		std::string message(length > 0 ? length : 1, '\0');
+		glGetProgramInfoLog(program, static_cast<GLsizei>(message.size()), nullptr, &message[0]);
+		glDeleteProgram(program);
+		throw std::runtime_error(std::string("Link program error: ") + message.c_str());
+	}
+
 	return program;
 }
 
-texture::texture(const std::string path)
+bool is_gli_texture_file(const std::string &path)
+{
+	std::size_t dot = path.find_last_of('.');
+	if(dot == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+	return extension == "ktx" || extension == "dds" || extension == "kmg";
+}
+
+gli::texture load_gli_texture(const void *data, std::size_t size, const std::string &path)
+{
+	gli::texture image = gli::load(static_cast<const char *>(data), size);
+	if(image.empty())
+	{
+		throw std::runtime_error("Failed loading texture: " + path);
+	}
+	if(image.target() != gli::TARGET_2D)
+	{
+		return image;
+	}
+
+	if(gli::is_compressed(image.format()) && !gli::is_s3tc_compressed(image.format()))
+	{
+		spdlog::warn("{}: block format can't be flipped, the texture is shown upside down", path);
+		return image;
+	}
+	return gli::flip(gli::texture2d(image));
+}
+
+texture::texture(const std::string path) : localBuffer(nullptr), width(0), height(0), BPP(0), size_bytes(0)
 {
+	// Files are parsed and decoded straight from the mapping
+	mapped_file file(path);
+
+	if(is_gli_texture_file(path))
+	{
+		upload_gli(load_gli_texture(file.data(), file.size(), path));
+		return;
+	}
+
+	if(is_raw_image_file(path))
+	{
+		// Nothing to decode, the mapped pixels are uploaded as they are
+		raw_image image(file.data(), file.size());
+		width	   = image.get_width();
+		height	   = image.get_height();
+		BPP		   = 4;
+		size_bytes = image.get_size_bytes();
+
+		create_storage();
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.get_pixels());
+		return;
+	}
+
+	// stb_image takes the size as an int
+	if(file.size() > static_cast<std::size_t>(INT_MAX))
+	{
+		throw std::runtime_error("Image too large to decode: " + path);
+	}
 	stbi_set_flip_vertically_on_load(1);
-	localBuffer = stbi_load(path.c_str(), &width, &height, &BPP, 4);
+	localBuffer = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &BPP, 4);
+	if(!localBuffer)
+	{
+		throw std::runtime_error("Failed decoding image: " + path + ": " + stbi_failure_reason());
+	}
+	size_bytes = static_cast<std::size_t>(width) * height * 4;
+
+	create_storage();
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, localBuffer);
+
+	stbi_image_free(localBuffer);
+	localBuffer = nullptr;
+}
+
+texture::texture(int width, int height)
+	: localBuffer(nullptr), width(width), height(height), BPP(4), size_bytes(static_cast<std::size_t>(width) * height * 4)
+{
+	create_storage();
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+}
+
+texture::texture(const gli::texture &image) : localBuffer(nullptr), width(0), height(0), BPP(0), size_bytes(0)
+{
+	upload_gli(image);
+}
+
+void texture::upload_gli(const gli::texture &image)
+{
+	if(image.empty() || image.target() != gli::TARGET_2D)
+	{
+		throw std::runtime_error("Only non-empty 2D textures are supported");
+	}
+
+	gli::gl gl(gli::gl::PROFILE_GL33);
+	const gli::gl::format format = gl.translate(image.format(), image.swizzles());
+	const bool compressed		 = gli::is_compressed(image.format());
+	const GLint levels			 = static_cast<GLint>(image.levels());
+
+	width  = image.extent(0).x;
+	height = image.extent(0).y;
+
+	create_storage();
+	if(levels > 1)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, &format.Swizzles[0]);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for(GLint level = 0; level < levels; level++)
+	{
+		const gli::extent3d extent = image.extent(level);
+		const GLsizei level_size   = static_cast<GLsizei>(image.size(level));
+
+		if(compressed)
+		{
+			glCompressedTexImage2D(
+				GL_TEXTURE_2D, level, format.Internal, extent.x, extent.y, 0, level_size, image.data(0, 0, level));
+		}
+		else
+		{
+			glTexImage2D(
+				GL_TEXTURE_2D,
+				level,
+				format.Internal,
+				extent.x,
+				extent.y,
+				0,
+				format.External,
+				format.Type,
+				image.data(0, 0, level));
+		}
+		size_bytes += level_size;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	GLenum error = glGetError();
+	if(error != GL_NO_ERROR)
+	{
+		// The destructor doesn't run for a throwing constructor
+		gl_state::get().forget_texture(rendererId);
+		glDeleteTextures(1, &rendererId);
+		throw std::runtime_error("OpenGL error after uploading texture levels: " + std::to_string(error));
+	}
+}
 
+void texture::create_storage()
+{
 	glGenTextures(1, &rendererId);
-	glBindTexture(GL_TEXTURE_2D, rendererId);
+	gl_state::get().bind_texture(GL_TEXTURE_2D, rendererId);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+}
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, localBuffer);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	if(localBuffer)
-	{
-		stbi_image_free(localBuffer);
-	}
+void texture::upload_rows(int first_row, int row_count, const unsigned char *rgba) const
+{
+	gl_state::get().bind_texture(GL_TEXTURE_2D, rendererId);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first_row, width, row_count, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
 }
\ No newline at end of file
@@ -6,13 +6,23 @@
 #include <GL/gl.h>
 // clang-format on
 
+#include "core/gl_state.h"
+
+#include <cstddef>
 #include <string>
 
+namespace gli
+{
+	class texture;
+} // namespace gli
+
 GLuint load_shader(std::string vertex_file_path, std::string fragment_file_path);
 std::string read_file(std::string file_name);
 
+/* Compile and link, throws std::runtime_error with the info log on failure */
 GLuint compile_shader(unsigned int type, const std::string &source);
-GLuint create_program(const std::string &vertex_shader, const std::string &fragment_shader);
+/* retrievable_binary - the linked program will be read back with glGetProgramBinary */
+GLuint create_program(const std::string &vertex_shader, const std::string &fragment_shader, bool retrievable_binary = false);
 
 class texture
 {
@@ -21,26 +31,61 @@ private:
 	std::string filePath;
 	unsigned char *localBuffer;
 	int width, height, BPP;
+	std::size_t size_bytes;
+
+	void create_storage();
+	void upload_gli(const gli::texture &image);
 
 public:
+	/* KTX, DDS and KMG files are loaded with their mip chain and block compression through gli,
+	   everything else is decoded by stb_image to RGBA8 */
 	texture(const std::string path);
+	/* Empty RGBA8 texture, filled with upload_rows */
+	texture(int width, int height);
+	/* Texture loaded by gli, compressed levels go straight to glCompressedTexImage2D */
+	texture(const gli::texture &image);
 	~texture()
 	{
+		gl_state::get().forget_texture(rendererId);
 		glDeleteTextures(1, &rendererId);
 	}
 
+	texture(const texture &)			= delete;
+	texture &operator=(const texture &) = delete;
+
+	/* Upload row_count tightly packed RGBA8 rows starting at first_row */
+	void upload_rows(int first_row, int row_count, const unsigned char *rgba) const;
+
 	void bind(GLuint slot = 0) const
 	{
-		glActiveTexture(GL_TEXTURE0 + slot);
-		glBindTexture(GL_TEXTURE_2D, rendererId);
+		gl_state::get().active_texture(slot);
+		gl_state::get().bind_texture(GL_TEXTURE_2D, rendererId);
 	}
 	void unbind() const
 	{
-		glBindTexture(GL_TEXTURE_2D, 0);
+		gl_state::get().bind_texture(GL_TEXTURE_2D, 0);
+	}
+
+	GLuint get_id() const
+	{
+		return rendererId;
+	}
+	int get_width() const
+	{
+		return width;
+	}
+	int get_height() const
+	{
+		return height;
+	}
+	/* GPU memory used by all levels */
+	std::size_t get_size_bytes() const
+	{
+		return size_bytes;
 	}
 
 	// Side : res[0] = width; res[1] = height;
-	float *get_scale_normalized()
+	float *get_scale_normalized() const
 	{
 		float *res = (float *)malloc(2 * sizeof(float));
 		if(this->width > this->height)
@@ -57,4 +102,12 @@ public:
 	}
 };
 
+/* File extensions handled by gli */
+bool is_gli_texture_file(const std::string &path);
+
+/* Parse a KTX/DDS/KMG file and flip it bottom row first, the way stb_image loads the other
+   formats. Uncompressed and S3TC (BC1-BC3) levels are flipped, other block formats can't be
+   and are kept as they are with a warning. Throws std::runtime_error if the file can't be parsed */
+gli::texture load_gli_texture(const void *data, std::size_t size, const std::string &path);
+
 #endif // CORE_SHADER_H
\ No newline at end of file
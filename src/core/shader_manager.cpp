@@ -0,0 +1,324 @@
+#include "core/shader_manager.h"
+
+#include "core/hash.h"
+#include "core/shader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	constexpr char binary_magic[4]			  = {'L', 'Y', 'P', 'B'};
+	constexpr std::uint32_t binary_version	  = 1;
+	constexpr std::size_t binary_max_size	  = 64 * 1024 * 1024;
+
+	struct binary_header
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint64_t key;
+		std::uint32_t format;
+		std::uint32_t length;
+	};
+
+	std::string gl_string(GLenum name)
+	{
+		const GLubyte *value = glGetString(name);
+		return value ? reinterpret_cast<const char *>(value) : "";
+	}
+} // namespace
+
+shader_manager::shader_manager(const std::string &cache_directory)
+	: cache_directory(cache_directory),
+	  binaries_supported(false)
+{
+	driver = gl_string(GL_VENDOR) + '\n' + gl_string(GL_RENDERER) + '\n' + gl_string(GL_VERSION);
+
+	GLint formats = 0;
+	if(GLEW_ARB_get_program_binary)
+	{
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	}
+	binaries_supported = formats > 0 && !cache_directory.empty();
+
+	if(binaries_supported)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(cache_directory, error);
+		if(error)
+		{
+			spdlog::warn("Can't create the shader cache directory {}: {}", cache_directory, error.message());
+			binaries_supported = false;
+		}
+	}
+
+	spdlog::debug("Shader binary cache {}", binaries_supported ? "in " + cache_directory : std::string("disabled"));
+}
+
+shader_manager::~shader_manager()
+{
+	// The watcher thread may still be linking into the share group
+	watcher.reset();
+	for(shader_watcher::result &reload : pending_reloads)
+	{
+		glDeleteProgram(reload.program);
+		glDeleteSync(reload.fence);
+	}
+	programs.clear();
+
+	spdlog::debug(
+		"Shader programs: {} from the binary cache, {} compiled, {} binaries rejected, {} reloads, {} failed reloads",
+		stats.binary_hits,
+		stats.binary_misses,
+		stats.binary_rejected,
+		stats.reloads,
+		stats.reload_failures);
+}
+
+std::uint64_t shader_manager::make_key(const std::string &vertex_shader, const std::string &fragment_shader) const
+{
+	std::string keyed = driver;
+	keyed += '\0';
+	keyed += vertex_shader;
+	keyed += '\0';
+	keyed += fragment_shader;
+	return hash_bytes(keyed.data(), keyed.size());
+}
+
+std::string shader_manager::cache_path(std::uint64_t key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(cache_directory) / name).string();
+}
+
+GLuint shader_manager::load_binary(std::uint64_t key)
+{
+	std::string path = cache_path(key);
+	std::ifstream file(path, std::ios::binary);
+	if(!file)
+	{
+		return 0;
+	}
+
+	binary_header header;
+	file.read(reinterpret_cast<char *>(&header), sizeof(header));
+	if(!file || std::char_traits<char>::compare(header.magic, binary_magic, 4) != 0 || header.version != binary_version ||
+	   header.key != key || header.length == 0 || header.length > binary_max_size)
+	{
+		spdlog::warn("Ignoring invalid shader binary {}", path);
+		return 0;
+	}
+
+	std::vector<char> binary(header.length);
+	file.read(binary.data(), binary.size());
+	if(!file)
+	{
+		spdlog::warn("Ignoring truncated shader binary {}", path);
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+	// A driver update can invalidate binaries even when the version string stays the same
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if(linked == GL_FALSE)
+	{
+		glDeleteProgram(program);
+		std::error_code error;
+		std::filesystem::remove(path, error);
+		stats.binary_rejected++;
+		return 0;
+	}
+
+	return program;
+}
+
+void shader_manager::store_binary(GLuint program, std::uint64_t key) const
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0)
+	{
+		return;
+	}
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+
+	binary_header header;
+	std::char_traits<char>::copy(header.magic, binary_magic, 4);
+	header.version = binary_version;
+	header.key	   = key;
+	header.format  = format;
+	header.length  = static_cast<std::uint32_t>(length);
+
+	// Written aside and renamed, a station killed mid-write never leaves a partial binary behind
+	std::string path	  = cache_path(key);
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		file.write(binary.data(), length);
+		if(!file)
+		{
+			spdlog::warn("Can't write shader binary {}", temporary);
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if(error)
+	{
+		spdlog::warn("Can't store shader binary {}: {}", path, error.message());
+	}
+}
+
+GLuint shader_manager::build(const std::string &vertex_shader, const std::string &fragment_shader)
+{
+	std::uint64_t key = make_key(vertex_shader, fragment_shader);
+
+	GLuint program = binaries_supported ? load_binary(key) : 0;
+	if(program != 0)
+	{
+		stats.binary_hits++;
+		return program;
+	}
+
+	program = create_program(vertex_shader, fragment_shader, binaries_supported);
+	stats.binary_misses++;
+	if(binaries_supported)
+	{
+		store_binary(program, key);
+	}
+	return program;
+}
+
+shader_program &shader_manager::get_program(const std::string &name, const std::string &vertex_shader, const std::string &fragment_shader)
+{
+	std::uint64_t key = make_key(vertex_shader, fragment_shader);
+
+	auto existing = programs.find(name);
+	if(existing != programs.end() && existing->second.key == key)
+	{
+		return *existing->second.program;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	GLuint program = 0;
+	if(watcher)
+	{
+		// Edited sources win, a broken edit must not keep the station from starting
+		std::pair<std::string, std::string> sources = watcher->add(name, vertex_shader, fragment_shader);
+		try
+		{
+			program = build(sources.first, sources.second);
+		}
+		catch(std::exception &e)
+		{
+			spdlog::error("Shader program {} from {} failed, using the embedded sources: {}", name, watcher->get_directory(), e.what());
+		}
+	}
+	if(program == 0)
+	{
+		program = build(vertex_shader, fragment_shader);
+	}
+
+	spdlog::debug(
+		"Shader program {} ready in {} us",
+		name,
+		std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+
+	if(existing != programs.end())
+	{
+		existing->second.program->replace(program);
+		existing->second.key			 = key;
+		existing->second.vertex_shader	 = vertex_shader;
+		existing->second.fragment_shader = fragment_shader;
+		return *existing->second.program;
+	}
+
+	program_entry &entry = programs[name];
+	entry.program		 = std::make_unique<shader_program>(program);
+	entry.key			 = key;
+	entry.vertex_shader	 = vertex_shader;
+	entry.fragment_shader = fragment_shader;
+	return *entry.program;
+}
+
+void shader_manager::watch(const std::string &directory)
+{
+	watcher = std::make_unique<shader_watcher>(directory);
+
+	// Programs created before watching were built from the embedded sources, files already
+	// edited before this start are relinked right away instead of on their next change
+	for(auto &[name, entry] : programs)
+	{
+		std::pair<std::string, std::string> sources = watcher->add(name, entry.vertex_shader, entry.fragment_shader);
+		if(sources.first != entry.vertex_shader || sources.second != entry.fragment_shader)
+		{
+			watcher->request_relink(name);
+		}
+	}
+
+	spdlog::info("Watching shader sources in {}", directory);
+}
+
+void shader_manager::update()
+{
+	if(!watcher)
+	{
+		return;
+	}
+
+	std::vector<shader_watcher::result> finished = watcher->take_finished();
+	for(shader_watcher::result &reload : finished)
+	{
+		pending_reloads.push_back(std::move(reload));
+	}
+
+	for(auto it = pending_reloads.begin(); it != pending_reloads.end();)
+	{
+		if(it->program == 0)
+		{
+			spdlog::error("Shader program {} failed to reload, keeping the previous one: {}", it->name, it->error);
+			stats.reload_failures++;
+			it = pending_reloads.erase(it);
+			continue;
+		}
+
+		// Still linking on the GPU side, check again next frame
+		GLint status = GL_UNSIGNALED;
+		glGetSynciv(it->fence, GL_SYNC_STATUS, 1, nullptr, &status);
+		if(status != GL_SIGNALED)
+		{
+			++it;
+			continue;
+		}
+		glDeleteSync(it->fence);
+
+		auto entry = programs.find(it->name);
+		if(entry != programs.end())
+		{
+			entry->second.program->replace(it->program);
+			stats.reloads++;
+			spdlog::info("Shader program {} reloaded", it->name);
+		}
+		else
+		{
+			glDeleteProgram(it->program);
+		}
+		it = pending_reloads.erase(it);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#ifndef CORE_SHADER_MANAGER_H
+#define CORE_SHADER_MANAGER_H
+
+// clang-format off
+#include <GL/glew.h>
+#include <GL/gl.h>
+// clang-format on
+
+#include "core/shader_program.h"
+#include "core/shader_watcher.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Owns the linked programs of one GL context.
+ * Linked programs are stored with glGetProgramBinary in the cache directory, keyed by a hash of
+ * the sources and the driver, and reloaded with glProgramBinary on the next start.
+ * A missing, stale or rejected binary falls back to compiling the sources.
+ * With watch() the sources can be edited on disk and are relinked in the background,
+ * update() swaps in the programs that linked and keeps the old ones otherwise.
+ */
+class shader_manager
+{
+public:
+	struct statistics
+	{
+		std::size_t binary_hits		= 0; // program loaded from the binary cache
+		std::size_t binary_misses	= 0; // no binary, compiled from source
+		std::size_t binary_rejected = 0; // binary found but the driver refused it
+		std::size_t reloads			= 0; // edited sources swapped in
+		std::size_t reload_failures = 0; // edited sources that didn't compile or link
+	};
+
+private:
+	struct program_entry
+	{
+		std::unique_ptr<shader_program> program;
+		std::uint64_t key;
+		std::string vertex_shader, fragment_shader; // embedded sources
+	};
+
+	std::string cache_directory;
+	std::string driver; // vendor, renderer and version, part of every key
+	bool binaries_supported;
+
+	std::unordered_map<std::string, program_entry> programs;
+	statistics stats;
+
+	std::unique_ptr<shader_watcher> watcher;
+	std::vector<shader_watcher::result> pending_reloads;
+
+	GLuint build(const std::string &vertex_shader, const std::string &fragment_shader);
+
+	std::uint64_t make_key(const std::string &vertex_shader, const std::string &fragment_shader) const;
+	std::string cache_path(std::uint64_t key) const;
+
+	/* 0 if there is no usable binary for the key */
+	GLuint load_binary(std::uint64_t key);
+	void store_binary(GLuint program, std::uint64_t key) const;
+
+public:
+	/* cache_directory - where program binaries are kept, empty disables the binary cache */
+	shader_manager(const std::string &cache_directory);
+	~shader_manager();
+
+	shader_manager(const shader_manager &)			  = delete;
+	shader_manager &operator=(const shader_manager &) = delete;
+
+	/*
+	 * Linked program for the sources, owned by the manager.
+	 * Asking again under the same name returns the same program, relinked if the sources changed.
+	 * Throws std::runtime_error if the sources don't compile or link.
+	 */
+	shader_program &get_program(const std::string &name, const std::string &vertex_shader, const std::string &fragment_shader);
+
+	/*
+	 * Take the sources from <directory>/<name>.vert and .frag from now on and relink on every change.
+	 * Missing files are written out from the embedded sources. Call with the context current.
+	 */
+	void watch(const std::string &directory);
+
+	/* Swap in the programs relinked since the last call, never waits for the compiler */
+	void update();
+
+	bool get_binaries_supported() const
+	{
+		return binaries_supported;
+	}
+
+	const statistics &get_statistics() const
+	{
+		return stats;
+	}
+};
+
+#endif // CORE_SHADER_MANAGER_H
\ No newline at end of file
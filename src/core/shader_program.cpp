@@ -0,0 +1,310 @@
+#include "core/shader_program.h"
+
+#include <algorithm>
+#include <cstring>
+#include <spdlog/spdlog.h>
+#include <string>
+
+namespace
+{
+	/* Components of a uniform type set() can stage, 0 for the rest */
+	std::size_t type_components(GLenum type, bool &integer)
+	{
+		integer = false;
+		switch(type)
+		{
+			case GL_FLOAT:
+				return 1;
+			case GL_FLOAT_VEC2:
+				return 2;
+			case GL_FLOAT_VEC3:
+				return 3;
+			case GL_FLOAT_VEC4:
+				return 4;
+			case GL_FLOAT_MAT4:
+				return 16;
+			case GL_INT:
+			case GL_BOOL:
+			case GL_SAMPLER_1D:
+			case GL_SAMPLER_2D:
+			case GL_SAMPLER_3D:
+			case GL_SAMPLER_CUBE:
+			case GL_SAMPLER_2D_ARRAY:
+			case GL_SAMPLER_BUFFER:
+			case GL_INT_SAMPLER_2D:
+			case GL_UNSIGNED_INT_SAMPLER_2D:
+				integer = true;
+				return 1;
+			default:
+				return 0;
+		}
+	}
+
+	/* "u_Lights[0]" is reported for arrays, they are looked up without the subscript */
+	std::uint64_t reflected_hash(const char *name, GLsizei length)
+	{
+		std::string_view view(name, static_cast<std::size_t>(length));
+		if(view.size() > 3 && view.substr(view.size() - 3) == "[0]")
+		{
+			view.remove_suffix(3);
+		}
+		return name_hash(view);
+	}
+
+	template<typename T>
+	const T *find_hash(const std::vector<T> &table, std::uint64_t hash)
+	{
+		auto it = std::lower_bound(table.begin(), table.end(), hash, [](const T &entry, std::uint64_t value) { return entry.hash < value; });
+		return it != table.end() && it->hash == hash ? &*it : nullptr;
+	}
+
+	template<typename T>
+	void sort_by_hash(std::vector<T> &table)
+	{
+		std::sort(table.begin(), table.end(), [](const T &a, const T &b) { return a.hash < b.hash; });
+	}
+} // namespace
+
+shader_program::shader_program(GLuint id) : id(id), generation(0), uploads(0), redundant(0)
+{
+	reflect();
+}
+
+void shader_program::replace(GLuint program)
+{
+	gl_state::get().forget_program(id);
+	glDeleteProgram(id);
+	id = program;
+	generation++;
+
+	// A new program starts with default uniforms, everything staged so far is uploaded again
+	std::vector<uniform> previous;
+	std::vector<uniform_block> previous_blocks;
+	previous.swap(uniforms);
+	previous_blocks.swap(blocks);
+	reflect();
+
+	for(std::size_t i = 0; i < uniforms.size(); i++)
+	{
+		const uniform *old = find_hash(previous, uniforms[i].hash);
+		if(old && old->staged && old->type == uniforms[i].type)
+		{
+			std::memcpy(uniforms[i].value, old->value, sizeof(old->value));
+			uniforms[i].staged = true;
+			uniforms[i].dirty  = true;
+			dirty_uniforms.push_back(i);
+		}
+	}
+
+	// Blocks start at binding 0 too
+	for(uniform_block &block : blocks)
+	{
+		const uniform_block *old = find_hash(previous_blocks, block.hash);
+		if(old && old->bound)
+		{
+			glUniformBlockBinding(id, block.index, old->binding);
+			block.binding = old->binding;
+			block.bound	  = true;
+		}
+	}
+}
+
+void shader_program::reflect()
+{
+	uniforms.clear();
+	attributes.clear();
+	blocks.clear();
+	dirty_uniforms.clear();
+
+	GLint count		 = 0;
+	GLint max_length = 0;
+	std::vector<char> name;
+
+	glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+	name.resize(std::max(max_length, 1));
+	for(GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		uniform entry {};
+		glGetActiveUniform(id, static_cast<GLuint>(i), max_length, &length, &entry.size, &entry.type, name.data());
+		entry.location = glGetUniformLocation(id, name.data());
+
+		// Members of uniform blocks have no location, they are set through the block
+		if(entry.location < 0)
+		{
+			continue;
+		}
+		entry.hash = reflected_hash(name.data(), length);
+		uniforms.push_back(entry);
+	}
+
+	glGetProgramiv(id, GL_ACTIVE_ATTRIBUTES, &count);
+	glGetProgramiv(id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+	name.resize(std::max(max_length, 1));
+	for(GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size	   = 0;
+		attribute entry {};
+		glGetActiveAttrib(id, static_cast<GLuint>(i), max_length, &length, &size, &entry.type, name.data());
+		entry.location = glGetAttribLocation(id, name.data());
+		entry.hash	   = reflected_hash(name.data(), length);
+		attributes.push_back(entry);
+	}
+
+	glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_length);
+	name.resize(std::max(max_length, 1));
+	for(GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		uniform_block entry {};
+		entry.index = static_cast<GLuint>(i);
+		glGetActiveUniformBlockName(id, entry.index, max_length, &length, name.data());
+		glGetActiveUniformBlockiv(id, entry.index, GL_UNIFORM_BLOCK_DATA_SIZE, &entry.data_size);
+		entry.hash = reflected_hash(name.data(), length);
+		blocks.push_back(entry);
+	}
+
+	sort_by_hash(uniforms);
+	sort_by_hash(attributes);
+	sort_by_hash(blocks);
+
+	spdlog::debug("Shader program {}: {} uniforms, {} attributes, {} uniform blocks", id, uniforms.size(), attributes.size(), blocks.size());
+}
+
+void shader_program::stage(std::uint64_t name, const void *value, std::size_t components, bool integer)
+{
+	auto it = std::lower_bound(uniforms.begin(), uniforms.end(), name, [](const uniform &entry, std::uint64_t hash) { return entry.hash < hash; });
+	if(it == uniforms.end() || it->hash != name)
+	{
+		return;
+	}
+
+	// Only element 0 would be uploaded, the rest of the array would keep its old values
+	if(it->size > 1)
+	{
+		spdlog::warn("Shader program {}: array uniforms can't be set, {} elements", id, it->size);
+		return;
+	}
+
+	bool type_integer;
+	if(type_components(it->type, type_integer) != components || type_integer != integer)
+	{
+		spdlog::warn("Shader program {}: uniform value doesn't match the GL type {:#x}", id, it->type);
+		return;
+	}
+
+	std::size_t bytes = components * sizeof(std::uint32_t);
+	if(it->staged && std::memcmp(it->value, value, bytes) == 0)
+	{
+		redundant++;
+		return;
+	}
+
+	std::memcpy(it->value, value, bytes);
+	it->staged = true;
+	if(!it->dirty)
+	{
+		it->dirty = true;
+		dirty_uniforms.push_back(static_cast<std::size_t>(it - uniforms.begin()));
+	}
+}
+
+void shader_program::use()
+{
+	gl_state::get().use_program(id);
+
+	for(std::size_t index : dirty_uniforms)
+	{
+		uniform &entry = uniforms[index];
+		const float *f = reinterpret_cast<const float *>(entry.value);
+		const GLint *i = reinterpret_cast<const GLint *>(entry.value);
+		switch(entry.type)
+		{
+			case GL_FLOAT:
+				glUniform1fv(entry.location, 1, f);
+				break;
+			case GL_FLOAT_VEC2:
+				glUniform2fv(entry.location, 1, f);
+				break;
+			case GL_FLOAT_VEC3:
+				glUniform3fv(entry.location, 1, f);
+				break;
+			case GL_FLOAT_VEC4:
+				glUniform4fv(entry.location, 1, f);
+				break;
+			case GL_FLOAT_MAT4:
+				glUniformMatrix4fv(entry.location, 1, GL_FALSE, f);
+				break;
+			default:
+				glUniform1iv(entry.location, 1, i);
+				break;
+		}
+		entry.dirty = false;
+		uploads++;
+	}
+	dirty_uniforms.clear();
+}
+
+void shader_program::set(std::uint64_t name, int value)
+{
+	stage(name, &value, 1, true);
+}
+
+void shader_program::set(std::uint64_t name, float value)
+{
+	stage(name, &value, 1, false);
+}
+
+void shader_program::set(std::uint64_t name, float x, float y)
+{
+	const float value[2] = {x, y};
+	stage(name, value, 2, false);
+}
+
+void shader_program::set(std::uint64_t name, float x, float y, float z)
+{
+	const float value[3] = {x, y, z};
+	stage(name, value, 3, false);
+}
+
+void shader_program::set(std::uint64_t name, float x, float y, float z, float w)
+{
+	const float value[4] = {x, y, z, w};
+	stage(name, value, 4, false);
+}
+
+void shader_program::set_matrix(std::uint64_t name, const float *matrix)
+{
+	stage(name, matrix, 16, false);
+}
+
+GLint shader_program::get_attribute_location(std::uint64_t name) const
+{
+	const attribute *entry = find_hash(attributes, name);
+	return entry ? entry->location : -1;
+}
+
+GLuint shader_program::get_block_index(std::uint64_t name) const
+{
+	const uniform_block *entry = find_hash(blocks, name);
+	return entry ? entry->index : GL_INVALID_INDEX;
+}
+
+void shader_program::bind_block(std::uint64_t name, GLuint binding)
+{
+	auto it = std::lower_bound(blocks.begin(), blocks.end(), name, [](const uniform_block &entry, std::uint64_t hash) { return entry.hash < hash; });
+	if(it != blocks.end() && it->hash == name)
+	{
+		glUniformBlockBinding(id, it->index, binding);
+		it->binding = binding;
+		it->bound	= true;
+	}
+}
+
+bool shader_program::has_uniform(std::uint64_t name) const
+{
+	return find_hash(uniforms, name) != nullptr;
+}
\ No newline at end of file
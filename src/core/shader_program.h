@@ -0,0 +1,131 @@
+#ifndef CORE_SHADER_PROGRAM_H
+#define CORE_SHADER_PROGRAM_H
+
+// clang-format off
+#include <GL/glew.h>
+#include <GL/gl.h>
+// clang-format on
+
+#include "core/gl_state.h"
+#include "core/hash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/* Uniform, attribute or block name, hash it once: static constexpr std::uint64_t u_texture = name_hash("u_Texture"); */
+constexpr std::uint64_t name_hash(std::string_view name)
+{
+	return fnv1a_64(name.data(), name.size());
+}
+
+/*
+ * Linked program owned by the shader manager.
+ * The active uniforms, attributes and uniform blocks are reflected once at link time into
+ * tables sorted by name hash, lookups never touch GL or compare strings.
+ * Uniform values are staged by set() and compared against the last uploaded value, use()
+ * binds the program and uploads only the values that changed.
+ * The GL program behind it can be replaced by a hot reload, the staged values and block
+ * bindings carry over.
+ */
+class shader_program
+{
+private:
+	struct uniform
+	{
+		std::uint64_t hash;
+		GLint location;
+		GLenum type;
+		GLint size;
+		std::uint32_t value[16]; // last staged value, floats and ints as their bits
+		bool staged;			 // value holds something to keep in sync
+		bool dirty;				 // value differs from what the program has
+	};
+
+	struct attribute
+	{
+		std::uint64_t hash;
+		GLint location;
+		GLenum type;
+	};
+
+	struct uniform_block
+	{
+		std::uint64_t hash;
+		GLuint index;
+		GLint data_size;
+		GLuint binding;
+		bool bound; // binding was set by bind_block(), kept across reloads
+	};
+
+	GLuint id;
+	std::uint64_t generation;
+
+	std::vector<uniform> uniforms;
+	std::vector<attribute> attributes;
+	std::vector<uniform_block> blocks;
+	std::vector<std::size_t> dirty_uniforms;
+
+	std::size_t uploads;
+	std::size_t redundant;
+
+	void reflect();
+	void stage(std::uint64_t name, const void *value, std::size_t components, bool integer);
+
+	friend class shader_manager;
+	void replace(GLuint program);
+
+public:
+	shader_program(GLuint id);
+	~shader_program()
+	{
+		gl_state::get().forget_program(id);
+		glDeleteProgram(id);
+	}
+
+	shader_program(const shader_program &)			  = delete;
+	shader_program &operator=(const shader_program &) = delete;
+
+	/* Bind the program and upload the uniforms changed since the last use */
+	void use();
+
+	/* Unknown names are ignored like location -1 in glUniform*. Arrays can't be set, they are
+	   refused with a warning */
+	void set(std::uint64_t name, int value);
+	void set(std::uint64_t name, float value);
+	void set(std::uint64_t name, float x, float y);
+	void set(std::uint64_t name, float x, float y, float z);
+	void set(std::uint64_t name, float x, float y, float z, float w);
+	/* Column-major 4x4 matrix */
+	void set_matrix(std::uint64_t name, const float *matrix);
+
+	/* -1 if the attribute isn't active */
+	GLint get_attribute_location(std::uint64_t name) const;
+	/* GL_INVALID_INDEX if the block isn't active */
+	GLuint get_block_index(std::uint64_t name) const;
+	void bind_block(std::uint64_t name, GLuint binding);
+
+	bool has_uniform(std::uint64_t name) const;
+
+	GLuint get_id() const
+	{
+		return id;
+	}
+	std::uint64_t get_generation() const
+	{
+		return generation;
+	}
+
+	/* Uniform values uploaded and set() calls skipped because nothing changed */
+	std::size_t get_uniform_uploads() const
+	{
+		return uploads;
+	}
+	std::size_t get_redundant_uniform_updates() const
+	{
+		return redundant;
+	}
+};
+
+#endif // CORE_SHADER_PROGRAM_H
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "core/shader_watcher.h"
+
+#include "core/shader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <poll.h>
+#include <set>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace
+{
+	// Editors save in several steps, a burst of events is compiled once it has been quiet this long
+	constexpr int settle_milliseconds = 50;
+	constexpr int idle_milliseconds	  = 200;
+
+	std::string stage_path(const std::string &directory, const std::string &name, const char *extension)
+	{
+		return (std::filesystem::path(directory) / (name + extension)).string();
+	}
+
+	/* Source from the directory, written out from the embedded one if there is no file yet.
+	   A file that can't be written leaves the embedded source in use, editing it has no effect */
+	std::string stage_source(const std::string &path, const std::string &embedded)
+	{
+		if(std::filesystem::exists(path))
+		{
+			return read_file(path);
+		}
+
+		std::ofstream file(path, std::ios::binary);
+		file << embedded;
+		file.close();
+		if(!file)
+		{
+			spdlog::error("Can't write shader source {}: {}", path, std::strerror(errno));
+		}
+		return embedded;
+	}
+} // namespace
+
+shader_watcher::shader_watcher(const std::string &directory)
+	: directory(directory),
+	  compile_window(nullptr),
+	  compile_context(nullptr),
+	  inotify_fd(-1),
+	  stopping(false)
+{
+	SDL_Window *render_window	 = SDL_GL_GetCurrentWindow();
+	SDL_GLContext render_context = SDL_GL_GetCurrentContext();
+	if(!render_context)
+	{
+		throw std::runtime_error("Shader watcher needs a current SDL GL context, headless contexts aren't supported");
+	}
+
+	std::filesystem::create_directories(directory);
+
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(inotify_fd < 0)
+	{
+		throw std::runtime_error(std::string("inotify initialization error: ") + std::strerror(errno));
+	}
+	// Saved in place or renamed over the old file
+	if(inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		std::string _error = "Can't watch " + directory + ": " + std::strerror(errno);
+		close(inotify_fd);
+		throw std::runtime_error(_error);
+	}
+
+	// Hidden window for the compile context, it's never drawn to
+	compile_window = SDL_CreateWindow("shader compiler", 0, 0, 1, 1, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+	if(!compile_window)
+	{
+		std::string _error = std::string("Shader compiler window creation error: ") + SDL_GetError();
+		close(inotify_fd);
+		throw std::runtime_error(_error);
+	}
+
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+	compile_context = SDL_GL_CreateContext(compile_window);
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+
+	// Creating a context makes it current, give the render thread its own back
+	SDL_GL_MakeCurrent(render_window, render_context);
+
+	if(!compile_context)
+	{
+		std::string _error = std::string("Shader compiler context creation error: ") + SDL_GetError();
+		SDL_DestroyWindow(compile_window);
+		close(inotify_fd);
+		throw std::runtime_error(_error);
+	}
+
+	worker = std::thread(&shader_watcher::run, this);
+}
+
+shader_watcher::~shader_watcher()
+{
+	stopping = true;
+	worker.join();
+
+	for(result &unclaimed : finished)
+	{
+		glDeleteProgram(unclaimed.program);
+		glDeleteSync(unclaimed.fence);
+	}
+
+	SDL_GL_DeleteContext(compile_context);
+	SDL_DestroyWindow(compile_window);
+	close(inotify_fd);
+}
+
+std::pair<std::string, std::string> shader_watcher::add(const std::string &name, const std::string &vertex_shader, const std::string &fragment_shader)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		embedded[name] = {vertex_shader, fragment_shader};
+	}
+
+	return {
+		stage_source(stage_path(directory, name, ".vert"), vertex_shader),
+		stage_source(stage_path(directory, name, ".frag"), fragment_shader)};
+}
+
+void shader_watcher::request_relink(const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	requested.insert(name);
+}
+
+std::vector<shader_watcher::result> shader_watcher::take_finished()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<result> taken;
+	taken.swap(finished);
+	return taken;
+}
+
+shader_watcher::result shader_watcher::relink(const std::string &name)
+{
+	result relinked {name, 0, nullptr, ""};
+
+	std::pair<std::string, std::string> sources;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sources = embedded.at(name);
+	}
+
+	try
+	{
+		std::string vertex_path	  = stage_path(directory, name, ".vert");
+		std::string fragment_path = stage_path(directory, name, ".frag");
+		if(std::filesystem::exists(vertex_path))
+		{
+			sources.first = read_file(vertex_path);
+		}
+		if(std::filesystem::exists(fragment_path))
+		{
+			sources.second = read_file(fragment_path);
+		}
+
+		relinked.program = create_program(sources.first, sources.second);
+		relinked.fence	 = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+	}
+	catch(std::exception &e)
+	{
+		relinked.error = e.what();
+	}
+
+	return relinked;
+}
+
+void shader_watcher::run()
+{
+	SDL_GL_MakeCurrent(compile_window, compile_context);
+
+	alignas(inotify_event) char buffer[16 * 1024];
+	std::set<std::string> changed;
+
+	while(!stopping)
+	{
+		pollfd descriptor {inotify_fd, POLLIN, 0};
+		int ready = poll(&descriptor, 1, changed.empty() ? idle_milliseconds : settle_milliseconds);
+
+		if(ready > 0)
+		{
+			ssize_t length;
+			while((length = read(inotify_fd, buffer, sizeof(buffer))) > 0)
+			{
+				for(char *position = buffer; position < buffer + length;)
+				{
+					const inotify_event *event = reinterpret_cast<const inotify_event *>(position);
+					position += sizeof(inotify_event) + event->len;
+					if(event->len == 0)
+					{
+						continue;
+					}
+
+					std::filesystem::path file(event->name);
+					if(file.extension() != ".vert" && file.extension() != ".frag")
+					{
+						continue;
+					}
+
+					std::lock_guard<std::mutex> lock(mutex);
+					if(embedded.count(file.stem().string()) != 0)
+					{
+						changed.insert(file.stem().string());
+					}
+				}
+			}
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			changed.insert(requested.begin(), requested.end());
+			requested.clear();
+		}
+		for(const std::string &name : changed)
+		{
+			result relinked = relink(name);
+			std::lock_guard<std::mutex> lock(mutex);
+			finished.push_back(std::move(relinked));
+		}
+		changed.clear();
+	}
+
+	SDL_GL_MakeCurrent(compile_window, nullptr);
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef CORE_SHADER_WATCHER_H
+#define CORE_SHADER_WATCHER_H
+
+// clang-format off
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+#include <GL/gl.h>
+// clang-format on
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Watches a directory of shader sources with inotify and relinks the programs whose
+ * <name>.vert or <name>.frag changed on a background thread.
+ * The background thread has its own GL context sharing objects with the render context,
+ * so compiling and linking never stalls a frame. Finished programs are fenced and handed
+ * back through take_finished().
+ */
+class shader_watcher
+{
+public:
+	struct result
+	{
+		std::string name;
+		GLuint program; // 0 if the sources didn't compile or link
+		GLsync fence;	// program is complete on the GPU once the fence is signaled
+		std::string error;
+	};
+
+private:
+	std::string directory;
+
+	SDL_Window *compile_window;
+	SDL_GLContext compile_context;
+
+	int inotify_fd;
+	std::atomic<bool> stopping;
+	std::thread worker;
+
+	// Embedded sources by program name, used for the stages without a file in the directory
+	std::mutex mutex;
+	std::unordered_map<std::string, std::pair<std::string, std::string>> embedded;
+	std::vector<result> finished;
+	// Programs to relink without waiting for a change event
+	std::set<std::string> requested;
+
+	void run();
+	result relink(const std::string &name);
+
+public:
+	/* Must be created on the render thread with its context current. The context has to be an
+	   SDL window's, headless (EGL) contexts aren't supported */
+	shader_watcher(const std::string &directory);
+	~shader_watcher();
+
+	shader_watcher(const shader_watcher &)			  = delete;
+	shader_watcher &operator=(const shader_watcher &) = delete;
+
+	/*
+	 * Register the embedded sources of a program.
+	 * Missing <name>.vert/<name>.frag files are written out so they can be edited,
+	 * returns the sources currently in the directory.
+	 */
+	std::pair<std::string, std::string> add(const std::string &name, const std::string &vertex_shader, const std::string &fragment_shader);
+
+	/* Relink a registered program from the directory on the background thread, as if its files changed */
+	void request_relink(const std::string &name);
+
+	/* Programs relinked since the last call, ownership passes to the caller */
+	std::vector<result> take_finished();
+
+	const std::string &get_directory() const
+	{
+		return directory;
+	}
+};
+
+#endif // CORE_SHADER_WATCHER_H
\ No newline at end of file
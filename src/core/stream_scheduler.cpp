@@ -0,0 +1,252 @@
+#include "core/stream_scheduler.h"
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+#include <spdlog/spdlog.h>
+
+namespace
+{
+	// Weight of the newest job in a stream's moving average job time
+	constexpr double average_weight = 0.2;
+} // namespace
+
+stream_scheduler::stream_scheduler(thread_pool &pool, std::size_t max_running, std::chrono::microseconds batch_window)
+	: pool(pool), max_running(max_running > 0 ? max_running : pool.get_thread_count()), batch_window(batch_window), running(0),
+	  idle_tasks(0), queued(0), batches(0), batched_jobs(0)
+{
+}
+
+stream_scheduler::~stream_scheduler()
+{
+	// Running tasks refer to the scheduler
+	wait();
+}
+
+stream_scheduler::stream stream_scheduler::add_stream(const stream_options &options)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	stream_state state;
+	state.options			  = options;
+	state.options.weight	  = std::max(1u, options.weight);
+	state.options.max_pending = std::max<std::size_t>(1, options.max_pending);
+
+	// A new stream starts level with the others instead of being owed all their past time
+	if(!streams.empty())
+	{
+		state.virtual_time = std::min_element(
+								 streams.begin(),
+								 streams.end(),
+								 [](const stream_state &a, const stream_state &b) { return a.virtual_time < b.virtual_time; })
+								 ->virtual_time;
+	}
+
+	streams.push_back(std::move(state));
+	return streams.size() - 1;
+}
+
+bool stream_scheduler::submit(stream id, std::function<void()> job)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	stream_state &state = streams.at(id);
+
+	if(state.jobs.size() >= state.options.max_pending)
+	{
+		state.totals.rejected++;
+		return false;
+	}
+
+	// A stream that was idle doesn't get to catch up on the time it didn't use
+	if(state.jobs.empty() && !state.running)
+	{
+		double busiest_behind = std::numeric_limits<double>::max();
+		for(const stream_state &other : streams)
+		{
+			if(&other != &state && (other.running || !other.jobs.empty()))
+			{
+				busiest_behind = std::min(busiest_behind, other.virtual_time);
+			}
+		}
+		if(busiest_behind != std::numeric_limits<double>::max())
+		{
+			state.virtual_time = std::max(state.virtual_time, busiest_behind);
+		}
+	}
+
+	state.jobs.push_back(std::move(job));
+	queued++;
+	dispatch();
+	return true;
+}
+
+int stream_scheduler::pick() const
+{
+	int best = -1;
+	for(std::size_t i = 0; i < streams.size(); i++)
+	{
+		const stream_state &state = streams[i];
+		if(state.running || state.jobs.empty())
+		{
+			continue;
+		}
+		if(best < 0)
+		{
+			best = static_cast<int>(i);
+			continue;
+		}
+
+		const stream_state &current = streams[best];
+		if(state.options.priority > current.options.priority
+		   || (state.options.priority == current.options.priority && state.virtual_time < current.virtual_time))
+		{
+			best = static_cast<int>(i);
+		}
+	}
+	return best;
+}
+
+void stream_scheduler::dispatch()
+{
+	std::size_t ready = 0;
+	for(const stream_state &state : streams)
+	{
+		if(!state.running && !state.jobs.empty())
+		{
+			ready++;
+		}
+	}
+
+	// Every ready stream needs a task that isn't busy with a job, tasks inside a long job
+	// (a blocking read) mustn't hold the other streams back
+	for(; idle_tasks < ready && running < max_running; running++, idle_tasks++)
+	{
+		pool.submit([this]() { run_batch(); });
+	}
+}
+
+void stream_scheduler::run_batch()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	auto batch_start	 = std::chrono::steady_clock::now();
+	std::size_t jobs_run = 0;
+
+	for(;;)
+	{
+		int id = pick();
+		if(id < 0)
+		{
+			break;
+		}
+
+		// Only jobs expected to fit into what is left of the window join a batch
+		if(jobs_run > 0)
+		{
+			double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - batch_start).count();
+			if(elapsed + streams[id].average_time > static_cast<double>(batch_window.count()))
+			{
+				break;
+			}
+		}
+
+		stream_state &state		   = streams[id];
+		std::function<void()> job = std::move(state.jobs.front());
+		std::string name		   = state.options.name;
+		state.jobs.pop_front();
+		state.running = true;
+		queued--;
+		idle_tasks--;
+		lock.unlock();
+
+		auto start = std::chrono::steady_clock::now();
+		try
+		{
+			job();
+		}
+		catch(const std::exception &e)
+		{
+			spdlog::error("Stream {}: {}", name, e.what());
+		}
+		catch(...)
+		{
+			spdlog::error("Stream {}: unknown error", name);
+		}
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+		lock.lock();
+		idle_tasks++;
+		// add_stream() may have moved the streams meanwhile
+		stream_state &finished = streams[id];
+		finished.running	   = false;
+		finished.virtual_time += static_cast<double>(elapsed.count()) / finished.options.weight;
+		finished.average_time = finished.totals.completed == 0
+									? static_cast<double>(elapsed.count())
+									: finished.average_time + average_weight * (static_cast<double>(elapsed.count()) - finished.average_time);
+		finished.totals.completed++;
+		finished.totals.busy += elapsed;
+		jobs_run++;
+	}
+
+	if(jobs_run > 1)
+	{
+		batches++;
+		batched_jobs += jobs_run;
+	}
+
+	running--;
+	idle_tasks--;
+	// The batch may have stopped at a long job, it gets a task of its own
+	dispatch();
+	idle.notify_all();
+}
+
+void stream_scheduler::set_priority(stream id, int priority)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	streams.at(id).options.priority = priority;
+}
+
+void stream_scheduler::set_weight(stream id, unsigned int weight)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	streams.at(id).options.weight = std::max(1u, weight);
+}
+
+stream_scheduler::stream_options stream_scheduler::get_options(stream id) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return streams.at(id).options;
+}
+
+void stream_scheduler::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this]() { return queued == 0 && running == 0; });
+}
+
+stream_scheduler::statistics stream_scheduler::get_statistics(stream id) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	const stream_state &state = streams.at(id);
+	statistics result		  = state.totals;
+	result.average			  = std::chrono::microseconds(static_cast<long long>(state.average_time));
+	return result;
+}
+
+std::size_t stream_scheduler::get_stream_count() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return streams.size();
+}
+
+std::size_t stream_scheduler::get_batch_count() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return batches;
+}
+
+std::size_t stream_scheduler::get_batched_job_count() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return batched_jobs;
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#ifndef CORE_STREAM_SCHEDULER_H
+#define CORE_STREAM_SCHEDULER_H
+
+#include "core/thread_pool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Shares one thread_pool between the jobs of many streams (cameras, files).
+ * Every stream has a bounded queue of jobs. Streams of the highest priority with queued jobs run
+ * first, streams of the same priority get pool time in proportion to their weight: each stream's
+ * virtual time advances by the time its jobs took divided by its weight, and the stream that is
+ * furthest behind runs next. A stream can't hog the pool with many cheap or few expensive jobs.
+ * Jobs expected to be short, judged by their stream's recent job times, run back to back in one
+ * pool task up to batch_window, so small per-stream jobs like LK don't pay a dispatch each.
+ */
+class stream_scheduler
+{
+public:
+	using stream = std::size_t;
+
+	struct stream_options
+	{
+		std::string name;
+		/* Higher priorities are served first */
+		int priority = 0;
+		/* Share of the pool among streams of the same priority */
+		unsigned int weight = 1;
+		/* Jobs queued before submit() refuses more */
+		std::size_t max_pending = 2;
+	};
+
+	struct statistics
+	{
+		std::size_t completed = 0;
+		std::size_t rejected  = 0; // submit() calls refused because the queue was full
+		std::chrono::microseconds busy {0};
+		std::chrono::microseconds average {0}; // recent job time
+	};
+
+private:
+	struct stream_state
+	{
+		stream_options options;
+		std::deque<std::function<void()>> jobs;
+		double virtual_time = 0.0; // microseconds of pool time divided by the weight
+		double average_time = 0.0; // moving average of the job time, microseconds
+		bool running		= false;
+		statistics totals;
+	};
+
+	thread_pool &pool;
+	std::size_t max_running;
+	std::chrono::microseconds batch_window;
+
+	mutable std::mutex mutex;
+	std::condition_variable idle;
+	std::vector<stream_state> streams;
+	std::size_t running;	 // pool tasks started and not finished
+	std::size_t idle_tasks; // of those, tasks not in a job right now, they pick up ready streams
+	std::size_t queued;
+	std::size_t batches;
+	std::size_t batched_jobs;
+
+	/* Stream whose job runs next, -1 if none is ready. Called with the lock held */
+	int pick() const;
+
+	/* Start pool tasks while there is work and room for them. Called with the lock held */
+	void dispatch();
+
+	/* Body of a pool task: jobs of the picked streams until the batch window is used up */
+	void run_batch();
+
+public:
+	/* max_running - pool tasks the scheduler uses at most, 0 - all workers.
+	   batch_window - time short jobs are run together in one pool task */
+	stream_scheduler(
+		thread_pool &pool,
+		std::size_t max_running					= 0,
+		std::chrono::microseconds batch_window = std::chrono::microseconds(500));
+	~stream_scheduler();
+
+	stream_scheduler(const stream_scheduler &)			  = delete;
+	stream_scheduler &operator=(const stream_scheduler &) = delete;
+
+	stream add_stream(const stream_options &options);
+
+	/* Queue a job of the stream, false if its queue is full. Jobs of one stream never run
+	   at the same time and run in the order they were submitted */
+	bool submit(stream id, std::function<void()> job);
+
+	void set_priority(stream id, int priority);
+	void set_weight(stream id, unsigned int weight);
+	stream_options get_options(stream id) const;
+
+	/* Wait until every queued job ran */
+	void wait();
+
+	statistics get_statistics(stream id) const;
+	std::size_t get_stream_count() const;
+
+	/* Pool tasks that ran more than one job, and the jobs they ran */
+	std::size_t get_batch_count() const;
+	std::size_t get_batched_job_count() const;
+};
+
+#endif // CORE_STREAM_SCHEDULER_H
\ No newline at end of file
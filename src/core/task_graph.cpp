@@ -0,0 +1,240 @@
+#include "core/task_graph.h"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+task_graph::task_graph(thread_pool &pool, std::size_t frames_in_flight)
+	: pool(pool), frames_in_flight(std::max<std::size_t>(1, frames_in_flight)), max_distance(0), deterministic(false), submitted(0),
+	  completed(0), peak_in_flight(0)
+{
+}
+
+task_graph::~task_graph()
+{
+	// Nodes still queued on the pool refer to the graph
+	std::unique_lock<std::mutex> lock(mutex);
+	try
+	{
+		drain(lock);
+	}
+	catch(const std::exception &e)
+	{
+		spdlog::error("Task graph: {}", e.what());
+	}
+	catch(...)
+	{
+		spdlog::error("Task graph: unknown error");
+	}
+}
+
+task_graph::node task_graph::add(const std::string &name, body function, placement where)
+{
+	if(!frames.empty())
+	{
+		throw std::runtime_error("Task graph: node " + name + " added after the first frame");
+	}
+
+	nodes.push_back({name, std::move(function), where, {}, {}});
+	return nodes.size() - 1;
+}
+
+void task_graph::depend(node dependent, node dependency, std::size_t frames_back)
+{
+	if(!frames.empty())
+	{
+		throw std::runtime_error("Task graph: dependency added after the first frame");
+	}
+	if(dependent >= nodes.size() || dependency >= nodes.size())
+	{
+		throw std::runtime_error("Task graph: dependency on an unknown node");
+	}
+	if(frames_back == 0 && dependency >= dependent)
+	{
+		throw std::runtime_error("Task graph: " + nodes[dependency].name + " has to be declared before " + nodes[dependent].name);
+	}
+
+	nodes[dependency].successors.push_back({dependent, frames_back});
+	nodes[dependent].predecessors.push_back({dependency, frames_back});
+	max_distance = std::max(max_distance, frames_back);
+}
+
+void task_graph::start(std::uint64_t frame)
+{
+	if(frames.empty())
+	{
+		frames.resize(get_slot_count());
+		for(frame_state &state : frames)
+		{
+			state.pending.resize(nodes.size());
+			state.done.resize(nodes.size());
+		}
+	}
+
+	frame_state &state = frames[get_slot(frame)];
+	state.remaining	   = nodes.size();
+
+	for(node i = 0; i < nodes.size(); i++)
+	{
+		state.done[i]	 = false;
+		state.pending[i] = 0;
+		for(const edge &dependency : nodes[i].predecessors)
+		{
+			// Earlier frames are still in their slots, a dependency done already doesn't count
+			if(dependency.distance == 0)
+			{
+				state.pending[i]++;
+			}
+			else if(frame >= dependency.distance && !frames[get_slot(frame - dependency.distance)].done[dependency.target])
+			{
+				state.pending[i]++;
+			}
+		}
+	}
+
+	submitted++;
+	peak_in_flight = std::max(peak_in_flight, static_cast<std::size_t>(submitted - completed));
+
+	for(node i = 0; i < nodes.size(); i++)
+	{
+		if(state.pending[i] == 0)
+		{
+			schedule(frame, i);
+		}
+	}
+}
+
+void task_graph::schedule(std::uint64_t frame, node index)
+{
+	if(deterministic || nodes[index].where == placement::caller)
+	{
+		caller_ready.emplace_back(frame, index);
+		changed.notify_all();
+		return;
+	}
+
+	pool.submit([this, frame, index]() { execute(frame, index); });
+}
+
+void task_graph::execute(std::uint64_t frame, node index)
+{
+	bool failed;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		failed = error != nullptr;
+	}
+
+	// After a failure the remaining nodes only complete, so the frames in flight drain
+	if(!failed)
+	{
+		try
+		{
+			nodes[index].function(frame, get_slot(frame));
+		}
+		catch(...)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(!error)
+			{
+				error = std::current_exception();
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	finish(frame, index);
+}
+
+void task_graph::finish(std::uint64_t frame, node index)
+{
+	frame_state &state = frames[get_slot(frame)];
+	state.done[index]  = true;
+
+	// Frames not started yet find the node done when they start
+	for(const edge &successor : nodes[index].successors)
+	{
+		std::uint64_t target = frame + successor.distance;
+		if(target >= submitted)
+		{
+			continue;
+		}
+		frame_state &dependent = frames[get_slot(target)];
+		if(--dependent.pending[successor.target] == 0)
+		{
+			schedule(target, successor.target);
+		}
+	}
+
+	if(--state.remaining == 0)
+	{
+		while(completed < submitted && frames[get_slot(completed)].remaining == 0)
+		{
+			completed++;
+		}
+	}
+	changed.notify_all();
+}
+
+void task_graph::pump(std::unique_lock<std::mutex> &lock, const std::function<bool()> &done)
+{
+	while(!done())
+	{
+		if(caller_ready.empty())
+		{
+			changed.wait(lock);
+			continue;
+		}
+
+		auto [frame, index] = caller_ready.front();
+		caller_ready.pop_front();
+		lock.unlock();
+		execute(frame, index);
+		lock.lock();
+	}
+}
+
+void task_graph::drain(std::unique_lock<std::mutex> &lock)
+{
+	pump(lock, [this]() { return completed == submitted; });
+
+	if(error)
+	{
+		std::exception_ptr failure = error;
+		error					   = nullptr;
+		std::rethrow_exception(failure);
+	}
+}
+
+std::uint64_t task_graph::submit()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	std::uint64_t frame = submitted;
+
+	if(deterministic)
+	{
+		start(frame);
+		drain(lock);
+		return frame;
+	}
+
+	pump(lock, [this]() { return submitted < completed + frames_in_flight || error; });
+	if(error)
+	{
+		drain(lock);
+	}
+
+	start(frame);
+	return frame;
+}
+
+void task_graph::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	drain(lock);
+}
+
+void task_graph::set_deterministic(bool value)
+{
+	wait();
+	deterministic = value;
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+#ifndef CORE_TASK_GRAPH_H
+#define CORE_TASK_GRAPH_H
+
+#include "core/thread_pool.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Graph of the stages of one frame, run once per frame on a thread_pool.
+ * The nodes and their dependencies are declared once, every submit() starts a new instance of
+ * the graph for the next frame. A node runs as soon as its dependencies in its own frame and in
+ * earlier frames are done, so frame N + 1 decodes while frame N is still in its flow stages.
+ * Up to frames_in_flight frames run at once, submit() blocks until the oldest one is done.
+ * Per-frame data lives in slots owned by the caller, see get_slot().
+ */
+class task_graph
+{
+public:
+	using node = std::size_t;
+
+	/* frame - number of the frame from 0, slot - index of the frame's data */
+	using body = std::function<void(std::uint64_t frame, std::size_t slot)>;
+
+	enum class placement
+	{
+		pool,
+		/* Run by the thread calling submit() and wait(), for GL and window work */
+		caller
+	};
+
+private:
+	struct edge
+	{
+		node target;
+		std::size_t distance; // frames between the dependency and the dependent
+	};
+
+	struct node_info
+	{
+		std::string name;
+		body function;
+		placement where;
+		std::vector<edge> successors;
+		std::vector<edge> predecessors;
+	};
+
+	struct frame_state
+	{
+		std::vector<std::size_t> pending;
+		std::vector<bool> done;
+		std::size_t remaining = 0;
+	};
+
+	thread_pool &pool;
+	std::size_t frames_in_flight;
+	std::size_t max_distance;
+	bool deterministic;
+	std::vector<node_info> nodes;
+	std::vector<frame_state> frames;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<std::pair<std::uint64_t, node>> caller_ready;
+	std::uint64_t submitted; // frames started
+	std::uint64_t completed; // every frame before it is done
+	std::size_t peak_in_flight;
+	std::exception_ptr error;
+
+	void start(std::uint64_t frame);
+	void schedule(std::uint64_t frame, node index);
+	void execute(std::uint64_t frame, node index);
+	void finish(std::uint64_t frame, node index);
+
+	/* Run the caller's nodes until done returns true, the lock is released while a node runs */
+	void pump(std::unique_lock<std::mutex> &lock, const std::function<bool()> &done);
+
+	/* Wait for every started frame, rethrows the first exception of a node */
+	void drain(std::unique_lock<std::mutex> &lock);
+
+public:
+	/* frames_in_flight - frames that may run at the same time, at least 1 */
+	task_graph(thread_pool &pool, std::size_t frames_in_flight = 2);
+	~task_graph();
+
+	task_graph(const task_graph &)			  = delete;
+	task_graph &operator=(const task_graph &) = delete;
+
+	/* Nodes and dependencies are declared before the first submit() */
+	node add(const std::string &name, body function, placement where = placement::pool);
+
+	/* dependent of frame N runs after dependency of frame N - frames_back.
+	   A dependency in the same frame has to be declared before the dependent, so there are no cycles */
+	void depend(node dependent, node dependency, std::size_t frames_back = 0);
+
+	/* The node of frame N runs after the node of frame N - 1, for stages that keep state between frames */
+	void set_serial(node index)
+	{
+		depend(index, index, 1);
+	}
+
+	/* Start the next frame, running the caller's nodes while it waits for room. Returns the frame's number.
+	   Not to be called from a node */
+	std::uint64_t submit();
+
+	/* Wait for all submitted frames, running the caller's nodes meanwhile */
+	void wait();
+
+	/* Every node on the calling thread, one frame at a time and in the same order on every run, for
+	   debugging. Waits for the frames in flight first */
+	void set_deterministic(bool value);
+	bool is_deterministic() const
+	{
+		return deterministic;
+	}
+
+	/* Slots of per-frame data the caller keeps. A frame's slot stays untouched by other frames
+	   until every frame depending on it is done */
+	std::size_t get_slot_count() const
+	{
+		return frames_in_flight + max_distance;
+	}
+	std::size_t get_slot(std::uint64_t frame) const
+	{
+		return static_cast<std::size_t>(frame % get_slot_count());
+	}
+
+	const std::string &get_name(node index) const
+	{
+		return nodes[index].name;
+	}
+
+	/* Most frames that were running at once */
+	std::size_t get_peak_in_flight() const
+	{
+		return peak_in_flight;
+	}
+};
+
+#endif // CORE_TASK_GRAPH_H
\ No newline at end of file
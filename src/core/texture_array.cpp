@@ -0,0 +1,146 @@
+#include "core/texture_array.h"
+
+#include "core/gl_state.h"
+
+#include <opencv2/imgproc.hpp>
+#include <stdexcept>
+#include <string>
+
+texture_array::texture_array(int width, int height, int layers, content kind)
+	: id(0), read_framebuffer(0), draw_framebuffer(0), width(width), height(height), layers(layers), kind(kind)
+{
+	if(width <= 0 || height <= 0 || layers <= 0)
+	{
+		throw std::runtime_error("Texture array needs a positive size and layer count");
+	}
+
+	GLint max_layers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+	if(layers > max_layers)
+	{
+		throw std::runtime_error("Texture array layer count above GL_MAX_ARRAY_TEXTURE_LAYERS: " + std::to_string(layers));
+	}
+
+	glGenTextures(1, &id);
+	gl_state::get().bind_texture(GL_TEXTURE_2D_ARRAY, id);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	if(kind == content::flow)
+	{
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RG16F, width, height, layers, 0, GL_RG, GL_FLOAT, nullptr);
+	}
+	else
+	{
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+}
+
+texture_array::~texture_array()
+{
+	gl_state::get().forget_texture(id);
+	glDeleteTextures(1, &id);
+	if(read_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &read_framebuffer);
+		glDeleteFramebuffers(1, &draw_framebuffer);
+	}
+}
+
+void texture_array::upload(int layer, const cv::Mat &image)
+{
+	if(layer < 0 || layer >= layers)
+	{
+		throw std::out_of_range("Texture array layer out of range: " + std::to_string(layer));
+	}
+
+	GLenum format;
+	GLenum type;
+	if(kind == content::flow)
+	{
+		if(image.type() != CV_32FC2)
+		{
+			throw std::runtime_error("Flow texture array layers need CV_32FC2, got type " + std::to_string(image.type()));
+		}
+		format = GL_RG;
+		type   = GL_FLOAT;
+	}
+	else
+	{
+		switch(image.type())
+		{
+			case CV_8UC1:
+			case CV_8UC3:
+				format = GL_BGR;
+				break;
+			case CV_8UC4:
+				format = GL_BGRA;
+				break;
+			default:
+				throw std::runtime_error("Unsupported cv::Mat type for a texture array: " + std::to_string(image.type()));
+		}
+		type = GL_UNSIGNED_BYTE;
+	}
+
+	// Thumbnails are a fraction of the frame, INTER_AREA averages instead of aliasing
+	const cv::Mat *pixels = &image;
+	if(image.cols != width || image.rows != height)
+	{
+		cv::resize(image, scratch, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+		pixels = &scratch;
+	}
+	if(pixels->type() == CV_8UC1)
+	{
+		cv::cvtColor(*pixels, scratch, cv::COLOR_GRAY2BGR);
+		pixels = &scratch;
+	}
+
+	gl_state::get().bind_texture(GL_TEXTURE_2D_ARRAY, id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(pixels->step / pixels->elemSize()));
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, format, type, pixels->data);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void texture_array::copy_from(const texture &source, int layer)
+{
+	if(layer < 0 || layer >= layers)
+	{
+		throw std::out_of_range("Texture array layer out of range: " + std::to_string(layer));
+	}
+	if(kind != content::colour)
+	{
+		throw std::runtime_error("Only colour texture arrays can copy from a texture");
+	}
+
+	if(read_framebuffer == 0)
+	{
+		glGenFramebuffers(1, &read_framebuffer);
+		glGenFramebuffers(1, &draw_framebuffer);
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, source.get_id(), 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_framebuffer);
+	glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, id, 0, layer);
+
+	if(glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, gl_state::get().get_default_framebuffer());
+		throw std::runtime_error("Texture can't be copied into a texture array layer");
+	}
+
+	// Textures are stored bottom row first, layers top row first
+	glBlitFramebuffer(0, 0, source.get_width(), source.get_height(), 0, height, width, 0, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, gl_state::get().get_default_framebuffer());
+}
+
+void texture_array::bind(GLuint slot) const
+{
+	gl_state::get().active_texture(slot);
+	gl_state::get().bind_texture(GL_TEXTURE_2D_ARRAY, id);
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef CORE_TEXTURE_ARRAY_H
+#define CORE_TEXTURE_ARRAY_H
+
+// clang-format off
+#include <GL/glew.h>
+#include <GL/gl.h>
+// clang-format on
+
+#include "core/shader.h"
+
+#include <opencv2/core.hpp>
+
+/*
+ * GL_TEXTURE_2D_ARRAY of equally sized layers, one texture binding for many images.
+ * Layers are stored with row 0 of the cv::Mat at the top (t = 0).
+ */
+class texture_array
+{
+public:
+	enum class content
+	{
+		colour, // RGBA8, uploaded from 8-bit gray, BGR or BGRA frames
+		flow	// RG16F optical flow vectors, uploaded from CV_32FC2
+	};
+
+private:
+	GLuint id;
+	GLuint read_framebuffer, draw_framebuffer;
+	int width, height, layers;
+	content kind;
+	cv::Mat scratch;
+
+public:
+	texture_array(int width, int height, int layers, content kind = content::colour);
+	~texture_array();
+
+	texture_array(const texture_array &)			= delete;
+	texture_array &operator=(const texture_array &) = delete;
+
+	/* Upload an image into a layer, it is scaled to the layer size */
+	void upload(int layer, const cv::Mat &image);
+
+	/* Scaled GPU copy of a 2D texture into a colour layer, nothing goes through the CPU.
+	   Throws std::runtime_error for textures that can't be read through a framebuffer (compressed) */
+	void copy_from(const texture &source, int layer);
+
+	void bind(GLuint slot = 0) const;
+
+	GLuint get_id() const
+	{
+		return id;
+	}
+	int get_width() const
+	{
+		return width;
+	}
+	int get_height() const
+	{
+		return height;
+	}
+	int get_layers() const
+	{
+		return layers;
+	}
+	content get_content() const
+	{
+		return kind;
+	}
+};
+
+#endif // CORE_TEXTURE_ARRAY_H
\ No newline at end of file
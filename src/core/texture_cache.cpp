@@ -0,0 +1,132 @@
+#include "core/texture_cache.h"
+
+texture_cache::texture_cache(texture_loader &loader, std::size_t budget)
+	: loader(loader), budget(budget), index(std::make_shared<content_index>())
+{
+	// The lookup keeps the index alive, decode tasks may outlive the cache
+	std::shared_ptr<content_index> lookup_index = index;
+	loader.set_content_lookup(
+		[lookup_index](std::uint64_t content_hash) -> std::shared_ptr<texture>
+		{
+			std::lock_guard<std::mutex> lock(lookup_index->mutex);
+			auto found = lookup_index->contents.find(content_hash);
+			if(found == lookup_index->contents.end())
+			{
+				return nullptr;
+			}
+
+			std::shared_ptr<texture> resident = found->second.shared.lock();
+			if(resident)
+			{
+				lookup_index->hits.fetch_add(1, std::memory_order_relaxed);
+			}
+			return resident;
+		});
+}
+
+std::shared_ptr<async_texture> texture_cache::acquire(const std::string &path)
+{
+	auto found = entries.find(path);
+	if(found != entries.end())
+	{
+		stats.hits++;
+		lru.splice(lru.begin(), lru, found->second.lru_position);
+		return found->second.handle;
+	}
+
+	stats.misses++;
+
+	lru.push_front(path);
+	entry &created		  = entries[path];
+	created.handle		  = loader.load(path);
+	created.lru_position  = lru.begin();
+	loading.push_back(path);
+
+	return created.handle;
+}
+
+void texture_cache::update()
+{
+	loader.update();
+	register_loaded();
+	evict();
+
+	stats.content_hits = index->hits.load(std::memory_order_relaxed);
+	stats.entries	   = entries.size();
+}
+
+void texture_cache::register_loaded()
+{
+	std::lock_guard<std::mutex> lock(index->mutex);
+
+	for(auto it = loading.begin(); it != loading.end();)
+	{
+		auto found = entries.find(*it);
+		if(found == entries.end() || found->second.handle->get_state() == async_texture::state::failed)
+		{
+			it = loading.erase(it);
+			continue;
+		}
+
+		const std::shared_ptr<async_texture> &handle = found->second.handle;
+		if(!handle->is_ready())
+		{
+			++it;
+			continue;
+		}
+
+		std::shared_ptr<texture> shared = handle->get_shared();
+		resident_texture &resident		= index->contents[handle->get_content_hash()];
+		if(resident.shared.expired())
+		{
+			resident.shared = shared;
+			resident.bytes	= shared->get_size_bytes();
+		}
+
+		it = loading.erase(it);
+	}
+}
+
+void texture_cache::evict()
+{
+	std::lock_guard<std::mutex> lock(index->mutex);
+
+	std::size_t resident_bytes = 0;
+	for(auto it = index->contents.begin(); it != index->contents.end();)
+	{
+		if(it->second.shared.expired())
+		{
+			it = index->contents.erase(it);
+			continue;
+		}
+		resident_bytes += it->second.bytes;
+		++it;
+	}
+
+	// Coldest first, textures with handles held outside of the cache are never evicted
+	auto it = lru.end();
+	while(resident_bytes > budget && it != lru.begin())
+	{
+		--it;
+		auto found = entries.find(*it);
+		const std::shared_ptr<async_texture> &handle = found->second.handle;
+		if(handle.use_count() > 1 || handle->get_state() == async_texture::state::loading)
+		{
+			continue;
+		}
+
+		std::uint64_t content_hash = handle->get_content_hash();
+		entries.erase(found);
+		it = lru.erase(it);
+		stats.evictions++;
+
+		auto content = index->contents.find(content_hash);
+		if(content != index->contents.end() && content->second.shared.expired())
+		{
+			resident_bytes -= content->second.bytes;
+			index->contents.erase(content);
+		}
+	}
+
+	stats.resident_bytes = resident_bytes;
+}
\ No newline at end of file
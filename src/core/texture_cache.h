@@ -0,0 +1,97 @@
+#ifndef CORE_TEXTURE_CACHE_H
+#define CORE_TEXTURE_CACHE_H
+
+#include "core/texture_loader.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Path and content keyed texture cache on top of texture_loader.
+ * Handles are shared, a texture nobody holds a handle to is cold and is evicted in LRU
+ * order once the resident textures exceed the GPU memory budget.
+ * Files with the same content share one GL texture and are decoded only once.
+ */
+class texture_cache
+{
+public:
+	struct statistics
+	{
+		std::size_t hits		   = 0; // path was already cached
+		std::size_t misses		   = 0; // path had to be loaded
+		std::size_t content_hits   = 0; // loaded path had the content of a resident texture
+		std::size_t evictions	   = 0;
+		std::size_t resident_bytes = 0;
+		std::size_t entries		   = 0;
+	};
+
+private:
+	struct entry
+	{
+		std::shared_ptr<async_texture> handle;
+		std::list<std::string>::iterator lru_position;
+	};
+
+	struct resident_texture
+	{
+		std::weak_ptr<texture> shared;
+		std::size_t bytes;
+	};
+
+	texture_loader &loader;
+	std::size_t budget;
+
+	std::unordered_map<std::string, entry> entries;
+	std::list<std::string> lru; // front - most recently used
+	std::vector<std::string> loading;
+
+	/* Resident textures by content hash, shared with the loader's decode threads */
+	struct content_index
+	{
+		std::mutex mutex;
+		std::unordered_map<std::uint64_t, resident_texture> contents;
+		std::atomic<std::size_t> hits {0};
+	};
+	std::shared_ptr<content_index> index;
+
+	statistics stats;
+
+	void register_loaded();
+	void evict();
+
+public:
+	/* budget - GPU memory in bytes the resident textures may use */
+	texture_cache(texture_loader &loader, std::size_t budget);
+
+	texture_cache(const texture_cache &)			= delete;
+	texture_cache &operator=(const texture_cache &) = delete;
+
+	/* Cached handle for the path, loading starts on a miss */
+	std::shared_ptr<async_texture> acquire(const std::string &path);
+
+	/* Upload finished images and evict cold textures, call once per frame from the render thread */
+	void update();
+
+	void set_budget(std::size_t bytes)
+	{
+		budget = bytes;
+	}
+	std::size_t get_budget() const
+	{
+		return budget;
+	}
+
+	const statistics &get_statistics() const
+	{
+		return stats;
+	}
+};
+
+#endif // CORE_TEXTURE_CACHE_H
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "core/texture_loader.h"
+
+#include "core/hash.h"
+#include "core/raw_image.h"
+
+#include <algorithm>
+#include <climits>
+#include <exception>
+#include <gli/gli.hpp>
+#include <spdlog/spdlog.h>
+#include <stb_image.h>
+#include <stdexcept>
+
+texture_loader::texture_loader(thread_pool &pool, std::size_t upload_budget)
+	: pool(pool), upload_budget(upload_budget), placeholder(2, 2), queue(std::make_shared<decode_queue>())
+{
+	// Gray checker shown until the image is uploaded
+	const unsigned char checker[] = {96, 96, 96, 255, 160, 160, 160, 255, 160, 160, 160, 255, 96, 96, 96, 255};
+	placeholder.upload_rows(0, 2, checker);
+}
+
+texture_loader::~texture_loader()
+{
+	// Decode tasks still running only hold the shared queue and drop their results
+}
+
+std::shared_ptr<async_texture> texture_loader::load(const std::string &path)
+{
+	auto handle = std::make_shared<async_texture>(path, &placeholder);
+
+	auto image	  = std::make_shared<decoded_image>();
+	image->target = handle;
+
+	queue->in_flight.fetch_add(1, std::memory_order_relaxed);
+	std::shared_ptr<decode_queue> decode_target = queue;
+	pool.submit([decode_target, image, path]() { decode(decode_target, image, path); });
+
+	return handle;
+}
+
+void texture_loader::decode(const std::shared_ptr<decode_queue> &queue, std::shared_ptr<decoded_image> image, const std::string &path)
+{
+	// Nobody is waiting for it any more
+	if(image->target.expired())
+	{
+		queue->in_flight.fetch_sub(1, std::memory_order_relaxed);
+		return;
+	}
+
+	try
+	{
+		auto mapping		   = std::make_shared<mapped_file>(path);
+		const mapped_file &file = *mapping;
+
+		std::uint64_t content_hash = hash_bytes(file.data(), file.size());
+		if(auto target = image->target.lock())
+		{
+			target->content_hash.store(content_hash, std::memory_order_release);
+		}
+
+		if(queue->lookup)
+		{
+			image->existing = queue->lookup(content_hash);
+		}
+
+		if(image->existing)
+		{
+			std::lock_guard<std::mutex> lock(queue->finished_mutex);
+			queue->finished.push_back(std::move(image));
+			return;
+		}
+
+		if(is_gli_texture_file(path))
+		{
+			// Flipped here, off the render thread
+			image->compressed = std::make_shared<gli::texture>(load_gli_texture(file.data(), file.size(), path));
+
+			std::lock_guard<std::mutex> lock(queue->finished_mutex);
+			queue->finished.push_back(std::move(image));
+			return;
+		}
+
+		if(is_raw_image_file(path))
+		{
+			// Hashing has paged the file in, the render thread uploads it from the mapping
+			raw_image raw(file.data(), file.size());
+			image->width   = raw.get_width();
+			image->height  = raw.get_height();
+			image->rows	   = raw.get_pixels();
+			image->mapping = std::move(mapping);
+
+			std::lock_guard<std::mutex> lock(queue->finished_mutex);
+			queue->finished.push_back(std::move(image));
+			return;
+		}
+
+		// stb_image takes the size as an int
+		if(file.size() > static_cast<std::size_t>(INT_MAX))
+		{
+			throw std::runtime_error("Image too large to decode: " + path);
+		}
+		int channels;
+		stbi_set_flip_vertically_on_load_thread(1);
+		unsigned char *pixels =
+			stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &image->width, &image->height, &channels, 4);
+
+		if(!pixels)
+		{
+			throw std::runtime_error("Failed decoding image: " + path + ": " + stbi_failure_reason());
+		}
+
+		image->pixels = std::unique_ptr<unsigned char, void (*)(void *)>(pixels, stbi_image_free);
+		image->rows	  = image->pixels.get();
+	}
+	catch(std::exception &e)
+	{
+		spdlog::error("Error: {}", e.what());
+		if(auto target = image->target.lock())
+		{
+			target->current_state.store(async_texture::state::failed, std::memory_order_release);
+		}
+		queue->in_flight.fetch_sub(1, std::memory_order_relaxed);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(queue->finished_mutex);
+	queue->finished.push_back(std::move(image));
+}
+
+void texture_loader::update()
+{
+	{
+		std::lock_guard<std::mutex> lock(queue->finished_mutex);
+		while(!queue->finished.empty())
+		{
+			uploads.push_back(std::move(queue->finished.front()));
+			queue->finished.pop_front();
+		}
+	}
+
+	std::size_t budget = upload_budget;
+	while(!uploads.empty())
+	{
+		std::shared_ptr<decoded_image> &image = uploads.front();
+		std::shared_ptr<async_texture> target = image->target.lock();
+		if(!target)
+		{
+			uploads.pop_front();
+			queue->in_flight.fetch_sub(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		if(image->existing)
+		{
+			target->loaded = std::move(image->existing);
+			target->current_state.store(async_texture::state::ready, std::memory_order_release);
+			uploads.pop_front();
+			queue->in_flight.fetch_sub(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		if(image->compressed)
+		{
+			// Compressed files are small and uploaded in one go, in a frame with enough budget left.
+			// The first upload of a frame always goes ahead, a file larger than the budget still loads
+			std::size_t size = image->compressed->size();
+			if(size > budget && budget < upload_budget)
+			{
+				break;
+			}
+			try
+			{
+				target->loaded = std::make_shared<texture>(*image->compressed);
+				target->current_state.store(async_texture::state::ready, std::memory_order_release);
+			}
+			catch(std::exception &e)
+			{
+				spdlog::error("Error: {}: {}", target->get_path(), e.what());
+				target->current_state.store(async_texture::state::failed, std::memory_order_release);
+			}
+
+			budget = size >= budget ? 0 : budget - size;
+			uploads.pop_front();
+			queue->in_flight.fetch_sub(1, std::memory_order_relaxed);
+			if(budget == 0)
+			{
+				break;
+			}
+			continue;
+		}
+
+		if(!image->uploading)
+		{
+			image->uploading = std::make_unique<texture>(image->width, image->height);
+		}
+
+		// Large images are uploaded in stripes of rows over several frames
+		std::size_t row_bytes = static_cast<std::size_t>(image->width) * 4;
+		int remaining_rows	  = image->height - image->uploaded_rows;
+		int rows			  = std::max(1, static_cast<int>(std::min<std::size_t>(remaining_rows, budget / row_bytes)));
+
+		image->uploading->upload_rows(image->uploaded_rows, rows, image->rows + image->uploaded_rows * row_bytes);
+		image->uploaded_rows += rows;
+
+		std::size_t spent = rows * row_bytes;
+		budget			  = spent >= budget ? 0 : budget - spent;
+
+		if(image->uploaded_rows == image->height)
+		{
+			target->loaded = std::move(image->uploading);
+			target->current_state.store(async_texture::state::ready, std::memory_order_release);
+			uploads.pop_front();
+			queue->in_flight.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		if(budget == 0)
+		{
+			break;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,180 @@
+#ifndef CORE_TEXTURE_LOADER_H
+#define CORE_TEXTURE_LOADER_H
+
+#include "core/mapped_file.h"
+#include "core/shader.h"
+#include "core/thread_pool.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace gli
+{
+	class texture;
+} // namespace gli
+
+/*
+ * Texture whose image is decoded in the background.
+ * Until the upload is finished get() returns the loader's placeholder.
+ */
+class async_texture
+{
+	friend class texture_loader;
+
+public:
+	enum class state
+	{
+		loading,
+		ready,
+		failed
+	};
+
+private:
+	std::string path;
+	std::atomic<state> current_state;
+	std::atomic<std::uint64_t> content_hash;
+	std::shared_ptr<texture> loaded;
+	const texture *placeholder;
+
+public:
+	async_texture(const std::string &path, const texture *placeholder)
+		: path(path), current_state(state::loading), content_hash(0), placeholder(placeholder)
+	{
+	}
+
+	state get_state() const
+	{
+		return current_state.load(std::memory_order_acquire);
+	}
+	bool is_ready() const
+	{
+		return get_state() == state::ready;
+	}
+
+	/* The loaded texture, or the placeholder while loading or after a failure */
+	const texture &get() const
+	{
+		return is_ready() ? *loaded : *placeholder;
+	}
+
+	void bind(GLuint slot = 0) const
+	{
+		get().bind(slot);
+	}
+
+	/* Shared texture once ready, nullptr before that */
+	std::shared_ptr<texture> get_shared() const
+	{
+		return is_ready() ? loaded : nullptr;
+	}
+
+	/* Hash of the file contents, known once the file was read */
+	std::uint64_t get_content_hash() const
+	{
+		return content_hash.load(std::memory_order_acquire);
+	}
+
+	const std::string &get_path() const
+	{
+		return path;
+	}
+};
+
+/*
+ * Asynchronous texture loader.
+ * Worker threads decode images from memory-mapped files (KTX/DDS are only parsed and flipped,
+ * their block-compressed levels are uploaded as they are, raw .lyr images are uploaded from the
+ * mapping without any copy), the render thread calls update()
+ * once per frame and uploads the finished images within a per-frame byte budget, compressed
+ * files included.
+ * All GL calls happen in the constructor, update() and the destructor, on the render thread.
+ */
+class texture_loader
+{
+private:
+	struct decoded_image
+	{
+		std::weak_ptr<async_texture> target;
+		int width  = 0;
+		int height = 0;
+		std::unique_ptr<unsigned char, void (*)(void *)> pixels {nullptr, nullptr};
+		/* Raw images are uploaded straight from the mapping, nothing is decoded */
+		std::shared_ptr<mapped_file> mapping;
+		/* RGBA8 rows, bottom row first, in pixels or in the mapping */
+		const unsigned char *rows = nullptr;
+		std::unique_ptr<texture> uploading;
+		int uploaded_rows = 0;
+		/* Same content is already resident, nothing to decode or upload */
+		std::shared_ptr<texture> existing;
+		/* KTX/DDS/KMG file read by gli, uploaded level by level without decoding */
+		std::shared_ptr<gli::texture> compressed;
+	};
+
+public:
+	/* Called on a worker thread with the content hash, returns the resident texture with that content if any */
+	using content_lookup = std::function<std::shared_ptr<texture>(std::uint64_t)>;
+
+private:
+
+	/* Shared with the decode tasks, so they never touch a destroyed loader */
+	struct decode_queue
+	{
+		std::mutex finished_mutex;
+		std::deque<std::shared_ptr<decoded_image>> finished;
+		std::atomic<std::size_t> in_flight {0};
+		content_lookup lookup;
+	};
+
+	thread_pool &pool;
+	std::size_t upload_budget;
+	texture placeholder;
+
+	std::shared_ptr<decode_queue> queue;
+	std::deque<std::shared_ptr<decoded_image>> uploads;
+
+	static void decode(const std::shared_ptr<decode_queue> &queue, std::shared_ptr<decoded_image> image, const std::string &path);
+
+public:
+	/* upload_budget - bytes uploaded per update(), at least one row is always uploaded */
+	texture_loader(thread_pool &pool, std::size_t upload_budget = 8 * 1024 * 1024);
+	~texture_loader();
+
+	texture_loader(const texture_loader &)			  = delete;
+	texture_loader &operator=(const texture_loader &) = delete;
+
+	/* Start loading, the handle shows the placeholder until the image is uploaded */
+	std::shared_ptr<async_texture> load(const std::string &path);
+
+	/* Upload finished images, call once per frame from the render thread */
+	void update();
+
+	/* Set before the first load(), used to skip decoding files whose content is already resident */
+	void set_content_lookup(content_lookup lookup)
+	{
+		queue->lookup = std::move(lookup);
+	}
+
+	void set_upload_budget(std::size_t bytes)
+	{
+		upload_budget = bytes;
+	}
+
+	/* Images decoding or waiting for upload */
+	std::size_t get_pending_count() const
+	{
+		return queue->in_flight.load(std::memory_order_relaxed);
+	}
+
+	const texture &get_placeholder() const
+	{
+		return placeholder;
+	}
+};
+
+#endif // CORE_TEXTURE_LOADER_H
\ No newline at end of file
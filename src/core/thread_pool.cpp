@@ -0,0 +1,240 @@
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+#include <pthread.h>
+#include <sched.h>
+#include <spdlog/spdlog.h>
+
+namespace
+{
+	// Set on the workers, submissions and parallel_for tell the pool's own threads apart with it
+	thread_local const thread_pool *worker_pool = nullptr;
+	thread_local std::size_t worker_index		= 0;
+
+	/* State of a parallel_for shared with its helper tasks, which may start after the call returned */
+	struct parallel_range
+	{
+		std::atomic<int> next;
+		int end;
+		int chunk;
+		const std::function<void(int, int)> *body;
+
+		std::mutex mutex;
+		std::condition_variable finished;
+		int running = 0;
+		bool closed = false;
+		std::exception_ptr error;
+
+		void run()
+		{
+			try
+			{
+				for(;;)
+				{
+					int start = next.fetch_add(chunk, std::memory_order_relaxed);
+					if(start >= end)
+					{
+						return;
+					}
+					(*body)(start, std::min(end, start + chunk));
+				}
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if(!error)
+				{
+					error = std::current_exception();
+				}
+				// The remaining chunks are skipped
+				next.store(end, std::memory_order_relaxed);
+			}
+		}
+	};
+} // namespace
+
+thread_pool::thread_pool(std::size_t threads, const std::vector<int> &cores) : next_queue(0), queued(0), steals(0), stopping(false)
+{
+	if(threads == 0)
+	{
+		threads = std::thread::hardware_concurrency();
+	}
+	if(threads == 0)
+	{
+		threads = 1;
+	}
+
+	for(std::size_t i = 0; i < threads; i++)
+	{
+		queues.push_back(std::make_unique<worker_queue>());
+	}
+	for(std::size_t i = 0; i < threads; i++)
+	{
+		int core = cores.empty() ? -1 : cores[i % cores.size()];
+		workers.emplace_back(&thread_pool::worker_loop, this, i, core);
+	}
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+	sleep_condition.notify_all();
+
+	for(std::thread &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+int thread_pool::get_worker_index() const
+{
+	return worker_pool == this ? static_cast<int>(worker_index) : -1;
+}
+
+void thread_pool::push(std::function<void()> task)
+{
+	// A worker keeps its own tasks, other threads spread theirs
+	std::size_t index = worker_pool == this ? worker_index : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+	// Counted before it can be taken, the count never drops below the tasks in the queues
+	queued.fetch_add(1, std::memory_order_release);
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->tasks.push_back(std::move(task));
+	}
+
+	// Taking the lock orders the count with a worker about to sleep, no wakeup is lost
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	sleep_condition.notify_one();
+}
+
+bool thread_pool::run_one(std::size_t home)
+{
+	std::function<void()> task;
+
+	// Newest own task first, it is the most likely to still be in the cache
+	{
+		worker_queue &own = *queues[home];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if(!own.tasks.empty())
+		{
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+		}
+	}
+
+	// Oldest task of another queue, the victim keeps working on its recent ones
+	for(std::size_t i = 1; !task && i < queues.size(); i++)
+	{
+		worker_queue &victim = *queues[(home + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if(!victim.tasks.empty())
+		{
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			steals.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	if(!task)
+	{
+		return false;
+	}
+
+	queued.fetch_sub(1, std::memory_order_acq_rel);
+	task();
+	return true;
+}
+
+void thread_pool::worker_loop(std::size_t index, int core)
+{
+	worker_pool	 = this;
+	worker_index = index;
+
+	if(core >= 0)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(core, &set);
+		if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+		{
+			spdlog::warn("Can't pin worker {} to core {}", index, core);
+		}
+	}
+
+	for(;;)
+	{
+		if(run_one(index))
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		sleep_condition.wait(lock, [this]() { return stopping || queued.load(std::memory_order_acquire) > 0; });
+		if(stopping && queued.load(std::memory_order_acquire) == 0)
+		{
+			return;
+		}
+	}
+}
+
+void thread_pool::parallel_for(int begin, int end, const std::function<void(int, int)> &body, std::size_t max_workers)
+{
+	if(begin >= end)
+	{
+		return;
+	}
+
+	std::size_t runners = workers.size() + 1;
+	if(max_workers > 0)
+	{
+		runners = std::min(runners, max_workers);
+	}
+	runners = std::min(runners, static_cast<std::size_t>(end - begin));
+
+	// A few chunks per runner even out uneven work without claiming every index
+	auto range	 = std::make_shared<parallel_range>();
+	range->next	 = begin;
+	range->end	 = end;
+	range->chunk = std::max(1, (end - begin) / static_cast<int>(runners * 4));
+	range->body	 = &body;
+
+	for(std::size_t i = 1; i < runners; i++)
+	{
+		push(
+			[range]()
+			{
+				{
+					std::lock_guard<std::mutex> lock(range->mutex);
+					if(range->closed)
+					{
+						return;
+					}
+					range->running++;
+				}
+				range->run();
+				{
+					std::lock_guard<std::mutex> lock(range->mutex);
+					range->running--;
+				}
+				range->finished.notify_one();
+			});
+	}
+
+	range->run();
+
+	// Helpers that haven't started yet find the range closed, body isn't touched after this returns
+	std::unique_lock<std::mutex> lock(range->mutex);
+	range->closed = true;
+	range->finished.wait(lock, [&]() { return range->running == 0; });
+	if(range->error)
+	{
+		std::rethrow_exception(range->error);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#ifndef CORE_THREAD_POOL_H
+#define CORE_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Work stealing pool of worker threads, the one set of threads the project's parallel work runs on.
+ * Every worker has its own queue: tasks submitted by a worker go to its queue and are run newest
+ * first while they are hot in its cache, tasks from other threads are spread round robin, and an
+ * idle worker steals the oldest task of another queue. Workers can be pinned to cores.
+ * The destructor finishes the queued tasks and joins.
+ */
+class thread_pool
+{
+private:
+	struct worker_queue
+	{
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	std::vector<std::unique_ptr<worker_queue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<std::size_t> next_queue;
+	std::atomic<std::size_t> queued;
+	std::atomic<std::size_t> steals;
+
+	std::mutex sleep_mutex;
+	std::condition_variable sleep_condition;
+	bool stopping;
+
+	void worker_loop(std::size_t index, int core);
+	void push(std::function<void()> task);
+
+	/* Run a task of queue home, or one stolen from another queue. false if all queues were empty */
+	bool run_one(std::size_t home);
+
+public:
+	/* threads - number of workers, 0 - one per hardware thread.
+	   cores - CPUs the workers are pinned to in turn, empty - not pinned */
+	thread_pool(std::size_t threads = 0, const std::vector<int> &cores = {});
+	~thread_pool();
+
+	thread_pool(const thread_pool &)			= delete;
+	thread_pool &operator=(const thread_pool &) = delete;
+
+	template<typename F>
+	std::future<std::invoke_result_t<F>> submit(F &&function)
+	{
+		using result_type = std::invoke_result_t<F>;
+
+		auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<F>(function));
+		std::future<result_type> result = task->get_future();
+		push([task]() { (*task)(); });
+		return result;
+	}
+
+	/* Run body over [begin, end) in chunks, on the calling thread and at most max_workers - 1 workers.
+	   max_workers is the core budget of the caller, 0 - the whole pool. The caller takes part, so nested
+	   calls from a worker can't deadlock. The first exception thrown by body is rethrown */
+	void parallel_for(int begin, int end, const std::function<void(int, int)> &body, std::size_t max_workers = 0);
+
+	std::size_t get_thread_count() const
+	{
+		return workers.size();
+	}
+
+	/* Index of the calling worker of this pool, -1 on other threads */
+	int get_worker_index() const;
+
+	/* Tasks run by a worker other than the one they were queued for */
+	std::size_t get_steal_count() const
+	{
+		return steals.load(std::memory_order_relaxed);
+	}
+};
+
+#endif // CORE_THREAD_POOL_H
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include "core/tiled_image.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <opencv2/imgproc.hpp>
+#include <stdexcept>
+#include <system_error>
+
+namespace
+{
+	constexpr char tiled_magic[4]		  = {'L', 'Y', 'T', 'I'};
+	constexpr std::uint32_t tiled_version = 1;
+	constexpr std::size_t tile_alignment  = 4096;
+	constexpr std::uint32_t max_levels	  = 32;
+
+	struct file_header
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint32_t tile_size;
+		std::uint32_t border;
+		std::uint32_t levels;
+		std::uint32_t reserved;
+		std::uint64_t data_offset;
+		std::uint64_t tile_stride;
+	};
+
+	// Followed by one entry per level
+	struct level_entry
+	{
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint32_t columns;
+		std::uint32_t rows;
+	};
+
+	std::size_t align_up(std::size_t value)
+	{
+		return (value + tile_alignment - 1) / tile_alignment * tile_alignment;
+	}
+
+	void write_padding(std::ofstream &file, std::size_t bytes)
+	{
+		static const char zeros[tile_alignment] = {};
+		while(bytes > 0)
+		{
+			std::size_t chunk = std::min(bytes, tile_alignment);
+			file.write(zeros, static_cast<std::streamsize>(chunk));
+			bytes -= chunk;
+		}
+	}
+} // namespace
+
+tiled_image::tiled_image(const std::string &path)
+	: file(path, mapped_file::access::random),
+	  tile_size(0),
+	  border(0),
+	  tile_stride(0),
+	  data_offset(0)
+{
+	file_header header;
+	if(file.size() < sizeof(header))
+	{
+		throw std::runtime_error("Not a tiled image: " + path);
+	}
+	std::memcpy(&header, file.data(), sizeof(header));
+
+	if(std::memcmp(header.magic, tiled_magic, sizeof(tiled_magic)) != 0)
+	{
+		throw std::runtime_error("Not a tiled image: " + path);
+	}
+	if(header.version != tiled_version)
+	{
+		throw std::runtime_error("Unsupported tiled image version " + std::to_string(header.version) + ": " + path);
+	}
+	if(header.levels == 0 || header.levels > max_levels || header.tile_size == 0 || header.border >= header.tile_size)
+	{
+		throw std::runtime_error("Corrupt tiled image header: " + path);
+	}
+
+	tile_size	= static_cast<int>(header.tile_size);
+	border		= static_cast<int>(header.border);
+	tile_stride = static_cast<std::size_t>(header.tile_stride);
+	data_offset = static_cast<std::size_t>(header.data_offset);
+
+	std::size_t pixels = static_cast<std::size_t>(get_tile_pixels());
+	if(tile_stride < pixels * pixels * 4 || sizeof(header) + header.levels * sizeof(level_entry) > data_offset)
+	{
+		throw std::runtime_error("Corrupt tiled image header: " + path);
+	}
+
+	std::size_t tiles = 0;
+	for(std::uint32_t i = 0; i < header.levels; i++)
+	{
+		level_entry entry;
+		std::memcpy(&entry, file.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+
+		level l;
+		l.width		 = static_cast<int>(entry.width);
+		l.height	 = static_cast<int>(entry.height);
+		l.columns	 = static_cast<int>(entry.columns);
+		l.rows		 = static_cast<int>(entry.rows);
+		l.first_tile = tiles;
+		if(l.width <= 0 || l.height <= 0 || l.columns != (l.width + tile_size - 1) / tile_size ||
+		   l.rows != (l.height + tile_size - 1) / tile_size)
+		{
+			throw std::runtime_error("Corrupt tiled image level table: " + path);
+		}
+
+		tiles += static_cast<std::size_t>(l.columns) * static_cast<std::size_t>(l.rows);
+		levels.push_back(l);
+	}
+
+	if(file.size() < data_offset + tiles * tile_stride)
+	{
+		throw std::runtime_error("Truncated tiled image: " + path);
+	}
+}
+
+void tiled_image::write(const std::string &path, const cv::Mat &image, int tile_size, int border)
+{
+	if(image.empty() || image.depth() != CV_8U)
+	{
+		throw std::runtime_error("Tiled images are built from 8-bit images");
+	}
+	if(tile_size <= 0 || border < 0 || border >= tile_size)
+	{
+		throw std::runtime_error("Invalid tile size " + std::to_string(tile_size) + " with border " + std::to_string(border));
+	}
+
+	cv::Mat current;
+	switch(image.channels())
+	{
+		case 1:
+			cv::cvtColor(image, current, cv::COLOR_GRAY2BGRA);
+			break;
+		case 3:
+			cv::cvtColor(image, current, cv::COLOR_BGR2BGRA);
+			break;
+		case 4:
+			current = image;
+			break;
+		default:
+			throw std::runtime_error("Unsupported channel count for a tiled image: " + std::to_string(image.channels()));
+	}
+
+	// Halve until everything fits into one tile
+	std::vector<level_entry> entries;
+	int width  = current.cols;
+	int height = current.rows;
+	while(true)
+	{
+		level_entry entry;
+		entry.width	  = static_cast<std::uint32_t>(width);
+		entry.height  = static_cast<std::uint32_t>(height);
+		entry.columns = static_cast<std::uint32_t>((width + tile_size - 1) / tile_size);
+		entry.rows	  = static_cast<std::uint32_t>((height + tile_size - 1) / tile_size);
+		entries.push_back(entry);
+
+		if((width <= tile_size && height <= tile_size) || entries.size() == max_levels)
+		{
+			break;
+		}
+		width  = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+
+	const int pixels = tile_size + 2 * border;
+
+	file_header header;
+	std::memcpy(header.magic, tiled_magic, sizeof(tiled_magic));
+	header.version	   = tiled_version;
+	header.width	   = static_cast<std::uint32_t>(current.cols);
+	header.height	   = static_cast<std::uint32_t>(current.rows);
+	header.tile_size   = static_cast<std::uint32_t>(tile_size);
+	header.border	   = static_cast<std::uint32_t>(border);
+	header.levels	   = static_cast<std::uint32_t>(entries.size());
+	header.reserved	   = 0;
+	header.data_offset = align_up(sizeof(header) + entries.size() * sizeof(level_entry));
+	header.tile_stride = align_up(static_cast<std::size_t>(pixels) * pixels * 4);
+
+	// Written aside and renamed, the viewer never maps a half written pyramid
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char *>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(level_entry)));
+		write_padding(file, header.data_offset - sizeof(header) - entries.size() * sizeof(level_entry));
+
+		std::size_t tile_bytes = static_cast<std::size_t>(pixels) * pixels * 4;
+		for(std::size_t l = 0; l < entries.size() && file; l++)
+		{
+			const level_entry &entry = entries[l];
+			if(l > 0)
+			{
+				// Each level from the previous one, INTER_AREA averages the 2x2 texels
+				cv::Mat next;
+				cv::resize(current, next, cv::Size(static_cast<int>(entry.width), static_cast<int>(entry.height)), 0, 0, cv::INTER_AREA);
+				current = next;
+			}
+
+			// Borders and the partial tiles at the right and bottom edges repeat the edge pixels
+			cv::Mat padded;
+			cv::copyMakeBorder(
+				current,
+				padded,
+				border,
+				border + static_cast<int>(entry.rows) * tile_size - current.rows,
+				border,
+				border + static_cast<int>(entry.columns) * tile_size - current.cols,
+				cv::BORDER_REPLICATE);
+
+			for(int row = 0; row < static_cast<int>(entry.rows); row++)
+			{
+				for(int column = 0; column < static_cast<int>(entry.columns); column++)
+				{
+					cv::Mat tile = padded(cv::Rect(column * tile_size, row * tile_size, pixels, pixels));
+					for(int y = 0; y < pixels; y++)
+					{
+						file.write(reinterpret_cast<const char *>(tile.ptr(y)), static_cast<std::streamsize>(pixels) * 4);
+					}
+					write_padding(file, header.tile_stride - tile_bytes);
+				}
+			}
+		}
+
+		if(!file)
+		{
+			throw std::runtime_error("Can't write tiled image " + temporary);
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if(error)
+	{
+		throw std::runtime_error("Can't store tiled image " + path + ": " + error.message());
+	}
+}
+
+std::size_t tiled_image::tile_offset(int level, int column, int row) const
+{
+	if(level < 0 || level >= get_level_count())
+	{
+		throw std::out_of_range("Tiled image level out of range: " + std::to_string(level));
+	}
+
+	const tiled_image::level &l = levels[static_cast<std::size_t>(level)];
+	if(column < 0 || column >= l.columns || row < 0 || row >= l.rows)
+	{
+		throw std::out_of_range("Tiled image tile out of range: " + std::to_string(column) + ", " + std::to_string(row));
+	}
+
+	std::size_t index = l.first_tile + static_cast<std::size_t>(row) * static_cast<std::size_t>(l.columns) + static_cast<std::size_t>(column);
+	return data_offset + index * tile_stride;
+}
+
+cv::Mat tiled_image::get_tile(int level, int column, int row) const
+{
+	// cv::Mat has no read-only header, the mapping itself is PROT_READ
+	unsigned char *pixels = const_cast<unsigned char *>(file.data() + tile_offset(level, column, row));
+	return cv::Mat(get_tile_pixels(), get_tile_pixels(), CV_8UC4, pixels);
+}
+
+void tiled_image::prefetch(int level, int column, int row) const
+{
+	std::size_t pixels = static_cast<std::size_t>(get_tile_pixels());
+	file.will_need(tile_offset(level, column, row), pixels * pixels * 4);
+}
+
+bool is_tiled_image_file(const std::string &path)
+{
+	std::size_t dot = path.find_last_of('.');
+	if(dot == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+	return extension == "lyt";
+}
\ No newline at end of file
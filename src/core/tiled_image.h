@@ -0,0 +1,87 @@
+#ifndef CORE_TILED_IMAGE_H
+#define CORE_TILED_IMAGE_H
+
+#include "core/mapped_file.h"
+
+#include <cstddef>
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+/*
+ * Tiled mip pyramid of a large image in a memory mapped .lyt file.
+ * Every level is half the size of the previous one and cut into square tiles, the last level
+ * is a single tile. Tiles carry a border of neighbouring pixels so bilinear filtering doesn't
+ * seam between them, they are BGRA, top row first, and start on a 4 KiB boundary so a tile
+ * can be paged in without touching its neighbours.
+ * Nothing is decoded, a tile goes from the mapping straight to glTexSubImage.
+ */
+class tiled_image
+{
+public:
+	struct level
+	{
+		int width, height;
+		int columns, rows;
+		std::size_t first_tile; // index of the level's first tile in the file
+	};
+
+private:
+	mapped_file file;
+	int tile_size;
+	int border;
+	std::size_t tile_stride;
+	std::size_t data_offset;
+	std::vector<level> levels;
+
+	std::size_t tile_offset(int level, int column, int row) const;
+
+public:
+	/* Throws std::runtime_error if the file isn't a valid tiled image */
+	tiled_image(const std::string &path);
+
+	/* Build the pyramid of an 8-bit gray, BGR or BGRA image and write it to path.
+	   Throws std::runtime_error if the image is unsupported or the file can't be written */
+	static void write(const std::string &path, const cv::Mat &image, int tile_size = 256, int border = 1);
+
+	/* Tile pixels including the border, points into the mapping and must not be written to */
+	cv::Mat get_tile(int level, int column, int row) const;
+
+	/* Start paging a tile in ahead of get_tile */
+	void prefetch(int level, int column, int row) const;
+
+	const level &get_level(int index) const
+	{
+		return levels[static_cast<std::size_t>(index)];
+	}
+	int get_level_count() const
+	{
+		return static_cast<int>(levels.size());
+	}
+	int get_width() const
+	{
+		return levels.front().width;
+	}
+	int get_height() const
+	{
+		return levels.front().height;
+	}
+	int get_tile_size() const
+	{
+		return tile_size;
+	}
+	int get_border() const
+	{
+		return border;
+	}
+	/* Side of a stored tile, border included */
+	int get_tile_pixels() const
+	{
+		return tile_size + 2 * border;
+	}
+};
+
+/* File extension of tiled images */
+bool is_tiled_image_file(const std::string &path);
+
+#endif // CORE_TILED_IMAGE_H
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "core/tiled_view.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	constexpr std::uint64_t pinned = std::numeric_limits<std::uint64_t>::max();
+} // namespace
+
+tiled_view::tiled_view(shader_manager &shaders, const tiled_image &image, int cache_tiles)
+	: image(image),
+	  cache(image.get_tile_pixels(), image.get_tile_pixels(), cache_tiles),
+	  batch(shaders),
+	  frame(0),
+	  uploads_per_frame(8),
+	  last_level(0)
+{
+	for(int layer = cache_tiles - 1; layer >= 0; layer--)
+	{
+		free_layers.push_back(layer);
+	}
+
+	// The last level is the fallback for everything
+	upload(image.get_level_count() - 1, 0, 0, pinned);
+}
+
+std::uint64_t tiled_view::tile_key(int level, int column, int row)
+{
+	return static_cast<std::uint64_t>(level) << 56 | static_cast<std::uint64_t>(row) << 28 | static_cast<std::uint64_t>(column);
+}
+
+int tiled_view::acquire_layer()
+{
+	if(!free_layers.empty())
+	{
+		int layer = free_layers.back();
+		free_layers.pop_back();
+		return layer;
+	}
+
+	auto oldest = resident.end();
+	for(auto it = resident.begin(); it != resident.end(); ++it)
+	{
+		if(it->second.last_used < frame && (oldest == resident.end() || it->second.last_used < oldest->second.last_used))
+		{
+			oldest = it;
+		}
+	}
+	if(oldest == resident.end())
+	{
+		return -1;
+	}
+
+	int layer = oldest->second.layer;
+	resident.erase(oldest);
+	stats.evictions++;
+	return layer;
+}
+
+bool tiled_view::upload(int level, int column, int row, std::uint64_t last_used)
+{
+	int layer = acquire_layer();
+	if(layer < 0)
+	{
+		return false;
+	}
+
+	// BGRA straight from the mapping, texture_array::upload doesn't convert matching layers
+	cache.upload(layer, image.get_tile(level, column, row));
+	resident[tile_key(level, column, row)] = {layer, last_used};
+	stats.uploads++;
+	return true;
+}
+
+void tiled_view::add_quad(int level, int column, int row, int layer, float x0, float y0, float x1, float y1)
+{
+	// The rectangle is in level 0 pixels, the layer holds the tile with its border
+	const tiled_image::level &l = image.get_level(level);
+	float scale_x				= static_cast<float>(l.width) / static_cast<float>(image.get_width());
+	float scale_y				= static_cast<float>(l.height) / static_cast<float>(image.get_height());
+	float origin_x				= static_cast<float>(column * image.get_tile_size() - image.get_border());
+	float origin_y				= static_cast<float>(row * image.get_tile_size() - image.get_border());
+	float pixels				= static_cast<float>(image.get_tile_pixels());
+
+	batch.add(
+		cache,
+		layer,
+		x0,
+		y0,
+		x1 - x0,
+		y1 - y0,
+		(x0 * scale_x - origin_x) / pixels,
+		(y0 * scale_y - origin_y) / pixels,
+		(x1 * scale_x - origin_x) / pixels,
+		(y1 * scale_y - origin_y) / pixels);
+}
+
+void tiled_view::draw(const glm::mat4 &transform, int viewport_width, int viewport_height)
+{
+	frame++;
+	stats.fallbacks = 0;
+
+	const int levels   = image.get_level_count();
+	const float width  = static_cast<float>(image.get_width());
+	const float height = static_cast<float>(image.get_height());
+
+	// Screen pixels per image pixel, the level with the closest texel size is drawn
+	float screen_scale = glm::length(glm::vec2(transform[0][0] * viewport_width * 0.5f, transform[0][1] * viewport_height * 0.5f));
+	int level		   = screen_scale > 0.0f ? static_cast<int>(std::floor(std::log2(1.0f / screen_scale) + 0.5f)) : levels - 1;
+	level			   = std::clamp(level, 0, levels - 1);
+	last_level		   = level;
+
+	// Visible part of the image, the clip space corners taken back to image pixels
+	glm::mat4 inverse = glm::inverse(transform);
+	float min_x		  = std::numeric_limits<float>::max();
+	float min_y		  = std::numeric_limits<float>::max();
+	float max_x		  = std::numeric_limits<float>::lowest();
+	float max_y		  = std::numeric_limits<float>::lowest();
+	for(float corner_x : {-1.0f, 1.0f})
+	{
+		for(float corner_y : {-1.0f, 1.0f})
+		{
+			glm::vec4 p = inverse * glm::vec4(corner_x, corner_y, 0.0f, 1.0f);
+			min_x		= std::min(min_x, p.x / p.w);
+			min_y		= std::min(min_y, p.y / p.w);
+			max_x		= std::max(max_x, p.x / p.w);
+			max_y		= std::max(max_y, p.y / p.w);
+		}
+	}
+	if(max_x <= 0.0f || max_y <= 0.0f || min_x >= width || min_y >= height)
+	{
+		stats.resident = resident.size();
+		return;
+	}
+
+	const tiled_image::level &l = image.get_level(level);
+	float tile_width			= image.get_tile_size() * width / static_cast<float>(l.width);
+	float tile_height			= image.get_tile_size() * height / static_cast<float>(l.height);
+	int first_column			= std::max(0, static_cast<int>(min_x / tile_width));
+	int first_row				= std::max(0, static_cast<int>(min_y / tile_height));
+	int last_column				= std::min(l.columns - 1, static_cast<int>(max_x / tile_width));
+	int last_row				= std::min(l.rows - 1, static_cast<int>(max_y / tile_height));
+
+	// Visible tiles are kept, the missing ones are uploaded closest to the center first
+	wanted.clear();
+	float center_x = (min_x + max_x) * 0.5f;
+	float center_y = (min_y + max_y) * 0.5f;
+	for(int row = first_row; row <= last_row; row++)
+	{
+		for(int column = first_column; column <= last_column; column++)
+		{
+			auto it = resident.find(tile_key(level, column, row));
+			if(it != resident.end())
+			{
+				if(it->second.last_used != pinned)
+				{
+					it->second.last_used = frame;
+				}
+				continue;
+			}
+
+			float dx = (column + 0.5f) * tile_width - center_x;
+			float dy = (row + 0.5f) * tile_height - center_y;
+			wanted.push_back({level, column, row, dx * dx + dy * dy});
+		}
+	}
+	std::sort(wanted.begin(), wanted.end(), [](const wanted_tile &a, const wanted_tile &b) { return a.distance < b.distance; });
+
+	// The tiles of the next frames' uploads are paged in meanwhile
+	const std::size_t uploads = static_cast<std::size_t>(uploads_per_frame);
+	for(std::size_t i = 0; i < wanted.size() && i < uploads * 3; i++)
+	{
+		const wanted_tile &tile = wanted[i];
+		if(i >= uploads)
+		{
+			image.prefetch(tile.level, tile.column, tile.row);
+		}
+		else if(!upload(tile.level, tile.column, tile.row, frame))
+		{
+			// Every layer is visible, this viewport needs a larger cache
+			break;
+		}
+	}
+
+	batch.begin(transform);
+	for(int row = first_row; row <= last_row; row++)
+	{
+		for(int column = first_column; column <= last_column; column++)
+		{
+			float x0 = column * tile_width;
+			float y0 = row * tile_height;
+			float x1 = std::min(width, (column + 1) * tile_width);
+			float y1 = std::min(height, (row + 1) * tile_height);
+
+			// Missing tiles are drawn from the part of a coarser tile covering them
+			int source_level  = level;
+			int source_column = column;
+			int source_row	  = row;
+			auto it			  = resident.find(tile_key(source_level, source_column, source_row));
+			while(it == resident.end() && source_level + 1 < levels)
+			{
+				source_level++;
+				source_column >>= 1;
+				source_row >>= 1;
+				it = resident.find(tile_key(source_level, source_column, source_row));
+			}
+			if(it == resident.end())
+			{
+				continue;
+			}
+
+			if(source_level != level)
+			{
+				stats.fallbacks++;
+				if(it->second.last_used != pinned)
+				{
+					it->second.last_used = frame;
+				}
+			}
+			add_quad(source_level, source_column, source_row, it->second.layer, x0, y0, x1, y1);
+		}
+	}
+	batch.end();
+
+	stats.resident = resident.size();
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#ifndef CORE_TILED_VIEW_H
+#define CORE_TILED_VIEW_H
+
+#include "core/quad_batch.h"
+#include "core/shader_manager.h"
+#include "core/texture_array.h"
+#include "core/tiled_image.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Draws a tiled_image through a GPU tile cache.
+ * Only the tiles visible at the level matching the zoom are made resident, they are paged in
+ * from the mapping ahead of time and uploaded a few per frame into the layers of a texture array.
+ * Tiles that aren't resident yet are drawn from the closest coarser resident tile, the single
+ * tile of the last level is always resident.
+ * The camera only changes the u_MVP of the batch, moving it uploads nothing.
+ */
+class tiled_view
+{
+public:
+	struct statistics
+	{
+		std::size_t uploads	  = 0;
+		std::size_t evictions = 0;
+		std::size_t fallbacks = 0; // tiles of the last frame drawn from a coarser level
+		std::size_t resident  = 0;
+	};
+
+private:
+	struct resident_tile
+	{
+		int layer;
+		std::uint64_t last_used; // frame, pinned tiles are never evicted
+	};
+
+	struct wanted_tile
+	{
+		int level, column, row;
+		float distance; // to the view center, the closest tiles are uploaded first
+	};
+
+	const tiled_image &image;
+	texture_array cache;
+	quad_batch batch;
+
+	std::unordered_map<std::uint64_t, resident_tile> resident;
+	std::vector<int> free_layers;
+	std::vector<wanted_tile> wanted;
+
+	std::uint64_t frame;
+	int uploads_per_frame;
+	int last_level;
+	statistics stats;
+
+	static std::uint64_t tile_key(int level, int column, int row);
+
+	/* Layer for a new tile, the least recently used tile not drawn this frame is evicted. -1 if the cache is full */
+	int acquire_layer();
+	bool upload(int level, int column, int row, std::uint64_t last_used);
+	void add_quad(int level, int column, int row, int layer, float x0, float y0, float x1, float y1);
+
+public:
+	/* cache_tiles - layers of the tile cache, each holds one tile with its border */
+	tiled_view(shader_manager &shaders, const tiled_image &image, int cache_tiles = 256);
+
+	tiled_view(const tiled_view &)			  = delete;
+	tiled_view &operator=(const tiled_view &) = delete;
+
+	/* transform maps level 0 image pixels (top-left origin) to clip space,
+	   the viewport size in pixels selects the level */
+	void draw(const glm::mat4 &transform, int viewport_width, int viewport_height);
+
+	/* Tiles uploaded at most per draw, more uploads fill the view sooner but stall longer */
+	void set_uploads_per_frame(int tiles)
+	{
+		uploads_per_frame = tiles > 0 ? tiles : 1;
+	}
+
+	/* Level of the last draw, 0 is full resolution */
+	int get_level() const
+	{
+		return last_level;
+	}
+	const statistics &get_statistics() const
+	{
+		return stats;
+	}
+};
+
+#endif // CORE_TILED_VIEW_H
\ No newline at end of file
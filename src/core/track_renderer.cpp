@@ -0,0 +1,334 @@
+#include "core/track_renderer.h"
+
+#include "core/gl_state.h"
+#include "core/shader.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	// One instance per segment, 4 vertices expand it into a quad of u_LineWidth pixels
+	const std::string track_vertex_shader = "#version 330 core\n"
+											"\n"
+											"layout(location = 0) in vec4 a_Segment;\n"
+											"layout(location = 1) in vec4 a_Colour;\n"
+											"layout(location = 2) in float a_Birth;\n"
+											"\n"
+											"uniform vec2 u_ImageSize;\n"
+											"uniform float u_LineWidth;\n"
+											"uniform float u_Frame;\n"
+											"uniform float u_TrailLength;\n"
+											"\n"
+											"out vec4 v_Colour;\n"
+											"\n"
+											"void main() {\n"
+											"	float fade = u_TrailLength > 0.0 ? 1.0 - (u_Frame - a_Birth) / u_TrailLength : 1.0;\n"
+											"	vec2 a = a_Segment.xy;\n"
+											"	vec2 b = a_Segment.zw;\n"
+											"	vec2 direction = b - a;\n"
+											"	float len = length(direction);\n"
+											"	vec2 normal = len > 0.0 ? vec2(-direction.y, direction.x) / len : vec2(0.0, 1.0);\n"
+											"	float side = (gl_VertexID & 1) == 0 ? -0.5 : 0.5;\n"
+											"	vec2 p = (gl_VertexID < 2 ? a : b) + normal * u_LineWidth * side;\n"
+											"	v_Colour = vec4(a_Colour.rgb, a_Colour.a * fade);\n"
+											"	vec2 ndc = vec2(p.x / u_ImageSize.x * 2.0 - 1.0, 1.0 - p.y / u_ImageSize.y * 2.0);\n"
+											"	// Faded out segments are moved outside of the clip volume\n"
+											"	gl_Position = fade > 0.0 ? vec4(ndc, 0.0, 1.0) : vec4(2.0, 2.0, 2.0, 1.0);\n"
+											"}\n";
+
+	const std::string track_fragment_shader = "#version 330 core\n"
+											  "\n"
+											  "layout(location = 0) out vec4 color;\n"
+											  "\n"
+											  "in vec4 v_Colour;\n"
+											  "\n"
+											  "void main()\n"
+											  "{\n"
+											  "	color = v_Colour;\n"
+											  "}\n";
+
+	// One instance per marker, the circle is cut out of the quad in the fragment shader
+	const std::string marker_vertex_shader = "#version 330 core\n"
+											 "\n"
+											 "layout(location = 0) in vec4 a_Marker;\n"
+											 "layout(location = 1) in vec4 a_Colour;\n"
+											 "\n"
+											 "uniform vec2 u_ImageSize;\n"
+											 "\n"
+											 "out vec4 v_Colour;\n"
+											 "out vec2 v_Offset;\n"
+											 "flat out vec2 v_Shape;\n"
+											 "\n"
+											 "void main() {\n"
+											 "	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;\n"
+											 "	float extent = a_Marker.z + max(a_Marker.w, 0.0) * 0.5 + 1.0;\n"
+											 "	v_Offset = corner * extent;\n"
+											 "	v_Shape = a_Marker.zw;\n"
+											 "	v_Colour = a_Colour;\n"
+											 "	vec2 p = a_Marker.xy + v_Offset;\n"
+											 "	gl_Position = vec4(p.x / u_ImageSize.x * 2.0 - 1.0, 1.0 - p.y / u_ImageSize.y * 2.0, 0.0, 1.0);\n"
+											 "}\n";
+
+	const std::string marker_fragment_shader = "#version 330 core\n"
+											   "\n"
+											   "layout(location = 0) out vec4 color;\n"
+											   "\n"
+											   "in vec4 v_Colour;\n"
+											   "in vec2 v_Offset;\n"
+											   "flat in vec2 v_Shape;\n"
+											   "\n"
+											   "void main()\n"
+											   "{\n"
+											   "	float d = length(v_Offset);\n"
+											   "	// v_Shape.x - radius, v_Shape.y - thickness, negative is filled\n"
+											   "	float distance = v_Shape.y < 0.0 ? d - v_Shape.x : abs(d - v_Shape.x) - v_Shape.y * 0.5;\n"
+											   "	float coverage = clamp(0.5 - distance, 0.0, 1.0);\n"
+											   "	if(coverage <= 0.0)\n"
+											   "		discard;\n"
+											   "	color = vec4(v_Colour.rgb, v_Colour.a * coverage);\n"
+											   "}\n";
+
+	void pack_colour(const cv::Scalar &colour, std::uint8_t *packed)
+	{
+		// cv::Scalar colours are BGR
+		packed[0] = cv::saturate_cast<std::uint8_t>(colour[2]);
+		packed[1] = cv::saturate_cast<std::uint8_t>(colour[1]);
+		packed[2] = cv::saturate_cast<std::uint8_t>(colour[0]);
+		packed[3] = 255;
+	}
+
+	constexpr std::uint64_t u_image_size   = name_hash("u_ImageSize");
+	constexpr std::uint64_t u_line_width   = name_hash("u_LineWidth");
+	constexpr std::uint64_t u_frame		   = name_hash("u_Frame");
+	constexpr std::uint64_t u_trail_length = name_hash("u_TrailLength");
+} // namespace
+
+track_renderer::track_renderer(shader_manager &shaders, std::size_t capacity)
+	: track_program(shaders.get_program("track_renderer.tracks", track_vertex_shader, track_fragment_shader)),
+	  marker_program(shaders.get_program("track_renderer.markers", marker_vertex_shader, marker_fragment_shader)),
+	  capacity(capacity),
+	  head(0),
+	  used(0),
+	  written(0),
+	  markers_dirty(false),
+	  image_width(1.0f),
+	  image_height(1.0f),
+	  line_width(2.0f),
+	  trail_length(0),
+	  frame(0)
+{
+	if(capacity == 0)
+	{
+		throw std::runtime_error("Track ring buffer capacity can't be zero");
+	}
+
+	// Segment ring buffer
+	glGenVertexArrays(1, &track_vao);
+	gl_state::get().bind_vertex_array(track_vao);
+	glGenBuffers(1, &segment_buffer);
+	gl_state::get().bind_buffer(GL_ARRAY_BUFFER, segment_buffer);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(segment), nullptr, GL_DYNAMIC_DRAW);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(segment), (void *)offsetof(segment, x0));
+	glVertexAttribDivisor(0, 1);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(segment), (void *)offsetof(segment, colour));
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(segment), (void *)offsetof(segment, birth));
+	glVertexAttribDivisor(2, 1);
+
+	// Per-frame markers
+	glGenVertexArrays(1, &marker_vao);
+	gl_state::get().bind_vertex_array(marker_vao);
+	glGenBuffers(1, &marker_buffer);
+	gl_state::get().bind_buffer(GL_ARRAY_BUFFER, marker_buffer);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(marker), (void *)offsetof(marker, x));
+	glVertexAttribDivisor(0, 1);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(marker), (void *)offsetof(marker, colour));
+	glVertexAttribDivisor(1, 1);
+}
+
+track_renderer::~track_renderer()
+{
+	gl_state &state = gl_state::get();
+	state.forget_buffer(segment_buffer);
+	state.forget_buffer(marker_buffer);
+	state.forget_vertex_array(track_vao);
+	state.forget_vertex_array(marker_vao);
+	glDeleteBuffers(1, &segment_buffer);
+	glDeleteBuffers(1, &marker_buffer);
+	glDeleteVertexArrays(1, &track_vao);
+	glDeleteVertexArrays(1, &marker_vao);
+}
+
+void track_renderer::set_image_size(int width, int height)
+{
+	image_width	 = static_cast<float>(width);
+	image_height = static_cast<float>(height);
+}
+
+void track_renderer::next_frame()
+{
+	frame++;
+	markers.clear();
+	markers_dirty = true;
+}
+
+void track_renderer::add_segment(const cv::Point2f &from, const cv::Point2f &to, const cv::Scalar &colour)
+{
+	segment s;
+	s.x0 = from.x;
+	s.y0 = from.y;
+	s.x1 = to.x;
+	s.y1 = to.y;
+	pack_colour(colour, s.colour);
+	s.birth = static_cast<float>(frame);
+	if(frame_starts.empty() || frame_starts.back().frame != frame)
+	{
+		frame_starts.push_back(frame_start {frame, written + pending.size()});
+	}
+	pending.push_back(s);
+}
+
+void track_renderer::add_marker(const cv::Point2f &center, float radius, float thickness, const cv::Scalar &colour)
+{
+	marker m;
+	m.x			= center.x;
+	m.y			= center.y;
+	m.radius	= radius;
+	m.thickness = thickness;
+	pack_colour(colour, m.colour);
+	markers.push_back(m);
+	markers_dirty = true;
+}
+
+void track_renderer::clear()
+{
+	head	= 0;
+	used	= 0;
+	written = 0;
+	pending.clear();
+	frame_starts.clear();
+}
+
+void track_renderer::flush()
+{
+	if(pending.empty())
+	{
+		return;
+	}
+
+	gl_state::get().bind_buffer(GL_ARRAY_BUFFER, segment_buffer);
+
+	// More than a whole ring at once, only the newest segments survive anyway
+	std::size_t offset = pending.size() > capacity ? pending.size() - capacity : 0;
+	head			   = (head + offset) % capacity;
+	written += offset;
+	while(offset < pending.size())
+	{
+		std::size_t count = std::min(pending.size() - offset, capacity - head);
+		glBufferSubData(GL_ARRAY_BUFFER, head * sizeof(segment), count * sizeof(segment), pending.data() + offset);
+		head = (head + count) % capacity;
+		used = std::min(used + count, capacity);
+		written += count;
+		offset += count;
+	}
+
+	pending.clear();
+
+	// Frames whose segments were all overwritten
+	while(frame_starts.size() > 1 && frame_starts[1].first <= written - used)
+	{
+		frame_starts.pop_front();
+	}
+}
+
+void track_renderer::draw_tracks()
+{
+	flush();
+
+	// Segments of frames past the trail are faded out completely, the ring is drawn from the
+	// first frame still visible on
+	std::size_t first = written - used;
+	if(trail_length > 0)
+	{
+		auto visible = std::partition_point(
+			frame_starts.begin(),
+			frame_starts.end(),
+			[this](const frame_start &start) { return frame - start.frame >= trail_length; });
+		first		 = std::max(first, visible == frame_starts.end() ? written : visible->first);
+	}
+	std::size_t count = written - first;
+	if(count == 0)
+	{
+		return;
+	}
+
+	// Saturating add like cv::add of the old track mask
+	gl_state::get().set_enabled(GL_BLEND, true);
+	gl_state::get().blend_func(GL_SRC_ALPHA, GL_ONE);
+
+	track_program.set(u_image_size, image_width, image_height);
+	track_program.set(u_line_width, line_width);
+	track_program.set(u_frame, static_cast<float>(frame));
+	track_program.set(u_trail_length, static_cast<float>(trail_length));
+	track_program.use();
+
+	// A range that wraps around the end of the ring is drawn in two parts
+	gl_state::get().bind_vertex_array(track_vao);
+	gl_state::get().bind_buffer(GL_ARRAY_BUFFER, segment_buffer);
+	std::size_t start = first % capacity;
+	std::size_t tail  = std::min(count, capacity - start);
+	draw_range(start, tail);
+	if(tail < count)
+	{
+		draw_range(0, count - tail);
+	}
+
+	gl_state::get().set_enabled(GL_BLEND, false);
+}
+
+void track_renderer::draw_range(std::size_t first, std::size_t count)
+{
+	// GL 3.3 has no base instance, the attributes are pointed at the range instead
+	std::size_t offset = first * sizeof(segment);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(segment), (void *)(offset + offsetof(segment, x0)));
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(segment), (void *)(offset + offsetof(segment, colour)));
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(segment), (void *)(offset + offsetof(segment, birth)));
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+}
+
+void track_renderer::draw_markers()
+{
+	if(markers.empty())
+	{
+		return;
+	}
+
+	gl_state::get().set_enabled(GL_BLEND, true);
+	gl_state::get().blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	if(markers_dirty)
+	{
+		// Orphan the buffer, the previous frame's markers may still be in use by the GPU
+		gl_state::get().bind_buffer(GL_ARRAY_BUFFER, marker_buffer);
+		glBufferData(GL_ARRAY_BUFFER, markers.size() * sizeof(marker), markers.data(), GL_STREAM_DRAW);
+		markers_dirty = false;
+	}
+
+	marker_program.set(u_image_size, image_width, image_height);
+	marker_program.use();
+
+	gl_state::get().bind_vertex_array(marker_vao);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(markers.size()));
+
+	gl_state::get().set_enabled(GL_BLEND, false);
+}
\ No newline at end of file
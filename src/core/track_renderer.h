@@ -0,0 +1,115 @@
+#ifndef CORE_TRACK_RENDERER_H
+#define CORE_TRACK_RENDERER_H
+
+// clang-format off
+#include <GL/glew.h>
+#include <GL/gl.h>
+// clang-format on
+
+#include "core/shader_manager.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <opencv2/core.hpp>
+#include <vector>
+
+/*
+ * Instanced drawing of tracks, trails and objects.
+ * Track history lives in a GPU ring buffer of line segments, each segment remembers the
+ * frame it was added in and the vertex shader fades it out over the trail length. Only the
+ * part of the ring written in the last trail length frames is drawn.
+ * Markers (points, circles) are uploaded once per frame and drawn as instanced quads.
+ * Coordinates are in image pixels, the image is mapped onto the current viewport.
+ */
+class track_renderer
+{
+private:
+	struct segment
+	{
+		float x0, y0, x1, y1;
+		std::uint8_t colour[4];
+		float birth;
+	};
+
+	struct marker
+	{
+		float x, y, radius, thickness;
+		std::uint8_t colour[4];
+	};
+
+	shader_program &track_program;
+	shader_program &marker_program;
+	GLuint track_vao, marker_vao;
+	GLuint segment_buffer, marker_buffer;
+
+	struct frame_start
+	{
+		unsigned int frame;
+		std::size_t first; // segments added before the frame's first one, ever
+	};
+
+	std::size_t capacity;
+	std::size_t head;
+	std::size_t used;
+	std::size_t written; // segments ever added to the ring, head is written % capacity
+	std::deque<frame_start> frame_starts; // frames with segments still in the ring, oldest first
+	std::vector<segment> pending;
+	std::vector<marker> markers;
+	bool markers_dirty;
+
+	float image_width, image_height;
+	float line_width;
+	unsigned int trail_length;
+	unsigned int frame;
+
+	void flush();
+
+	/* Draw count segments from ring position first on, the range must not wrap */
+	void draw_range(std::size_t first, std::size_t count);
+
+public:
+	/* capacity - number of segments kept in the GPU ring buffer */
+	track_renderer(shader_manager &shaders, std::size_t capacity = 1 << 20);
+	~track_renderer();
+
+	track_renderer(const track_renderer &)			  = delete;
+	track_renderer &operator=(const track_renderer &) = delete;
+
+	/* Size of the image the coordinates refer to */
+	void set_image_size(int width, int height);
+
+	/* Segments older than this many frames are faded out completely, 0 - keep them forever */
+	void set_trail_length(unsigned int frames)
+	{
+		trail_length = frames;
+	}
+
+	/* Track width in pixels */
+	void set_line_width(float width)
+	{
+		line_width = width;
+	}
+
+	/* Advance the frame counter used for fading and drop the markers of the previous frame */
+	void next_frame();
+
+	/* Append a track segment, colour is BGR like cv::line */
+	void add_segment(const cv::Point2f &from, const cv::Point2f &to, const cv::Scalar &colour);
+
+	/* Add a marker for this frame, thickness < 0 draws a filled circle like cv::circle */
+	void add_marker(const cv::Point2f &center, float radius, float thickness, const cv::Scalar &colour);
+
+	/* Forget all track history */
+	void clear();
+
+	void draw_tracks();
+	void draw_markers();
+
+	std::size_t get_segment_count() const
+	{
+		return used + pending.size();
+	}
+};
+
+#endif // CORE_TRACK_RENDERER_H
\ No newline at end of file
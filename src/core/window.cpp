@@ -0,0 +1,375 @@
+#include "core/window.h"
+
+#include <cstddef>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	// SDL is shared by every window and presenter of the process, it is shut down with the last one
+	std::mutex sdl_mutex;
+	std::size_t sdl_users = 0;
+
+	void acquire_sdl()
+	{
+		std::lock_guard<std::mutex> lock(sdl_mutex);
+		if(sdl_users == 0 && SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0)
+		{
+			throw std::runtime_error(std::string("SDL initialization error: ") + SDL_GetError());
+		}
+		sdl_users++;
+	}
+
+	void release_sdl()
+	{
+		std::lock_guard<std::mutex> lock(sdl_mutex);
+		if(--sdl_users == 0)
+		{
+			SDL_Quit();
+		}
+	}
+} // namespace
+
+#ifdef LYSSA_HAS_EGL
+	#include <EGL/egl.h>
+	#include <EGL/eglext.h>
+	#include <cstdio>
+	#include <cstring>
+
+namespace
+{
+	std::string egl_error()
+	{
+		char code[16];
+		std::snprintf(code, sizeof(code), "0x%04X", static_cast<unsigned int>(eglGetError()));
+		return code;
+	}
+
+	bool has_extension(const char *extensions, const char *name)
+	{
+		return extensions && std::strstr(extensions, name) != nullptr;
+	}
+} // namespace
+#endif
+
+window::window(const std::string &title, int width, int height, mode kind)
+	: kind(kind),
+	  sdl_window(nullptr),
+	  context(nullptr),
+	  egl_display(nullptr),
+	  egl_context(nullptr),
+	  egl_surface(nullptr),
+	  framebuffer(0),
+	  colour_buffer(0),
+	  depth_buffer(0),
+	  glsl_version("#version 330"),
+	  width(width),
+	  height(height)
+{
+	if(kind == mode::headless)
+	{
+		create_headless_context();
+
+		// Enable glew experimental, this enables some more OpenGL extensions.
+		glewExperimental = GL_TRUE;
+		GLenum glew_status = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+		// A GLX build of GLEW fails on the missing X display after the GL entry points are loaded
+		if(glew_status == GLEW_ERROR_NO_GLX_DISPLAY)
+		{
+			glew_status = GLEW_OK;
+		}
+#endif
+		if(glew_status != GLEW_OK)
+		{
+			destroy_headless_context();
+			throw std::runtime_error("Failed to initialize GLEW");
+		}
+
+		try
+		{
+			create_framebuffer();
+		}
+		catch(...)
+		{
+			destroy_headless_context();
+			throw;
+		}
+	}
+	else
+	{
+		acquire_sdl();
+
+		// Decide GL+GLSL versions
+#if defined(IMGUI_IMPL_OPENGL_ES2)
+		// GL ES 2.0 + GLSL 100
+		glsl_version = "#version 100";
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
+#elif defined(__APPLE__)
+		// GL 3.2 Core + GLSL 150
+		glsl_version = "#version 150";
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG); // Always required on Mac
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+#else
+		// GL 3.0 + GLSL 130
+		glsl_version = "#version 130";
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
+#endif
+
+		sdl_window = SDL_CreateWindow(title.c_str(), 0, 0, width, height, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
+
+		if(!sdl_window)
+		{
+			std::string _error = std::string("Window creation error: ") + SDL_GetError();
+			release_sdl();
+			throw std::runtime_error(_error);
+		}
+
+		context = SDL_GL_CreateContext(sdl_window);
+
+		if(!context)
+		{
+			std::string _error = std::string("OpenGL context creation error: ") + SDL_GetError();
+			SDL_DestroyWindow(sdl_window);
+			release_sdl();
+			throw std::runtime_error(_error);
+		}
+
+		// Enable glew experimental, this enables some more OpenGL extensions.
+		glewExperimental = GL_TRUE;
+		if(glewInit() != GLEW_OK)
+		{
+			SDL_GL_DeleteContext(context);
+			SDL_DestroyWindow(sdl_window);
+			release_sdl();
+			throw std::runtime_error("Failed to initialize GLEW");
+		}
+	}
+
+	std::string shader_cache;
+	if(char *preferences = SDL_GetPrefPath("lyssa", "shader_cache"))
+	{
+		shader_cache = preferences;
+		SDL_free(preferences);
+	}
+	shaders = std::make_unique<shader_manager>(shader_cache);
+}
+
+window::~window()
+{
+	// Programs go before the context they belong to
+	shaders.reset();
+	if(kind == mode::headless)
+	{
+		destroy_headless_context();
+		return;
+	}
+
+	SDL_GL_DeleteContext(context);
+	SDL_DestroyWindow(sdl_window);
+	release_sdl();
+}
+
+void window::swap() const
+{
+	if(kind == mode::headless)
+	{
+		glFlush();
+		return;
+	}
+	SDL_GL_SwapWindow(sdl_window);
+}
+
+void window::read_pixels(cv::Mat &frame) const
+{
+	int drawable_width, drawable_height;
+	get_drawable_size(drawable_width, drawable_height);
+	frame.create(drawable_height, drawable_width, CV_8UC3);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	gl_state::get().bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, drawable_width, drawable_height, GL_BGR, GL_UNSIGNED_BYTE, frame.data);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	// GL rows start at the bottom
+	cv::flip(frame, frame, 0);
+}
+
+void window::get_drawable_size(int &drawable_width, int &drawable_height) const
+{
+	if(kind == mode::headless)
+	{
+		drawable_width	= width;
+		drawable_height = height;
+		return;
+	}
+	SDL_GL_GetDrawableSize(sdl_window, &drawable_width, &drawable_height);
+}
+
+void window::create_headless_context()
+{
+#ifdef LYSSA_HAS_EGL
+	// The surfaceless platform needs no display server at all, a default display is the fallback
+	EGLDisplay display = EGL_NO_DISPLAY;
+	auto get_platform_display =
+		reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	if(get_platform_display && has_extension(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS), "EGL_MESA_platform_surfaceless"))
+	{
+		display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	}
+	if(display == EGL_NO_DISPLAY)
+	{
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+	EGLint major, minor;
+	if(display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		throw std::runtime_error("EGL initialization error: " + egl_error());
+	}
+	egl_display = display;
+
+	if(!eglBindAPI(EGL_OPENGL_API))
+	{
+		std::string _error = "EGL has no desktop OpenGL: " + egl_error();
+		destroy_headless_context();
+		throw std::runtime_error(_error);
+	}
+
+	// Surfaceless configs may not offer pbuffers, those are only needed without EGL_KHR_surfaceless_context
+	const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+	const bool surfaceless = has_extension(extensions, "EGL_KHR_surfaceless_context");
+
+	const EGLint config_attributes[] = {
+		EGL_SURFACE_TYPE,
+		surfaceless ? EGL_DONT_CARE : EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE,
+		EGL_OPENGL_BIT,
+		EGL_RED_SIZE,
+		8,
+		EGL_GREEN_SIZE,
+		8,
+		EGL_BLUE_SIZE,
+		8,
+		EGL_NONE};
+	EGLConfig config;
+	EGLint config_count = 0;
+	if(!eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count == 0)
+	{
+		std::string _error = "No EGL config for OpenGL: " + egl_error();
+		destroy_headless_context();
+		throw std::runtime_error(_error);
+	}
+
+	const EGLint context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION,
+		3,
+		EGL_CONTEXT_MINOR_VERSION,
+		3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK,
+		EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE};
+	egl_context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+	if(egl_context == EGL_NO_CONTEXT)
+	{
+		std::string _error = "EGL context creation error: " + egl_error();
+		destroy_headless_context();
+		throw std::runtime_error(_error);
+	}
+
+	if(!surfaceless)
+	{
+		const EGLint pbuffer_attributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+		egl_surface						  = eglCreatePbufferSurface(display, config, pbuffer_attributes);
+		if(egl_surface == EGL_NO_SURFACE)
+		{
+			std::string _error = "EGL pbuffer creation error: " + egl_error();
+			destroy_headless_context();
+			throw std::runtime_error(_error);
+		}
+	}
+
+	if(!eglMakeCurrent(display, egl_surface, egl_surface, egl_context))
+	{
+		std::string _error = "Can't make the EGL context current: " + egl_error();
+		destroy_headless_context();
+		throw std::runtime_error(_error);
+	}
+#else
+	throw std::runtime_error("Headless rendering needs a build with EGL");
+#endif
+}
+
+void window::create_framebuffer()
+{
+	glGenRenderbuffers(1, &colour_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colour_buffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &depth_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour_buffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		throw std::runtime_error("Headless framebuffer is incomplete: " + std::to_string(status));
+	}
+
+	gl_state::get().set_default_framebuffer(framebuffer);
+	// Without a surface the initial viewport is empty
+	gl_state::get().viewport(0, 0, width, height);
+}
+
+void window::destroy_headless_context()
+{
+#ifdef LYSSA_HAS_EGL
+	EGLDisplay display = static_cast<EGLDisplay>(egl_display);
+	if(display == EGL_NO_DISPLAY)
+	{
+		return;
+	}
+
+	if(framebuffer != 0 || colour_buffer != 0 || depth_buffer != 0)
+	{
+		gl_state::get().set_default_framebuffer(0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteRenderbuffers(1, &colour_buffer);
+		glDeleteRenderbuffers(1, &depth_buffer);
+		framebuffer	  = 0;
+		colour_buffer = 0;
+		depth_buffer  = 0;
+	}
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if(egl_surface)
+	{
+		eglDestroySurface(display, static_cast<EGLSurface>(egl_surface));
+	}
+	if(egl_context)
+	{
+		eglDestroyContext(display, static_cast<EGLContext>(egl_context));
+	}
+	eglTerminate(display);
+
+	egl_display = nullptr;
+	egl_context = nullptr;
+	egl_surface = nullptr;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#ifndef CORE_WINDOW_H
+#define CORE_WINDOW_H
+
+// clang-format off
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+#include <GL/gl.h>
+// clang-format on
+
+#include "core/shader_manager.h"
+
+#include <memory>
+#include <opencv2/core.hpp>
+#include <string>
+
+/*
+ * SDL2 window with an OpenGL context and GLEW loaded.
+ * A headless window has no SDL window at all: an EGL context without a surface (Mesa
+ * surfaceless platform, llvmpipe included, or a 1x1 pbuffer) renders into a framebuffer
+ * object of the window size, which gl_state knows as the default framebuffer.
+ * The shader manager of the context caches program binaries in the SDL preferences directory.
+ * Throws std::runtime_error if any part of the initialization fails.
+ */
+class window
+{
+public:
+	enum class mode
+	{
+		visible,
+		headless // needs a build with EGL (LYSSA_HAS_EGL)
+	};
+
+private:
+	mode kind;
+	SDL_Window *sdl_window;
+	SDL_GLContext context;
+	// EGLDisplay, EGLContext and EGLSurface of a headless window
+	void *egl_display;
+	void *egl_context;
+	void *egl_surface;
+	GLuint framebuffer, colour_buffer, depth_buffer;
+	const char *glsl_version;
+	int width, height;
+	std::unique_ptr<shader_manager> shaders;
+
+	void create_headless_context();
+	void create_framebuffer();
+	void destroy_headless_context();
+
+public:
+	window(const std::string &title, int width, int height, mode kind = mode::visible);
+	~window();
+
+	window(const window &)			  = delete;
+	window &operator=(const window &) = delete;
+
+	/* Present the frame, a headless window only flushes the queued commands */
+	void swap() const;
+
+	/* Copy of the rendered frame as BGR with row 0 at the top, call before swap() */
+	void read_pixels(cv::Mat &frame) const;
+
+	/* Size in pixels of what is rendered to, may differ from the window size on high DPI displays */
+	void get_drawable_size(int &drawable_width, int &drawable_height) const;
+
+	bool is_headless() const
+	{
+		return kind == mode::headless;
+	}
+
+	/* nullptr for a headless window */
+	SDL_Window *get_sdl_window() const
+	{
+		return sdl_window;
+	}
+	SDL_GLContext get_context() const
+	{
+		return context;
+	}
+	const char *get_glsl_version() const
+	{
+		return glsl_version;
+	}
+	int get_width() const
+	{
+		return width;
+	}
+	int get_height() const
+	{
+		return height;
+	}
+	shader_manager &get_shaders() const
+	{
+		return *shaders;
+	}
+};
+
+#endif // CORE_WINDOW_H
\ No newline at end of file
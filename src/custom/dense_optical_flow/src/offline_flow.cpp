@@ -0,0 +1,130 @@
+#include "offline_flow.h"
+
+#include "core/flow_runner.h"
+#include "core/parallel_runtime.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	void print_usage()
+	{
+		spdlog::info("Usage: dense_optical_flow [-i <video> [options]]");
+		spdlog::info("  without options the camera's flow is shown live");
+		spdlog::info("  -i, --input <video>       compute the flow of every frame pair of the video offline");
+		spdlog::info("  -o, --output <video>      write the flow visualization to a video (.avi, .mp4, .mkv)");
+		spdlog::info("  -a, --archive <dir>       write the flow fields to <dir>/flow_000000.flo and on");
+		spdlog::info("  -m, --method <name>       farneback or dis, default farneback");
+		spdlog::info("  -j, --jobs <count>        frame pairs in flight, default twice the threads");
+		spdlog::info("  -s, --scale <pixels>      flow magnitude shown at full brightness, default 16");
+	}
+
+	flow_runner::options parse_options(int argc, char *argv[])
+	{
+		flow_runner::options result;
+		for(int i = 1; i < argc; i++)
+		{
+			std::string argument = argv[i];
+			if((argument == "-i" || argument == "--input") && i + 1 < argc)
+			{
+				result.input = argv[++i];
+			}
+			else if((argument == "-o" || argument == "--output") && i + 1 < argc)
+			{
+				result.video = argv[++i];
+			}
+			else if((argument == "-a" || argument == "--archive") && i + 1 < argc)
+			{
+				result.archive = argv[++i];
+			}
+			else if((argument == "-m" || argument == "--method") && i + 1 < argc)
+			{
+				std::string method = argv[++i];
+				if(method == "farneback")
+				{
+					result.method = flow_runner::method::farneback;
+				}
+				else if(method == "dis")
+				{
+					result.method = flow_runner::method::dis;
+				}
+				else
+				{
+					print_usage();
+					throw std::runtime_error("Unknown method " + method);
+				}
+			}
+			else if((argument == "-j" || argument == "--jobs") && i + 1 < argc)
+			{
+				result.pairs_in_flight = static_cast<std::size_t>(std::max(1, std::stoi(argv[++i])));
+			}
+			else if((argument == "-s" || argument == "--scale") && i + 1 < argc)
+			{
+				result.max_magnitude = std::max(0.01f, std::stof(argv[++i]));
+			}
+			else
+			{
+				print_usage();
+				throw std::runtime_error("Unknown option " + argument);
+			}
+		}
+
+		if(result.input.empty())
+		{
+			print_usage();
+			throw std::runtime_error("No input video");
+		}
+		if(result.video.empty() && result.archive.empty())
+		{
+			print_usage();
+			throw std::runtime_error("Nothing to write, give --output and/or --archive");
+		}
+		return result;
+	}
+} // namespace
+
+int run_offline(int argc, char *argv[])
+{
+	try
+	{
+		flow_runner::options settings = parse_options(argc, argv);
+
+		/* The pairs are the parallelism, each one keeps OpenCV's loops on its own worker */
+		thread_pool pool;
+		parallel_runtime runtime(pool, 1);
+		flow_runner runner(pool);
+
+		flow_runner::result result = runner.run(settings);
+		spdlog::info(
+			"{}: {}x{}, {} pairs in {:.1f} s, {:.1f} pairs/s on {} threads, {} tasks stolen",
+			settings.input,
+			result.width,
+			result.height,
+			result.pairs,
+			result.seconds,
+			result.pairs / result.seconds,
+			pool.get_thread_count(),
+			pool.get_steal_count());
+		if(!settings.video.empty())
+		{
+			spdlog::info("Visualization written to {}", settings.video);
+		}
+		if(!settings.archive.empty())
+		{
+			spdlog::info("Flow fields written to {}", settings.archive);
+		}
+	}
+	catch(const std::exception &e)
+	{
+		spdlog::error("Error: {}", e.what());
+		return -1;
+	}
+
+	return 0;
+}
\ No newline at end of file
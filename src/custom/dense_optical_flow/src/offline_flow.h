@@ -0,0 +1,12 @@
+#ifndef OFFLINE_FLOW_H
+#define OFFLINE_FLOW_H
+
+/*
+ * Dense flow of a whole video file, as fast as the machine allows instead of at camera rate.
+ * The frame pairs are spread over every core by core/flow_runner, a bounded number of them in
+ * flight, and written in frame order to a directory of .flo files and/or a visualization video.
+ * Returns the process exit code.
+ */
+int run_offline(int argc, char *argv[]);
+
+#endif // OFFLINE_FLOW_H
\ No newline at end of file
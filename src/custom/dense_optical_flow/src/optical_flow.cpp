@@ -1,14 +1,33 @@
+#include "offline_flow.h"
+
+#include "core/contact_sheet.h"
+#include "core/flow_view.h"
+#include "core/frame_recorder.h"
+#include "core/parallel_runtime.h"
+#include "core/presenter.h"
+#include "core/task_graph.h"
+
+#include <atomic>
+#include <exception>
 #include <iostream>
+#include <memory>
 #include <opencv2/core.hpp>
-#include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/video.hpp>
 #include <opencv2/videoio.hpp>
+#include <spdlog/spdlog.h>
+#include <vector>
 
 using namespace cv;
 using namespace std;
-int main()
+int main(int argc, char *argv[])
 {
+	/* Given a video file, the flow of all its frames is computed offline, see offline_flow.h */
+	if(argc > 1)
+	{
+		return run_offline(argc, argv);
+	}
+
 	// VideoCapture capture(samples::findFile("vtest.avi"));
 	/* Default video capture device */
 	cv::VideoCapture capture(0);
@@ -20,35 +39,210 @@ int main()
 	}
 	Mat frame1, prvs;
 	capture >> frame1;
+	if(frame1.empty())
+	{
+		cerr << "Unable to read the first frame!" << endl;
+		return 0;
+	}
 	cvtColor(frame1, prvs, COLOR_BGR2GRAY);
-	while(true)
+
+	try
+	{
+		/* Farneback's loops run on one pool instead of on OpenCV's and OpenMP's threads each */
+		thread_pool pool;
+		parallel_runtime runtime(pool);
+
+		/* Camera and flow are tiled in one window */
+		presenter display("Dense optical flow", 2, 1, frame1.cols, frame1.rows);
+		/* The colourization is done in the fragment shader, see core/flow_view */
+		flow_view view(display.get_window().get_shaders());
+
+		/* g shows the frames and flow fields since it was pressed as contact sheets instead of the live views */
+		const int thumbnail_width  = 160;
+		const int thumbnail_height = thumbnail_width * frame1.rows / frame1.cols;
+		const int sheet_columns	   = 12;
+		contact_sheet frames(thumbnail_width, thumbnail_height, 256);
+		contact_sheet flows(thumbnail_width, thumbnail_height, 256, texture_array::content::flow);
+		quad_batch batch(display.get_window().get_shaders());
+		bool show_sheets = false;
+
+		/* r records the window and, next to it, the camera frames as they came from OpenCV */
+		const double camera_fps = capture.get(CAP_PROP_FPS) > 0.0 ? capture.get(CAP_PROP_FPS) : 30.0;
+		std::unique_ptr<frame_recorder> camera_recorder;
+
+		/* decode -> gray -> flow -> present per frame, frame N + 1 is decoded and converted while
+		   frame N is still in Farneback. Camera and window stages run in frame order */
+		struct frame_data
+		{
+			Mat frame, gray, flow;
+			bool valid = false;
+		};
+		std::vector<frame_data> slots;
+		std::atomic<bool> running(true);
+		bool toggle_deterministic = false;
+		task_graph graph(pool, 3);
+
+		task_graph::node decode = graph.add(
+			"decode",
+			[&](std::uint64_t, std::size_t slot)
+			{
+				frame_data &data = slots[slot];
+				capture >> data.frame;
+				data.valid = !data.frame.empty();
+				if(!data.valid)
+				{
+					running = false;
+				}
+			});
+		task_graph::node gray = graph.add(
+			"gray",
+			[&](std::uint64_t, std::size_t slot)
+			{
+				frame_data &data = slots[slot];
+				if(data.valid)
+				{
+					cvtColor(data.frame, data.gray, COLOR_BGR2GRAY);
+				}
+				else
+				{
+					// The slot's image is frames old, the next frame's flow must not use it
+					data.gray.release();
+				}
+			});
+		task_graph::node dense = graph.add(
+			"flow",
+			[&](std::uint64_t frame, std::size_t slot)
+			{
+				frame_data &data		 = slots[slot];
+				const Mat &previous_gray = frame == 0 ? prvs : slots[graph.get_slot(frame - 1)].gray;
+				if(data.valid && !previous_gray.empty())
+				{
+					calcOpticalFlowFarneback(previous_gray, data.gray, data.flow, 0.5, 3, 15, 3, 5, 1.2, 0);
+				}
+				else
+				{
+					data.valid = false;
+				}
+			});
+		task_graph::node present = graph.add(
+			"present",
+			[&](std::uint64_t, std::size_t slot)
+			{
+				frame_data &data = slots[slot];
+				if(!data.valid)
+				{
+					return;
+				}
+				if(camera_recorder)
+				{
+					camera_recorder->push(data.frame);
+				}
+
+				// visualization
+				if(show_sheets)
+				{
+					// Thumbnails are only made while the sheets are shown
+					frames.push(data.frame);
+					flows.push(data.flow);
+					batch.set_max_magnitude(view.get_max_magnitude());
+					display.select(0);
+					batch.begin(frame1.cols, frame1.rows);
+					frames.layout(batch, 0.0f, 0.0f, frame1.cols, frame1.rows, sheet_columns);
+					batch.end();
+					display.select(1);
+					batch.begin(frame1.cols, frame1.rows);
+					flows.layout(batch, 0.0f, 0.0f, frame1.cols, frame1.rows, sheet_columns);
+					batch.end();
+				}
+				else
+				{
+					display.show(0, data.frame);
+					view.upload(data.flow);
+					display.select(1);
+					view.draw();
+				}
+				display.present();
+
+				for(SDL_Keycode key : display.poll())
+				{
+					switch(key)
+					{
+						case SDLK_q:
+							running = false;
+							break;
+						/* Rescale and recolour without touching the flow field */
+						case SDLK_PLUS:
+						case SDLK_EQUALS:
+							view.set_max_magnitude(view.get_max_magnitude() * 0.5f);
+							break;
+						case SDLK_MINUS:
+							view.set_max_magnitude(view.get_max_magnitude() * 2.0f);
+							break;
+						case SDLK_c:
+							view.set_colour_map(
+								view.get_colour_map() == flow_view::colour_map::hsv ? flow_view::colour_map::magnitude
+																					: flow_view::colour_map::hsv);
+							break;
+						case SDLK_g:
+							show_sheets = !show_sheets;
+							// The sheets fill up again from the frames shown from now on
+							frames.clear();
+							flows.clear();
+							break;
+						case SDLK_v:
+							display.set_swap_interval(display.get_swap_interval() == 0 ? 1 : 0);
+							break;
+						/* t runs the stages one after another on this thread, for debugging */
+						case SDLK_t:
+							toggle_deterministic = true;
+							break;
+						case SDLK_r:
+							if(display.is_recording())
+							{
+								display.stop_recording();
+								camera_recorder.reset();
+							}
+							else
+							{
+								display.start_recording("dense_optical_flow.avi", camera_fps);
+								camera_recorder = std::make_unique<frame_recorder>("dense_optical_flow_camera.avi", camera_fps);
+							}
+							break;
+						default:
+							break;
+					}
+				}
+				if(display.quit_requested())
+				{
+					running = false;
+				}
+			},
+			task_graph::placement::caller);
+
+		graph.set_serial(decode);
+		graph.depend(gray, decode);
+		graph.depend(dense, gray);
+		graph.depend(dense, gray, 1);
+		graph.depend(present, dense);
+		graph.set_serial(present);
+		slots.resize(graph.get_slot_count());
+
+		while(running)
+		{
+			graph.submit();
+			if(toggle_deterministic)
+			{
+				toggle_deterministic = false;
+				graph.set_deterministic(!graph.is_deterministic());
+				spdlog::info("Stages run {}", graph.is_deterministic() ? "one after another" : "in parallel");
+			}
+		}
+		graph.wait();
+		spdlog::debug("Up to {} frames were in flight", graph.get_peak_in_flight());
+	}
+	catch(std::exception &e)
 	{
-		Mat frame2, next;
-		capture >> frame2;
-		if(frame2.empty())
-			break;
-		cvtColor(frame2, next, COLOR_BGR2GRAY);
-		Mat flow(prvs.size(), CV_32FC2);
-		calcOpticalFlowFarneback(prvs, next, flow, 0.5, 3, 15, 3, 5, 1.2, 0);
-		// visualization
-		Mat flow_parts[2];
-		split(flow, flow_parts);
-		Mat magnitude, angle, magn_norm;
-		cartToPolar(flow_parts[0], flow_parts[1], magnitude, angle, true);
-		normalize(magnitude, magn_norm, 0.0f, 1.0f, NORM_MINMAX);
-		angle *= ((1.f / 360.f) * (180.f / 255.f));
-		//build hsv image
-		Mat _hsv[3], hsv, hsv8, bgr;
-		_hsv[0] = angle;
-		_hsv[1] = Mat::ones(angle.size(), CV_32F);
-		_hsv[2] = magn_norm;
-		merge(_hsv, 3, hsv);
-		hsv.convertTo(hsv8, CV_8U, 255.0);
-		cvtColor(hsv8, bgr, COLOR_HSV2BGR);
-		imshow("frame2", bgr);
-		int keyboard = waitKey(30);
-		if(keyboard == 'q' || keyboard == 27)
-			break;
-		prvs = next;
+		spdlog::error("Error: {}", e.what());
+		return -1;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,464 @@
+#include "flow_batch.h"
+
+#include "core/flow_runner.h"
+#include "core/parallel_runtime.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/*
+ * Dense flow of many clips, several at once on one thread_pool under a core and a memory budget.
+ * Every clip gets a directory of .flo files and/or a visualization video under the output directory.
+ * A finished clip is appended to flow_batch.journal there with the name of its outputs and the
+ * outputs, method and scale it was run with. A rerun keeps the journalled names. A run that was interrupted (Ctrl+C) or killed skips the clips journalled with the same
+ * options when it is started again and redoes only the unfinished ones.
+ * The aggregate throughput is logged at the end and every clip's is written to flow_batch.csv.
+ */
+
+struct options
+{
+	std::string input; // directory of videos or manifest
+	std::string output;
+	flow_runner::method method = flow_runner::method::farneback;
+	bool write_flow			   = true;
+	bool write_video		   = false;
+	std::size_t threads		   = 0; // cores used in all, 0 - every hardware thread
+	std::size_t clips		   = 0; // clips at once, 0 - a quarter of the threads
+	std::size_t memory		   = 2048; // MB for the pairs in flight of all clips, 0 - unbounded
+	float max_magnitude		   = 16.0f;
+};
+
+struct clip
+{
+	std::string input;
+	std::string name; // of the clip's outputs
+};
+
+/* A clip of the journal */
+struct journal_entry
+{
+	std::string name; // of the clip's outputs
+	std::string key;  // journal_key of the options it was run with
+};
+
+struct clip_report
+{
+	enum class status
+	{
+		skipped, // finished by an earlier run
+		done,
+		failed,
+		left // not started or stopped before the end
+	};
+
+	status state = status::left;
+	flow_runner::result result;
+};
+
+std::atomic<bool> stop_requested(false);
+
+extern "C" void request_stop(int)
+{
+	stop_requested = true;
+}
+
+void print_usage()
+{
+	spdlog::info("Usage: flow_batch -i <directory or manifest> -o <directory> [options]");
+	spdlog::info("  -i, --input <path>        directory of videos, or a manifest listing one video per line");
+	spdlog::info("  -o, --output <dir>        outputs, journal and report, a rerun resumes from the journal");
+	spdlog::info("  -w, --write <what>        flow, video or both, default flow");
+	spdlog::info("  -m, --method <name>       farneback or dis, default farneback");
+	spdlog::info("  -t, --threads <count>     cores to use in all, default every hardware thread");
+	spdlog::info("  -c, --clips <count>       clips processed at once, default a quarter of the threads");
+	spdlog::info("  -M, --memory <MB>         memory of the frame pairs in flight, 0 - unbounded, default 2048");
+	spdlog::info("  -s, --scale <pixels>      flow magnitude shown at full brightness, default 16");
+}
+
+options parse_options(int argc, char *argv[])
+{
+	options result;
+	for(int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if((argument == "-i" || argument == "--input") && i + 1 < argc)
+		{
+			result.input = argv[++i];
+		}
+		else if((argument == "-o" || argument == "--output") && i + 1 < argc)
+		{
+			result.output = argv[++i];
+		}
+		else if((argument == "-w" || argument == "--write") && i + 1 < argc)
+		{
+			std::string what = argv[++i];
+			if(what != "flow" && what != "video" && what != "both")
+			{
+				print_usage();
+				throw std::runtime_error("Unknown output " + what);
+			}
+			result.write_flow  = what != "video";
+			result.write_video = what != "flow";
+		}
+		else if((argument == "-m" || argument == "--method") && i + 1 < argc)
+		{
+			std::string method = argv[++i];
+			if(method == "farneback")
+			{
+				result.method = flow_runner::method::farneback;
+			}
+			else if(method == "dis")
+			{
+				result.method = flow_runner::method::dis;
+			}
+			else
+			{
+				print_usage();
+				throw std::runtime_error("Unknown method " + method);
+			}
+		}
+		else if((argument == "-t" || argument == "--threads") && i + 1 < argc)
+		{
+			result.threads = static_cast<std::size_t>(std::max(1, std::stoi(argv[++i])));
+		}
+		else if((argument == "-c" || argument == "--clips") && i + 1 < argc)
+		{
+			result.clips = static_cast<std::size_t>(std::max(1, std::stoi(argv[++i])));
+		}
+		else if((argument == "-M" || argument == "--memory") && i + 1 < argc)
+		{
+			result.memory = static_cast<std::size_t>(std::max(0, std::stoi(argv[++i])));
+		}
+		else if((argument == "-s" || argument == "--scale") && i + 1 < argc)
+		{
+			result.max_magnitude = std::max(0.01f, std::stof(argv[++i]));
+		}
+		else
+		{
+			print_usage();
+			throw std::runtime_error("Unknown option " + argument);
+		}
+	}
+
+	if(result.input.empty() || result.output.empty())
+	{
+		print_usage();
+		throw std::runtime_error("Input and output are required");
+	}
+	return result;
+}
+
+bool is_video(const fs::path &path)
+{
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension == ".avi" || extension == ".mp4" || extension == ".mkv" || extension == ".mov" || extension == ".webm"
+		   || extension == ".m4v" || extension == ".mpg" || extension == ".mpeg";
+}
+
+/* What a clip's outputs depend on: the outputs written, the method and the scale, tab separated */
+std::string journal_key(const options &settings)
+{
+	std::string outputs = settings.write_flow && settings.write_video ? "both" : settings.write_video ? "video" : "flow";
+	std::string method	= settings.method == flow_runner::method::dis ? "dis" : "farneback";
+	return outputs + '\t' + method + '\t' + std::to_string(settings.max_magnitude);
+}
+
+/* Clips finished by earlier runs by input, with the name of their outputs and the journal_key they
+   were run with. A journal line is input, name, outputs, method, scale, pairs and seconds, tab separated */
+std::map<std::string, journal_entry> read_journal(const fs::path &path)
+{
+	std::map<std::string, journal_entry> finished;
+	std::ifstream journal(path);
+	std::string line;
+	while(std::getline(journal, line))
+	{
+		std::vector<std::string> fields;
+		for(std::size_t start = 0;;)
+		{
+			std::size_t tab = line.find('\t', start);
+			fields.push_back(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+			if(tab == std::string::npos)
+			{
+				break;
+			}
+			start = tab + 1;
+		}
+		// A line cut short by a crash, or written before the options were journalled, doesn't count.
+		// A clip run again with other options is journalled again, its last line is the one that holds
+		if(fields.size() == 7)
+		{
+			finished[fields[0]] = journal_entry {fields[1], fields[2] + '\t' + fields[3] + '\t' + fields[4]};
+		}
+	}
+	return finished;
+}
+
+/* The videos of a directory, sorted, or the lines of a manifest. Manifest paths are relative to
+   the manifest, empty lines and lines starting with # are skipped. Journalled clips keep the
+   name of their outputs */
+std::vector<clip> collect_clips(const std::string &input, const std::map<std::string, journal_entry> &journalled)
+{
+	std::vector<std::string> paths;
+	if(fs::is_directory(input))
+	{
+		for(const fs::directory_entry &entry : fs::directory_iterator(input))
+		{
+			if(entry.is_regular_file() && is_video(entry.path()))
+			{
+				paths.push_back(entry.path().string());
+			}
+		}
+		std::sort(paths.begin(), paths.end());
+	}
+	else
+	{
+		std::ifstream manifest(input);
+		if(!manifest)
+		{
+			throw std::runtime_error("Can't open " + input);
+		}
+		fs::path base = fs::path(input).parent_path();
+		std::string line;
+		while(std::getline(manifest, line))
+		{
+			line.erase(0, line.find_first_not_of(" \t"));
+			line.erase(line.find_last_not_of(" \t\r") + 1);
+			if(line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+			fs::path path(line);
+			paths.push_back(path.is_relative() ? (base / path).string() : path.string());
+		}
+	}
+
+	// Outputs are named after the clips, clips of the same name in different directories get a number.
+	// The names in the journal are taken first, a clip added since can't take over a finished clip's outputs
+	std::set<std::string> names;
+	for(const auto &entry : journalled)
+	{
+		names.insert(entry.second.name);
+	}
+
+	std::vector<clip> clips;
+	for(const std::string &path : paths)
+	{
+		auto journal_line = journalled.find(path);
+		if(journal_line != journalled.end())
+		{
+			clips.push_back({path, journal_line->second.name});
+			continue;
+		}
+
+		std::string stem = fs::path(path).stem().string();
+		std::string name = stem;
+		for(int n = 2; !names.insert(name).second; n++)
+		{
+			name = stem + "_" + std::to_string(n);
+		}
+		clips.push_back({path, name});
+	}
+	return clips;
+}
+
+const char *status_name(clip_report::status state)
+{
+	switch(state)
+	{
+		case clip_report::status::skipped:
+			return "skipped";
+		case clip_report::status::done:
+			return "done";
+		case clip_report::status::failed:
+			return "failed";
+		default:
+			return "left";
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		options settings = parse_options(argc, argv);
+
+		fs::create_directories(settings.output);
+		const fs::path journal_path = fs::path(settings.output) / "flow_batch.journal";
+
+		const std::string key = journal_key(settings);
+		std::map<std::string, journal_entry> finished = read_journal(journal_path);
+		std::vector<clip> clips = collect_clips(settings.input, finished);
+		std::vector<clip_report> reports(clips.size());
+		std::vector<std::size_t> todo;
+		for(std::size_t i = 0; i < clips.size(); i++)
+		{
+			// Outputs asked for now may not have been written by a run with other options
+			auto journalled = finished.find(clips[i].input);
+			if(journalled != finished.end() && journalled->second.key == key)
+			{
+				reports[i].state = clip_report::status::skipped;
+			}
+			else
+			{
+				todo.push_back(i);
+			}
+		}
+		spdlog::info("{} clips, {} finished before, {} to do", clips.size(), clips.size() - todo.size(), todo.size());
+
+		/* Every clip decodes on a thread of its own, the pool gets the rest of the cores.
+		   A pair's OpenCV loops stay on its worker, the pairs of all clips are the parallelism */
+		const std::size_t cores = settings.threads > 0 ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+		const std::size_t clips_at_once =
+			std::min(std::max<std::size_t>(1, todo.size()), settings.clips > 0 ? settings.clips : std::max<std::size_t>(1, cores / 4));
+		thread_pool pool(cores > clips_at_once ? cores - clips_at_once : 1);
+		parallel_runtime runtime(pool, 1);
+		flow_runner runner(pool, settings.memory * 1024 * 1024);
+		spdlog::info("{} clips at once, {} pool threads, {} MB for the pairs in flight", clips_at_once, pool.get_thread_count(), settings.memory);
+
+		std::signal(SIGINT, request_stop);
+		std::signal(SIGTERM, request_stop);
+
+		std::mutex journal_mutex;
+		std::ofstream journal(journal_path, std::ios::app);
+		if(!journal)
+		{
+			throw std::runtime_error("Can't open " + journal_path.string());
+		}
+		std::size_t completed = 0;
+
+		std::atomic<std::size_t> next(0);
+		auto drive = [&]()
+		{
+			for(;;)
+			{
+				std::size_t position = next.fetch_add(1);
+				if(position >= todo.size() || stop_requested)
+				{
+					return;
+				}
+				const clip &current  = clips[todo[position]];
+				clip_report &report = reports[todo[position]];
+
+				flow_runner::options clip_settings;
+				clip_settings.input			  = current.input;
+				clip_settings.method		  = settings.method;
+				clip_settings.max_magnitude	  = settings.max_magnitude;
+				clip_settings.pairs_in_flight = std::max<std::size_t>(2, 2 * pool.get_thread_count() / clips_at_once);
+				if(settings.write_flow)
+				{
+					clip_settings.archive = (fs::path(settings.output) / current.name).string();
+				}
+				if(settings.write_video)
+				{
+					clip_settings.video = (fs::path(settings.output) / (current.name + ".avi")).string();
+				}
+
+				try
+				{
+					report.result = runner.run(clip_settings, &stop_requested);
+				}
+				catch(const std::exception &e)
+				{
+					spdlog::error("{}: {}", current.input, e.what());
+					report.state = clip_report::status::failed;
+					continue;
+				}
+				if(!report.result.completed)
+				{
+					continue;
+				}
+
+				// Journalled only once all of its outputs are written
+				report.state = clip_report::status::done;
+				std::lock_guard<std::mutex> lock(journal_mutex);
+				journal << current.input << '\t' << current.name << '\t' << key << '\t' << report.result.pairs << '\t' << report.result.seconds << std::endl;
+				completed++;
+				spdlog::info(
+					"[{}/{}] {}: {}x{}, {} pairs, {:.1f} pairs/s",
+					completed,
+					todo.size(),
+					current.name,
+					report.result.width,
+					report.result.height,
+					report.result.pairs,
+					report.result.pairs / std::max(report.result.seconds, 1e-9));
+			}
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> drivers;
+		for(std::size_t i = 0; i < clips_at_once; i++)
+		{
+			drivers.emplace_back(drive);
+		}
+		for(std::thread &driver : drivers)
+		{
+			driver.join();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::ofstream csv(fs::path(settings.output) / "flow_batch.csv", std::ios::trunc);
+		csv << "clip,status,width,height,pairs,seconds,pairs_per_second\n";
+		std::size_t pairs = 0, failed = 0, left = 0;
+		double megapixels = 0.0;
+		for(std::size_t i = 0; i < clips.size(); i++)
+		{
+			const flow_runner::result &result = reports[i].result;
+			csv << '"' << clips[i].input << "\"," << status_name(reports[i].state) << ',' << result.width << ',' << result.height << ','
+				<< result.pairs << ',' << result.seconds << ',' << (result.seconds > 0.0 ? result.pairs / result.seconds : 0.0) << '\n';
+
+			pairs += result.pairs;
+			megapixels += static_cast<double>(result.pairs) * result.width * result.height / 1e6;
+			failed += reports[i].state == clip_report::status::failed ? 1 : 0;
+			left += reports[i].state == clip_report::status::left ? 1 : 0;
+		}
+
+		spdlog::info(
+			"{} clips done, {} finished before, {} failed, {} left",
+			completed,
+			clips.size() - todo.size(),
+			failed,
+			left);
+		spdlog::info(
+			"{} pairs in {:.1f} s: {:.1f} pairs/s, {:.1f} megapixels/s",
+			pairs,
+			seconds,
+			pairs / std::max(seconds, 1e-9),
+			megapixels / std::max(seconds, 1e-9));
+		spdlog::info("Pairs in flight took up to {} MB", runner.get_peak_memory() / (1024 * 1024));
+		if(left > 0)
+		{
+			spdlog::info("Stopped early, run again with the same output to resume");
+		}
+		if(failed > 0)
+		{
+			return -1;
+		}
+	}
+	catch(const std::exception &e)
+	{
+		spdlog::error("Error: {}", e.what());
+		return -1;
+	}
+
+	return 0;
+}
\ No newline at end of file
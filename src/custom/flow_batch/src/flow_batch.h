@@ -0,0 +1,4 @@
+#ifndef FLOW_BATCH_H
+#define FLOW_BATCH_H
+
+#endif // FLOW_BATCH_H
\ No newline at end of file
@@ -0,0 +1,304 @@
+#include "multi_stream.h"
+
+#include "core/frame_pool.h"
+#include "core/parallel_runtime.h"
+#include "core/presenter.h"
+#include "core/stream_scheduler.h"
+#include "core/thread_pool.h"
+#include "core/track_renderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+#include <opencv2/videoio.hpp>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Sparse optical flow of several cameras and video files in one process.
+ * All streams share one thread_pool, OpenCV's loops included, and a stream_scheduler keeps their
+ * share of it fair. A stream only owns its capture, three pooled frames and its tracker state.
+ * Keys 1-9 raise or lower the priority of a stream, s logs the scheduler's statistics.
+ */
+
+/* Corners tracked per stream and frames a track stays on screen, a stream's track ring holds
+   no more than that */
+constexpr int max_corners			= 100;
+constexpr unsigned int trail_frames = 30;
+
+struct segment
+{
+	cv::Point2f from, to;
+	std::size_t colour;
+};
+
+struct video_stream
+{
+	std::string name;
+	cv::VideoCapture capture;
+	int width = 0, height = 0;
+	stream_scheduler::stream id = 0;
+
+	// Newest tracked frame for the display, older ones go back to the pool unseen
+	std::unique_ptr<frame_pool> frames;
+	std::unique_ptr<frame_mailbox> latest;
+
+	// Tracker state, only touched by the stream's jobs, which never run at the same time
+	cv::Mat previous_gray;
+	std::vector<cv::Point2f> points;
+	std::vector<std::size_t> colours;
+	std::size_t next_colour = 0;
+
+	// Segments of the newest tracked frame
+	std::mutex segments_mutex;
+	std::vector<segment> segments;
+
+	std::atomic<bool> busy {false};
+	std::atomic<bool> ended {false};
+};
+
+/* One frame of a stream: read, convert and track, then hand the frame to the display */
+void track_frame(video_stream &stream)
+{
+	frame_handle frame = stream.frames->try_acquire();
+	if(!frame)
+	{
+		return;
+	}
+	if(!stream.capture.read(*frame) || frame->empty())
+	{
+		spdlog::info("Stream {} ended", stream.name);
+		stream.ended = true;
+		return;
+	}
+
+	cv::Mat gray;
+	cv::cvtColor(*frame, gray, cv::COLOR_BGR2GRAY);
+
+	std::vector<segment> tracked;
+	if(!stream.previous_gray.empty() && !stream.points.empty())
+	{
+		std::vector<cv::Point2f> next;
+		std::vector<uchar> status;
+		std::vector<float> err;
+		cv::TermCriteria criteria = cv::TermCriteria((cv::TermCriteria::COUNT) + (cv::TermCriteria::EPS), 10, 0.03);
+		cv::calcOpticalFlowPyrLK(stream.previous_gray, gray, stream.points, next, status, err, cv::Size(15, 15), 2, criteria);
+
+		std::vector<cv::Point2f> kept;
+		std::vector<std::size_t> kept_colours;
+		for(std::size_t i = 0; i < next.size(); i++)
+		{
+			if(status[i] == 1)
+			{
+				tracked.push_back({stream.points[i], next[i], stream.colours[i]});
+				kept.push_back(next[i]);
+				kept_colours.push_back(stream.colours[i]);
+			}
+		}
+		stream.points  = std::move(kept);
+		stream.colours = std::move(kept_colours);
+	}
+
+	// Lost most of the corners, look for new ones
+	if(stream.points.size() < 10)
+	{
+		cv::goodFeaturesToTrack(gray, stream.points, max_corners, 0.3, 7, cv::Mat(), 7, false, 0.04);
+		stream.colours.clear();
+		for(std::size_t i = 0; i < stream.points.size(); i++)
+		{
+			stream.colours.push_back(stream.next_colour++);
+		}
+	}
+	stream.previous_gray = gray;
+
+	{
+		std::lock_guard<std::mutex> lock(stream.segments_mutex);
+		stream.segments = std::move(tracked);
+	}
+	stream.latest->publish(std::move(frame));
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> sources;
+	for(int i = 1; i < argc; i++)
+	{
+		sources.push_back(argv[i]);
+	}
+	if(sources.empty())
+	{
+		spdlog::info("Usage: multi_stream <camera index or video file>...");
+		sources.push_back("0");
+	}
+
+	try
+	{
+		// One set of threads for every stream and for OpenCV
+		thread_pool pool;
+		parallel_runtime runtime(pool);
+		// Outlives the scheduler, which waits for the jobs referring to the streams
+		std::vector<std::unique_ptr<video_stream>> streams;
+		stream_scheduler scheduler(pool);
+
+		for(const std::string &source : sources)
+		{
+			auto stream	 = std::make_unique<video_stream>();
+			stream->name = source;
+			bool camera	 = !source.empty() && std::all_of(source.begin(), source.end(), [](char c) { return c >= '0' && c <= '9'; });
+			if(camera ? !stream->capture.open(std::stoi(source)) : !stream->capture.open(source))
+			{
+				spdlog::error("Can't open {}", source);
+				continue;
+			}
+
+			stream->width  = std::max(1, static_cast<int>(stream->capture.get(cv::CAP_PROP_FRAME_WIDTH)));
+			stream->height = std::max(1, static_cast<int>(stream->capture.get(cv::CAP_PROP_FRAME_HEIGHT)));
+			spdlog::info("Stream {}: {}x{}", source, stream->width, stream->height);
+
+			// One frame being tracked, one waiting in the mailbox, one on the screen
+			stream->frames = std::make_unique<frame_pool>(3, stream->height, stream->width, CV_8UC3);
+			stream->latest = std::make_unique<frame_mailbox>(*stream->frames);
+
+			stream_scheduler::stream_options options;
+			options.name = source;
+			stream->id	 = scheduler.add_stream(options);
+			streams.push_back(std::move(stream));
+		}
+		if(streams.empty())
+		{
+			return -1;
+		}
+
+		// Streams are tiled in a grid of one window
+		std::size_t columns = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(streams.size()))));
+		std::size_t rows	= (streams.size() + columns - 1) / columns;
+		presenter display("Multi-stream optical flow", columns, rows, 480, 360);
+
+		std::vector<std::unique_ptr<track_renderer>> tracks;
+		std::vector<bool> shown(streams.size(), false);
+		for(const auto &stream : streams)
+		{
+			tracks.push_back(std::make_unique<track_renderer>(display.get_window().get_shaders(), trail_frames * max_corners));
+			tracks.back()->set_image_size(stream->width, stream->height);
+			tracks.back()->set_trail_length(trail_frames);
+		}
+
+		std::vector<cv::Scalar> colours;
+		cv::RNG rng;
+		for(int i = 0; i < 64; i++)
+		{
+			colours.push_back(cv::Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256)));
+		}
+
+		auto log_statistics = [&]()
+		{
+			for(const auto &stream : streams)
+			{
+				stream_scheduler::statistics statistics = scheduler.get_statistics(stream->id);
+				spdlog::info(
+					"Stream {}: priority {}, {} frames, busy {} ms, {} us per frame, {} frames replaced unseen",
+					stream->name,
+					scheduler.get_options(stream->id).priority,
+					statistics.completed,
+					statistics.busy.count() / 1000,
+					statistics.average.count(),
+					stream->latest->get_replaced_count());
+			}
+			spdlog::info("{} batches ran {} jobs", scheduler.get_batch_count(), scheduler.get_batched_job_count());
+		};
+
+		while(!display.quit_requested())
+		{
+			// Every idle stream tracks its next frame, a stream never has more than one job queued
+			bool running = false;
+			for(const auto &stream : streams)
+			{
+				if(stream->ended)
+				{
+					continue;
+				}
+				running = true;
+				if(!stream->busy.exchange(true))
+				{
+					video_stream *target = stream.get();
+					scheduler.submit(
+						stream->id,
+						[target]()
+						{
+							track_frame(*target);
+							target->busy = false;
+						});
+				}
+			}
+			if(!running)
+			{
+				break;
+			}
+
+			for(std::size_t i = 0; i < streams.size(); i++)
+			{
+				video_stream &stream   = *streams[i];
+				track_renderer &trails = *tracks[i];
+				if(frame_handle frame = stream.latest->take())
+				{
+					display.show(i, *frame);
+					shown[i] = true;
+
+					trails.next_frame();
+					std::lock_guard<std::mutex> lock(stream.segments_mutex);
+					for(const segment &tracked : stream.segments)
+					{
+						const cv::Scalar &colour = colours[tracked.colour % colours.size()];
+						trails.add_segment(tracked.to, tracked.from, colour);
+						trails.add_marker(tracked.to, 4, -1, colour);
+					}
+				}
+				else if(shown[i])
+				{
+					display.redraw(i, i);
+				}
+				else
+				{
+					continue;
+				}
+				trails.draw_tracks();
+				trails.draw_markers();
+			}
+			display.present();
+
+			for(SDL_Keycode key : display.poll())
+			{
+				if(key >= SDLK_1 && key <= SDLK_9 && static_cast<std::size_t>(key - SDLK_1) < streams.size())
+				{
+					const video_stream &stream = *streams[key - SDLK_1];
+					int priority				= scheduler.get_options(stream.id).priority == 0 ? 1 : 0;
+					scheduler.set_priority(stream.id, priority);
+					spdlog::info("Stream {}: priority {}", stream.name, priority);
+				}
+				else if(key == SDLK_s)
+				{
+					log_statistics();
+				}
+			}
+		}
+
+		scheduler.wait();
+		log_statistics();
+	}
+	catch(std::exception &e)
+	{
+		spdlog::error("Error: {}", e.what());
+		return -1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,4 @@
+#ifndef MULTI_STREAM_H
+#define MULTI_STREAM_H
+
+#endif // MULTI_STREAM_H
\ No newline at end of file
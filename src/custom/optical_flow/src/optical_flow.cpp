@@ -1,37 +1,81 @@
 #include "optical_flow.h"
 
+#include "core/frame_pipeline.h"
+#include "core/presenter.h"
+#include "core/thread_pool.h"
+#include "core/track_renderer.h"
+
+#include <chrono>
 #include <exception>
 #include <opencv2/core.hpp>
 #include <opencv2/core/types.hpp>
-#include <opencv2/highgui.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/opencv.hpp>
+#include <optional>
 #include <spdlog/spdlog.h>
 #include <vector>
 
-bool BOOL_EXIT = false;
+/* Luma of a raw YUYV frame, or of a BGR frame from cameras OpenCV converts. Two-channel frames
+   are only kept raw when the camera reports YUYV, see track() */
+void to_gray(const cv::Mat &frame, cv::Mat &gray)
+{
+	if(frame.type() == CV_8UC2)
+	{
+		cv::extractChannel(frame, gray, 0);
+	}
+	else
+	{
+		cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+	}
+}
 
-int main()
+struct tracked_frame
 {
-	/* Default video capture device */
-	cv::VideoCapture video_capture_device(0);
+	cv::Mat gray;
+	std::vector<cv::Point2f> points;
+	std::vector<uchar> status;
+};
 
-	if(video_capture_device.isOpened() == false)
+/* Camera frames are read on the pool one ahead, gray and LK run on the pool, the window on this thread */
+pipeline_task<int> track(pipeline_loop &loop, thread_pool &pool, cv::VideoCapture &capture)
+{
+	/* Raw YUYV frames go to the GPU as they are and their luma is all the tracking needs,
+	   no colour conversion is done on the CPU. Other two-channel formats (UYVY) have the luma
+	   elsewhere and are left to OpenCV's conversion */
+	const int fourcc = static_cast<int>(capture.get(cv::CAP_PROP_FOURCC));
+	bool raw_yuyv	 = fourcc == cv::VideoWriter::fourcc('Y', 'U', 'Y', 'V') || fourcc == cv::VideoWriter::fourcc('Y', 'U', 'Y', '2');
+	if(raw_yuyv)
 	{
-		spdlog::error("Cannot open the video camera.");
-		BOOL_EXIT = true;
+		capture.set(cv::CAP_PROP_CONVERT_RGB, 0);
 	}
 
-	/* Print width and height of the capture device frame */
-	spdlog::info(
-		"Resolution of the capture device frame: {}x{}",
-		video_capture_device.get(cv::CAP_PROP_FRAME_WIDTH),
-		video_capture_device.get(cv::CAP_PROP_FRAME_HEIGHT));
+	// Frames that waited longer than this while we were busy aren't tracked
+	auto frames = camera_frames(loop, pool, capture, std::chrono::milliseconds(100));
 
-	//std::string window_name = "OpenCV colour object detection";
+	std::optional<pipeline_frame> first;
+	do
+	{
+		first = co_await frames.next();
+	} while(first && !first->is_ok());
 
-	//cv::namedWindow(window_name);
+	// Raw frames that aren't YUYV after all are converted to BGR by OpenCV as before
+	if(raw_yuyv && first && first->image.type() != CV_8UC2 && first->image.type() != CV_8UC3)
+	{
+		raw_yuyv = false;
+		frames	 = camera_frames(loop, pool, capture, std::chrono::milliseconds(100));
+		capture.set(cv::CAP_PROP_CONVERT_RGB, 1);
+		do
+		{
+			first = co_await frames.next();
+		} while(first && !first->is_ok());
+	}
+
+	if(!first)
+	{
+		spdlog::error("Can't read a frame from the camera.");
+		co_return -1;
+	}
 
 	// Create some random colors
 	std::vector<cv::Scalar> colors;
@@ -44,98 +88,117 @@ int main()
 		colors.push_back(cv::Scalar(r, g, b));
 	}
 
-	cv::Mat old_frame, old_gray;
-	std::vector<cv::Point2f> p0, p1;
-
-	// Take first frame and find corners in it
-	// video_capture_device.read(old_frame);
-	video_capture_device >> old_frame;
-	if(old_frame.empty())
-	{
-		while(!old_frame.empty())
-		{
-			try
-			{
-				video_capture_device >> old_frame;
-			}
-			catch(...)
-			{
-				spdlog::info("Processing");
-			}
-		}
-	}
-	cv::cvtColor(old_frame, old_gray, cv::COLOR_BGR2GRAY);
+	// Find corners in the first frame
+	cv::Mat old_gray;
+	std::vector<cv::Point2f> p0;
+	to_gray(first->image, old_gray);
 	goodFeaturesToTrack(old_gray, p0, 100, 0.3, 7, cv::Mat(), 7, false, 0.04);
 
-	// Create a mask image for drawing purposes
-	cv::Mat mask = cv::Mat::zeros(old_frame.size(), old_frame.type());
+	/* Camera and tracks are tiled in one window, tracks are drawn on the GPU */
+	presenter display("Optical flow", 2, 1, first->image.cols, first->image.rows);
+	track_renderer tracks(display.get_window().get_shaders());
+	tracks.set_image_size(first->image.cols, first->image.rows);
 
-	while(!BOOL_EXIT)
+	while(auto frame = co_await frames.next())
 	{
-		cv::Mat frame;
-		cv::Mat frame_gray;
-
-		// if(!video_capture_device.read(frame))
-		// {
-		// 	spdlog::error("Can't read the frame from a camera.");
-		// 	BOOL_EXIT = true;
-		// }
-
-		try
+		if(!frame->is_ok())
 		{
-			video_capture_device >> frame;
-			if(frame.empty())
-			{
-				continue;
-			}
-		}
-		catch(std::exception &e)
-		{
-			spdlog::error("Error: {}", e.what());
 			continue;
 		}
 
-		cvtColor(frame, frame_gray, cv::COLOR_BGR2GRAY);
-
 		// calculate optical flow
-		std::vector<uchar> status;
-		std::vector<float> err;
-		cv::TermCriteria criteria = cv::TermCriteria((cv::TermCriteria::COUNT) + (cv::TermCriteria::EPS), 10, 0.03);
-		cv::calcOpticalFlowPyrLK(old_gray, frame_gray, p0, p1, status, err, cv::Size(15, 15), 2, criteria);
+		tracked_frame tracked = co_await loop.spawn(
+			pool,
+			[&]()
+			{
+				tracked_frame result;
+				std::vector<float> err;
+				to_gray(frame->image, result.gray);
+				cv::TermCriteria criteria = cv::TermCriteria((cv::TermCriteria::COUNT) + (cv::TermCriteria::EPS), 10, 0.03);
+				cv::calcOpticalFlowPyrLK(old_gray, result.gray, p0, result.points, result.status, err, cv::Size(15, 15), 2, criteria);
+				return result;
+			});
+
+		tracks.next_frame();
 
 		std::vector<cv::Point2f> good_new;
-		for(uint i = 0; i < p0.size(); i++)
+		for(std::size_t i = 0; i < p0.size(); i++)
 		{
 			// Select good points
-			if(status[i] == 1)
+			if(tracked.status[i] == 1)
 			{
-				good_new.push_back(p1[i]);
+				good_new.push_back(tracked.points[i]);
 				// draw the tracks
-				line(mask, p1[i], p0[i], colors[i], 2);
-				circle(frame, p1[i], 5, colors[i], -1);
+				tracks.add_segment(tracked.points[i], p0[i], colors[i]);
+				tracks.add_marker(tracked.points[i], 5, -1, colors[i]);
 			}
-			else
-				continue;
 		}
 
-		cv::Mat img;
-		add(frame, mask, img);
-
 		/* We are showing the result */
-		cv::imshow("Window 1", frame);
-		cv::imshow("Window 2", img);
+		if(raw_yuyv && frame->image.type() == CV_8UC2)
+		{
+			display.show(0, frame->image, image_view::yuv_layout::yuyv);
+		}
+		else
+		{
+			display.show(0, frame->image);
+		}
+		tracks.draw_markers();
+		display.redraw(1, 0);
+		tracks.draw_markers();
+		tracks.draw_tracks();
+		display.present();
 
-		if(cv::waitKey(10) == 27)
+		for(SDL_Keycode key : display.poll())
+		{
+			if(key == SDLK_v)
+			{
+				display.set_swap_interval(display.get_swap_interval() == 0 ? 1 : 0);
+				spdlog::info("Swap interval: {}", display.get_swap_interval());
+			}
+		}
+
+		if(display.quit_requested())
 		{
 			spdlog::info("Esc key is pressed by user.");
 			spdlog::info("Stoppig the application.");
-			BOOL_EXIT = true;
+			break;
 		}
 
 		// Now update the previous frame and previous points
-		old_gray = frame_gray.clone();
+		old_gray = tracked.gray;
 		p0		 = good_new;
 	}
 
-	return 0;
+	co_return 0;
+}
+
+int main()
+{
+	/* Default video capture device */
+	cv::VideoCapture video_capture_device(0);
+
+	if(video_capture_device.isOpened() == false)
+	{
+		spdlog::error("Cannot open the video camera.");
+		return -1;
+	}
+
+	/* Print width and height of the capture device frame */
+	spdlog::info(
+		"Resolution of the capture device frame: {}x{}",
+		video_capture_device.get(cv::CAP_PROP_FRAME_WIDTH),
+		video_capture_device.get(cv::CAP_PROP_FRAME_HEIGHT));
+
+	try
+	{
+		thread_pool pool;
+		pipeline_loop loop;
+		return loop.run(track(loop, pool, video_capture_device));
+	}
+	catch(std::exception &e)
+	{
+		spdlog::error("Error: {}", e.what());
+		return -1;
+	}
 }
\ No newline at end of file
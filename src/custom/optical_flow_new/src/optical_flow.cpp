@@ -1,12 +1,15 @@
 #include "optical_flow.h"
 
+#include "core/presenter.h"
+#include "core/track_renderer.h"
+
 #include <algorithm>
 #include <cstddef>
 #include <exception>
+#include <memory>
 #include <opencv2/core.hpp>
 #include <opencv2/core/matx.hpp>
 #include <opencv2/core/types.hpp>
-#include <opencv2/highgui.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/opencv.hpp>
@@ -94,8 +97,20 @@ int main()
 	cv::cvtColor(old_frame, old_gray, cv::COLOR_BGR2GRAY);
 	goodFeaturesToTrack(old_gray, p0, 100, 0.3, 7, cv::Mat(), 7, false, 0.04);
 
-	// Create a mask image for drawing purposes
-	cv::Mat mask = cv::Mat::zeros(old_frame.size(), old_frame.type());
+	/* Camera and tracks are tiled in one window, the objects are drawn on the GPU */
+	std::unique_ptr<presenter> display;
+	std::unique_ptr<track_renderer> tracks;
+	try
+	{
+		display = std::make_unique<presenter>("Optical flow", 2, 1, old_frame.cols, old_frame.rows);
+		tracks	= std::make_unique<track_renderer>(display->get_window().get_shaders());
+		tracks->set_image_size(old_frame.cols, old_frame.rows);
+	}
+	catch(std::exception &e)
+	{
+		spdlog::error("Error: {}", e.what());
+		return -1;
+	}
 
 	// Objects
 	// struct point
@@ -132,8 +147,6 @@ int main()
 		objects.push_back(random_circle);
 	}
 
-	int time = 0;
-
 	while(!BOOL_EXIT)
 	{
 		try
@@ -147,17 +160,10 @@ int main()
 
 				cv::cvtColor(old_frame, old_gray, cv::COLOR_BGR2GRAY);
 				goodFeaturesToTrack(old_gray, p0, 100, 0.3, 7, cv::Mat(), 7, false, 0.04);
-
-				// Create a mask image for drawing purposes
-				cv::Mat mask = cv::Mat::zeros(old_frame.size(), old_frame.type());
 			}
 
-			if(time > 60)
-			// if(time > 0)
-			{
-				time = 0;
-				mask = cv::Mat::zeros(old_frame.size(), old_frame.type());
-			}
+			/* Drops the objects' markers of the previous frame */
+			tracks->next_frame();
 
 			// if(p0.size() >= 2)
 			// {
@@ -276,9 +282,6 @@ int main()
 			// 	throw std::runtime_error("We do not have any good points");
 			// }
 
-			cv::Mat img;
-			add(frame, mask, img);
-
 			// // Objects
 			// for(std::size_t i = 0; i < objects.size(); i++)
 			// {
@@ -303,14 +306,25 @@ int main()
 			{
 				//Color of the circle
 				cv::Scalar line_color(255, 255, 255);
-				cv::circle(frame, {objects[i].x, objects[i].y}, circle_radius, line_color, 4, 8);
+				tracks->add_marker(cv::Point2f(objects[i].x, objects[i].y), circle_radius, 4, line_color);
 			}
 
-			/* We are showing the result */
-			cv::imshow("Window 1", frame);
-			cv::imshow("Window 2", img);
+			/* We are showing the result, the objects over the camera only */
+			display->show(0, frame);
+			tracks->draw_markers();
+			display->redraw(1, 0);
+			display->present();
+
+			for(SDL_Keycode key : display->poll())
+			{
+				if(key == SDLK_v)
+				{
+					display->set_swap_interval(display->get_swap_interval() == 0 ? 1 : 0);
+					spdlog::info("Swap interval: {}", display->get_swap_interval());
+				}
+			}
 
-			if(cv::waitKey(10) == 27)
+			if(display->quit_requested())
 			{
 				spdlog::info("Esc key is pressed by user.");
 				spdlog::info("Stoppig the application.");
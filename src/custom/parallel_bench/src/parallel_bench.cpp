@@ -0,0 +1,229 @@
+#include "parallel_bench.h"
+
+#include "core/parallel_runtime.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <memory>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video.hpp>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Frame latency of a dense flow stage while background stages load the machine, once with every
+ * library and stage on its own threads and once with all of them on one thread_pool where every
+ * stage's OpenCV loops keep to a budget of their own.
+ */
+
+struct options
+{
+	int frames		   = 300;
+	int load		   = 0; // background stages, 0 - half the hardware threads
+	bool pin		   = false;
+	std::size_t budget = 0; // threads of the flow stage, 0 - the rest of the machine
+};
+
+struct latency
+{
+	double p50, p95, p99, max;
+	double background_rate; // background iterations per second
+};
+
+void print_usage()
+{
+	spdlog::info("Usage: parallel_bench [options]");
+	spdlog::info("  -f, --frames <count>   frames timed per run, default 300");
+	spdlog::info("  -l, --load <stages>    background stages, default half the hardware threads");
+	spdlog::info("  -b, --budget <threads> threads of the flow stage on the pool, default the rest");
+	spdlog::info("  -p, --pin              pin the pool's workers to cores");
+}
+
+options parse_options(int argc, char *argv[])
+{
+	options result;
+	for(int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if((argument == "-f" || argument == "--frames") && i + 1 < argc)
+		{
+			result.frames = std::max(1, std::stoi(argv[++i]));
+		}
+		else if((argument == "-l" || argument == "--load") && i + 1 < argc)
+		{
+			result.load = std::max(0, std::stoi(argv[++i]));
+		}
+		else if((argument == "-b" || argument == "--budget") && i + 1 < argc)
+		{
+			result.budget = static_cast<std::size_t>(std::max(0, std::stoi(argv[++i])));
+		}
+		else if(argument == "-p" || argument == "--pin")
+		{
+			result.pin = true;
+		}
+		else
+		{
+			print_usage();
+			throw std::runtime_error("Unknown option " + argument);
+		}
+	}
+	return result;
+}
+
+/* One background stage iteration, a large blur like a decode or resize stage would do */
+void background_work(cv::Mat &image, cv::Mat &blurred)
+{
+	cv::GaussianBlur(image, blurred, cv::Size(15, 15), 0.0);
+}
+
+/* Time the flow of frames synthetic frame pairs while run_background keeps the background stages
+   busy. flow_budget - threads of the flow stage's loops, 0 - whatever OpenCV is set up with */
+template<typename F>
+latency measure(int frames, std::size_t flow_budget, F &&run_background)
+{
+	cv::Mat previous(480, 640, CV_8UC1), next, flow;
+	cv::randu(previous, 0, 255);
+	cv::GaussianBlur(previous, previous, cv::Size(7, 7), 0.0);
+
+	std::atomic<bool> stop(false);
+	std::atomic<std::size_t> iterations(0);
+	auto background_start = std::chrono::steady_clock::now();
+	auto background		  = run_background(stop, iterations);
+
+	std::unique_ptr<parallel_runtime::stage_scope> flow_stage;
+	if(flow_budget > 0)
+	{
+		flow_stage = std::make_unique<parallel_runtime::stage_scope>(flow_budget);
+	}
+
+	std::vector<double> times;
+	for(int i = -10; i < frames; i++)
+	{
+		// The scene moves by a pixel every frame
+		double translation[] = {1.0, 0.0, 1.0, 0.0, 1.0, 0.0};
+		cv::Mat shift(2, 3, CV_64F, translation);
+		cv::warpAffine(previous, next, shift, previous.size(), cv::INTER_LINEAR, cv::BORDER_REFLECT);
+
+		auto start = std::chrono::steady_clock::now();
+		cv::calcOpticalFlowFarneback(previous, next, flow, 0.5, 3, 15, 3, 5, 1.2, 0);
+		if(i >= 0)
+		{
+			times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		previous = next.clone();
+	}
+
+	stop = true;
+	for(auto &stage : background)
+	{
+		stage.wait();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - background_start).count();
+
+	std::sort(times.begin(), times.end());
+	auto percentile = [&](double p) { return times[std::min(times.size() - 1, static_cast<std::size_t>(p * times.size()))]; };
+	return latency {percentile(0.50), percentile(0.95), percentile(0.99), times.back(), iterations / seconds};
+}
+
+void report(const char *name, const latency &result)
+{
+	spdlog::info(
+		"{:<10} p50 {:7.3f} ms  p95 {:7.3f} ms  p99 {:7.3f} ms  max {:7.3f} ms  background {:.1f} it/s",
+		name,
+		result.p50,
+		result.p95,
+		result.p99,
+		result.max,
+		result.background_rate);
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		options settings		= parse_options(argc, argv);
+		std::size_t hardware	= std::max(2u, std::thread::hardware_concurrency());
+		std::size_t load		= settings.load > 0 ? static_cast<std::size_t>(settings.load) : hardware / 2;
+		std::size_t flow_budget = settings.budget > 0 ? settings.budget : std::max<std::size_t>(1, hardware - std::min(load, hardware - 1));
+
+		spdlog::info("{} hardware threads, {} background stages, {} frames", hardware, load, settings.frames);
+
+		// Every stage on its own threads and OpenCV on its own pool, as the tools used to run
+		latency separate = measure(
+			settings.frames,
+			0,
+			[&](std::atomic<bool> &stop, std::atomic<std::size_t> &iterations)
+			{
+				std::vector<std::future<void>> stages;
+				for(std::size_t i = 0; i < load; i++)
+				{
+					stages.push_back(std::async(
+						std::launch::async,
+						[&]()
+						{
+							cv::Mat image(1080, 1920, CV_8UC3, cv::Scalar(64, 128, 192)), blurred;
+							while(!stop)
+							{
+								background_work(image, blurred);
+								iterations++;
+							}
+						}));
+				}
+				return stages;
+			});
+		report("separate", separate);
+
+		// One pool: every background stage keeps its loops to its own worker, the flow stage's
+		// loops get the rest. The budgets are per stage, the runtime's own is the whole pool
+		std::vector<int> cores;
+		for(std::size_t i = 0; settings.pin && i < hardware; i++)
+		{
+			cores.push_back(static_cast<int>(i));
+		}
+		latency unified;
+		{
+			thread_pool pool(hardware, cores);
+			parallel_runtime runtime(pool);
+			unified = measure(
+				settings.frames,
+				flow_budget,
+				[&](std::atomic<bool> &stop, std::atomic<std::size_t> &iterations)
+				{
+					std::vector<std::future<void>> stages;
+					for(std::size_t i = 0; i < load; i++)
+					{
+						stages.push_back(pool.submit(
+							[&]()
+							{
+								parallel_runtime::stage_scope background_stage(1);
+								cv::Mat image(1080, 1920, CV_8UC3, cv::Scalar(64, 128, 192)), blurred;
+								while(!stop)
+								{
+									background_work(image, blurred);
+									iterations++;
+								}
+							}));
+					}
+					return stages;
+				});
+			spdlog::info("Pool: {} tasks stolen, OpenCV loops {}", pool.get_steal_count(), parallel_runtime::is_routed() ? "routed" : "only capped");
+		}
+		report("unified", unified);
+
+		return 0;
+	}
+	catch(const std::exception &e)
+	{
+		spdlog::error("Error: {}", e.what());
+	}
+
+	return 1;
+}
\ No newline at end of file
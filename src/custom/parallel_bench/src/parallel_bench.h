@@ -0,0 +1,4 @@
+#ifndef PARALLEL_BENCH_H
+#define PARALLEL_BENCH_H
+
+#endif // PARALLEL_BENCH_H
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include "queue_bench.h"
+
+#include "core/frame_pool.h"
+#include "core/frame_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <queue>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Frames handed from producer to consumer threads through a mutex guarded std::queue of freshly
+ * allocated cv::Mat, the way stages used to pass them, and through the lock-free queues carrying
+ * handles of a frame_pool. Every producer writes its frames and every consumer reads them.
+ */
+
+struct options
+{
+	int frames	 = 200000; // per producer
+	int threads	 = 4;	   // producers and consumers each in the many-to-many runs
+	int capacity = 64;
+};
+
+void print_usage()
+{
+	spdlog::info("Usage: queue_bench [options]");
+	spdlog::info("  -f, --frames <count>    frames per producer, default 200000");
+	spdlog::info("  -t, --threads <count>   producers and consumers of the many-to-many runs, default 4");
+	spdlog::info("  -c, --capacity <count>  queue capacity and pooled frames, default 64");
+}
+
+options parse_options(int argc, char *argv[])
+{
+	options result;
+	for(int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if((argument == "-f" || argument == "--frames") && i + 1 < argc)
+		{
+			result.frames = std::max(1, std::stoi(argv[++i]));
+		}
+		else if((argument == "-t" || argument == "--threads") && i + 1 < argc)
+		{
+			result.threads = std::max(1, std::stoi(argv[++i]));
+		}
+		else if((argument == "-c" || argument == "--capacity") && i + 1 < argc)
+		{
+			result.capacity = std::max(2, std::stoi(argv[++i]));
+		}
+		else
+		{
+			print_usage();
+			throw std::runtime_error("Unknown option " + argument);
+		}
+	}
+	return result;
+}
+
+/* Frames small enough that the hand-over, not the copy, is measured */
+const int frame_rows = 120;
+const int frame_cols = 160;
+const int frame_type = CV_8UC3;
+
+/* Start producers and consumers together, each loops until its share is done.
+   produce(i) and consume() return false when they couldn't move a frame and have to retry */
+double run(int producers, int consumers, int frames, const std::function<bool(int)> &produce, const std::function<bool()> &consume)
+{
+	std::atomic<long long> remaining(static_cast<long long>(producers) * frames);
+	std::atomic<bool> go(false);
+	std::vector<std::thread> threads;
+
+	for(int p = 0; p < producers; p++)
+	{
+		threads.emplace_back(
+			[&, p]()
+			{
+				while(!go)
+				{
+					std::this_thread::yield();
+				}
+				for(int i = 0; i < frames;)
+				{
+					if(produce(i))
+					{
+						i++;
+					}
+					else
+					{
+						std::this_thread::yield();
+					}
+				}
+			});
+	}
+	for(int c = 0; c < consumers; c++)
+	{
+		threads.emplace_back(
+			[&]()
+			{
+				while(!go)
+				{
+					std::this_thread::yield();
+				}
+				while(remaining.load(std::memory_order_relaxed) > 0)
+				{
+					if(consume())
+					{
+						remaining.fetch_sub(1, std::memory_order_relaxed);
+					}
+					else
+					{
+						std::this_thread::yield();
+					}
+				}
+			});
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	go		   = true;
+	for(std::thread &thread : threads)
+	{
+		thread.join();
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const char *name, int producers, int consumers, long long frames, double seconds)
+{
+	spdlog::info(
+		"{:<8} {}:{}  {:10.0f} frames/s  {:8.1f} ns/frame",
+		name,
+		producers,
+		consumers,
+		frames / seconds,
+		seconds * 1e9 / frames);
+}
+
+/* A new Mat per frame, shared through a bounded std::queue under a mutex */
+void bench_mutex(const options &settings, int producers, int consumers)
+{
+	std::mutex mutex;
+	std::queue<cv::Mat> queue;
+	std::atomic<unsigned> checksum(0);
+
+	double seconds = run(
+		producers,
+		consumers,
+		settings.frames,
+		[&](int i)
+		{
+			cv::Mat frame(frame_rows, frame_cols, frame_type);
+			frame.data[0] = static_cast<unsigned char>(i);
+			std::lock_guard<std::mutex> lock(mutex);
+			if(queue.size() >= static_cast<std::size_t>(settings.capacity))
+			{
+				return false;
+			}
+			queue.push(std::move(frame));
+			return true;
+		},
+		[&]()
+		{
+			cv::Mat frame;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if(queue.empty())
+				{
+					return false;
+				}
+				frame = std::move(queue.front());
+				queue.pop();
+			}
+			checksum.fetch_add(frame.data[0], std::memory_order_relaxed);
+			return true;
+		});
+	report("mutex", producers, consumers, static_cast<long long>(producers) * settings.frames, seconds);
+}
+
+/* Pooled frames through a lock-free queue, the consumer's handle gives the frame back */
+template<typename Q>
+void bench_pooled(const char *name, const options &settings, int producers, int consumers)
+{
+	// The queue's frames plus one being written per producer and one being read per consumer
+	frame_pool pool(settings.capacity + producers + consumers, frame_rows, frame_cols, frame_type);
+	Q queue(settings.capacity);
+	std::atomic<unsigned> checksum(0);
+
+	double seconds = run(
+		producers,
+		consumers,
+		settings.frames,
+		[&](int i)
+		{
+			frame_handle frame = pool.try_acquire();
+			if(!frame)
+			{
+				return false;
+			}
+			frame->data[0] = static_cast<unsigned char>(i);
+			// A failed push leaves the frame in the handle, it goes back to the pool
+			return queue.try_push(std::move(frame));
+		},
+		[&]()
+		{
+			frame_handle frame;
+			if(!queue.try_pop(frame))
+			{
+				return false;
+			}
+			checksum.fetch_add(frame->data[0], std::memory_order_relaxed);
+			return true;
+		});
+	report(name, producers, consumers, static_cast<long long>(producers) * settings.frames, seconds);
+
+	if(pool.get_free_count() != pool.get_frame_count())
+	{
+		throw std::runtime_error(std::string(name) + ": frames weren't given back to the pool");
+	}
+}
+
+/* A producer as fast as it can go and a display taking the latest frame every millisecond */
+void bench_mailbox(const options &settings)
+{
+	frame_pool pool(3, frame_rows, frame_cols, frame_type);
+	frame_mailbox mailbox(pool);
+	std::atomic<bool> done(false);
+	std::size_t shown = 0;
+
+	std::thread display(
+		[&]()
+		{
+			while(!done)
+			{
+				if(frame_handle frame = mailbox.take())
+				{
+					shown++;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < settings.frames;)
+	{
+		frame_handle frame = pool.try_acquire();
+		if(!frame)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		frame->data[0] = static_cast<unsigned char>(i++);
+		mailbox.publish(std::move(frame));
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	done		   = true;
+	display.join();
+
+	spdlog::info(
+		"mailbox  1:1  {:10.0f} frames/s  {} shown, {} replaced unread",
+		settings.frames / seconds,
+		shown,
+		mailbox.get_replaced_count());
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		options settings = parse_options(argc, argv);
+		spdlog::info("{} frames per producer, {}x{} frames, capacity {}", settings.frames, frame_cols, frame_rows, settings.capacity);
+
+		bench_mutex(settings, 1, 1);
+		bench_pooled<spsc_queue<frame_handle>>("spsc", settings, 1, 1);
+		bench_pooled<mpmc_queue<frame_handle>>("mpmc", settings, 1, 1);
+		bench_mutex(settings, settings.threads, settings.threads);
+		bench_pooled<mpmc_queue<frame_handle>>("mpmc", settings, settings.threads, settings.threads);
+		bench_mailbox(settings);
+
+		return 0;
+	}
+	catch(const std::exception &e)
+	{
+		spdlog::error("Error: {}", e.what());
+	}
+
+	return 1;
+}
\ No newline at end of file
@@ -0,0 +1,4 @@
+#ifndef QUEUE_BENCH_H
+#define QUEUE_BENCH_H
+
+#endif // QUEUE_BENCH_H
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include "block_compression.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	/* 4x4 RGBA8 block starting at (x, y), clamped to the image */
+	void fetch_block(const std::uint8_t *rgba, int width, int height, int x, int y, std::uint8_t block[64])
+	{
+		for(int row = 0; row < 4; row++)
+		{
+			int source_y = std::min(y + row, height - 1);
+			for(int column = 0; column < 4; column++)
+			{
+				int source_x			 = std::min(x + column, width - 1);
+				const std::uint8_t *from = rgba + (static_cast<std::size_t>(source_y) * width + source_x) * 4;
+				std::copy(from, from + 4, block + (row * 4 + column) * 4);
+			}
+		}
+	}
+
+	std::uint16_t pack_565(const float colour[3])
+	{
+		int r = std::clamp(static_cast<int>(std::lround(colour[0] * 31.0f / 255.0f)), 0, 31);
+		int g = std::clamp(static_cast<int>(std::lround(colour[1] * 63.0f / 255.0f)), 0, 63);
+		int b = std::clamp(static_cast<int>(std::lround(colour[2] * 31.0f / 255.0f)), 0, 31);
+		return static_cast<std::uint16_t>(r << 11 | g << 5 | b);
+	}
+
+	void unpack_565(std::uint16_t packed, int colour[3])
+	{
+		int r	  = packed >> 11 & 31;
+		int g	  = packed >> 5 & 63;
+		int b	  = packed & 31;
+		colour[0] = r << 3 | r >> 2;
+		colour[1] = g << 2 | g >> 4;
+		colour[2] = b << 3 | b >> 2;
+	}
+
+	void write_le(std::uint8_t *output, std::uint64_t value, int bytes)
+	{
+		for(int i = 0; i < bytes; i++)
+		{
+			output[i] = static_cast<std::uint8_t>(value >> (i * 8));
+		}
+	}
+
+	/* Four colour BC1 block, 8 bytes */
+	void encode_colour_block(const std::uint8_t block[64], std::uint8_t *output)
+	{
+		float mean[3] = {0.0f, 0.0f, 0.0f};
+		for(int i = 0; i < 16; i++)
+		{
+			for(int c = 0; c < 3; c++)
+			{
+				mean[c] += block[i * 4 + c];
+			}
+		}
+		for(int c = 0; c < 3; c++)
+		{
+			mean[c] /= 16.0f;
+		}
+
+		// Covariance of the block colours
+		float covariance[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f}; // rr rg rb gg gb bb
+		for(int i = 0; i < 16; i++)
+		{
+			float r = block[i * 4 + 0] - mean[0];
+			float g = block[i * 4 + 1] - mean[1];
+			float b = block[i * 4 + 2] - mean[2];
+			covariance[0] += r * r;
+			covariance[1] += r * g;
+			covariance[2] += r * b;
+			covariance[3] += g * g;
+			covariance[4] += g * b;
+			covariance[5] += b * b;
+		}
+
+		// Principal axis by power iteration, starting from the luminance direction
+		float axis[3] = {0.299f, 0.587f, 0.114f};
+		for(int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[3] = {
+				covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+				covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+				covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]};
+			float length = std::max({std::fabs(next[0]), std::fabs(next[1]), std::fabs(next[2])});
+			if(length < 1e-6f)
+			{
+				break;
+			}
+			for(int c = 0; c < 3; c++)
+			{
+				axis[c] = next[c] / length;
+			}
+		}
+
+		float axis_length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		float low		  = 0.0f;
+		float high		  = 0.0f;
+		for(int i = 0; i < 16; i++)
+		{
+			float projection = 0.0f;
+			for(int c = 0; c < 3; c++)
+			{
+				projection += (block[i * 4 + c] - mean[c]) * axis[c];
+			}
+			low	 = std::min(low, projection);
+			high = std::max(high, projection);
+		}
+
+		// Inset the endpoints by 1/16 of the range, the extremes are mostly reached by the interpolated colours
+		float inset = (high - low) / 16.0f;
+		low += inset;
+		high -= inset;
+
+		float first[3];
+		float second[3];
+		for(int c = 0; c < 3; c++)
+		{
+			first[c]  = mean[c] + axis[c] * high / axis_length;
+			second[c] = mean[c] + axis[c] * low / axis_length;
+		}
+
+		std::uint16_t colour0 = pack_565(first);
+		std::uint16_t colour1 = pack_565(second);
+
+		// colour0 > colour1 selects the four colour mode
+		if(colour0 < colour1)
+		{
+			std::swap(colour0, colour1);
+		}
+
+		std::uint32_t indices = 0;
+		if(colour0 != colour1)
+		{
+			int palette[4][3];
+			unpack_565(colour0, palette[0]);
+			unpack_565(colour1, palette[1]);
+			for(int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for(int i = 0; i < 16; i++)
+			{
+				int best		  = 0;
+				int best_distance = 0x7FFFFFFF;
+				for(int p = 0; p < 4; p++)
+				{
+					int distance = 0;
+					for(int c = 0; c < 3; c++)
+					{
+						int delta = block[i * 4 + c] - palette[p][c];
+						distance += delta * delta;
+					}
+					if(distance < best_distance)
+					{
+						best_distance = distance;
+						best		  = p;
+					}
+				}
+				indices |= static_cast<std::uint32_t>(best) << (i * 2);
+			}
+		}
+
+		write_le(output, colour0, 2);
+		write_le(output + 2, colour1, 2);
+		write_le(output + 4, indices, 4);
+	}
+
+	/* Eight value BC3 alpha block, 8 bytes */
+	void encode_alpha_block(const std::uint8_t block[64], std::uint8_t *output)
+	{
+		int alpha0 = 0;
+		int alpha1 = 255;
+		for(int i = 0; i < 16; i++)
+		{
+			alpha0 = std::max<int>(alpha0, block[i * 4 + 3]);
+			alpha1 = std::min<int>(alpha1, block[i * 4 + 3]);
+		}
+
+		std::uint64_t indices = 0;
+		if(alpha0 != alpha1)
+		{
+			// Palette order is alpha0, alpha1, then six interpolated values from alpha0 towards alpha1
+			int palette[8] = {alpha0, alpha1};
+			for(int p = 1; p < 7; p++)
+			{
+				palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+			}
+
+			for(int i = 0; i < 16; i++)
+			{
+				int best		  = 0;
+				int best_distance = 256;
+				for(int p = 0; p < 8; p++)
+				{
+					int distance = std::abs(block[i * 4 + 3] - palette[p]);
+					if(distance < best_distance)
+					{
+						best_distance = distance;
+						best		  = p;
+					}
+				}
+				indices |= static_cast<std::uint64_t>(best) << (i * 3);
+			}
+		}
+
+		output[0] = static_cast<std::uint8_t>(alpha0);
+		output[1] = static_cast<std::uint8_t>(alpha1);
+		write_le(output + 2, indices, 6);
+	}
+
+	template<std::size_t block_bytes, typename Encoder>
+	void compress_blocks(const std::uint8_t *rgba, int width, int height, std::uint8_t *blocks, Encoder encode)
+	{
+		std::uint8_t block[64];
+		for(int y = 0; y < height; y += 4)
+		{
+			for(int x = 0; x < width; x += 4)
+			{
+				fetch_block(rgba, width, height, x, y, block);
+				encode(block, blocks);
+				blocks += block_bytes;
+			}
+		}
+	}
+} // namespace
+
+void compress_bc1(const std::uint8_t *rgba, int width, int height, std::uint8_t *blocks)
+{
+	compress_blocks<8>(rgba, width, height, blocks, encode_colour_block);
+}
+
+void compress_bc3(const std::uint8_t *rgba, int width, int height, std::uint8_t *blocks)
+{
+	compress_blocks<16>(rgba, width, height, blocks, [](const std::uint8_t *block, std::uint8_t *output) {
+		encode_alpha_block(block, output);
+		encode_colour_block(block, output + 8);
+	});
+}
\ No newline at end of file
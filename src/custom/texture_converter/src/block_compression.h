@@ -0,0 +1,18 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <cstdint>
+
+/*
+ * Real-time BC1 (DXT1) and BC3 (DXT5) block encoder.
+ * Colour endpoints are fitted along the principal axis of each 4x4 block, alpha
+ * endpoints are the block's alpha range. Quality is below offline encoders, speed is not.
+ *
+ * rgba - tightly packed RGBA8 pixels, width * height * 4 bytes
+ * blocks - output, ((width + 3) / 4) * ((height + 3) / 4) blocks of 8 (BC1) or 16 (BC3) bytes
+ * Edge blocks of sizes that aren't a multiple of 4 repeat the last row and column.
+ */
+void compress_bc1(const std::uint8_t *rgba, int width, int height, std::uint8_t *blocks);
+void compress_bc3(const std::uint8_t *rgba, int width, int height, std::uint8_t *blocks);
+
+#endif // BLOCK_COMPRESSION_H
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include "texture_converter.h"
+
+#include "block_compression.h"
+#include "core/raw_image.h"
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <gli/gli.hpp>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+enum class target_format
+{
+	automatic, // bc3 if the image has an alpha channel, bc1 otherwise
+	rgba8,
+	bc1,
+	bc3
+};
+
+struct options
+{
+	target_format format  = target_format::automatic;
+	std::string container = "ktx";
+	bool mipmaps		  = true;
+	bool force			  = false;
+	fs::path input;
+	fs::path output;
+};
+
+void print_usage()
+{
+	spdlog::info("Usage: texture_converter [options] <input file or directory> <output directory>");
+	spdlog::info("  -f, --format <auto|rgba8|bc1|bc3>  target format, default auto");
+	spdlog::info("  -c, --container <ktx|dds|lyr>      output container, default ktx, lyr is raw RGBA8");
+	spdlog::info("  --no-mipmaps                       write the base level only");
+	spdlog::info("  --force                            convert files that are up to date");
+}
+
+options parse_options(int argc, char *argv[])
+{
+	options result;
+	std::vector<std::string> positional;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if((argument == "-f" || argument == "--format") && i + 1 < argc)
+		{
+			std::string value = argv[++i];
+			if(value == "auto")
+				result.format = target_format::automatic;
+			else if(value == "rgba8")
+				result.format = target_format::rgba8;
+			else if(value == "bc1")
+				result.format = target_format::bc1;
+			else if(value == "bc3")
+				result.format = target_format::bc3;
+			else
+				throw std::runtime_error("Unknown format: " + value);
+		}
+		else if((argument == "-c" || argument == "--container") && i + 1 < argc)
+		{
+			result.container = argv[++i];
+			if(result.container != "ktx" && result.container != "dds" && result.container != "lyr")
+			{
+				throw std::runtime_error("Unknown container: " + result.container);
+			}
+		}
+		else if(argument == "--no-mipmaps")
+		{
+			result.mipmaps = false;
+		}
+		else if(argument == "--force")
+		{
+			result.force = true;
+		}
+		else
+		{
+			positional.push_back(argument);
+		}
+	}
+
+	if(positional.size() != 2)
+	{
+		print_usage();
+		throw std::runtime_error("Expected an input and an output path");
+	}
+
+	result.input  = positional[0];
+	result.output = positional[1];
+	return result;
+}
+
+bool is_image_file(const fs::path &path)
+{
+	std::string extension = path.extension().string();
+	for(char &c : extension)
+	{
+		c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+	return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".bmp" ||
+		   extension == ".tga" || extension == ".tif" || extension == ".tiff";
+}
+
+gli::format to_gli_format(target_format format)
+{
+	switch(format)
+	{
+		case target_format::rgba8:
+			return gli::FORMAT_RGBA8_UNORM_PACK8;
+		case target_format::bc1:
+			return gli::FORMAT_RGB_DXT1_UNORM_BLOCK8;
+		case target_format::bc3:
+			return gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16;
+		default:
+			throw std::runtime_error("Format has no gli equivalent");
+	}
+}
+
+/* Returns the number of bytes written */
+std::uintmax_t convert_file(const fs::path &input, const fs::path &output, const options &settings)
+{
+	cv::Mat source = read_image(input.string());
+	if(source.depth() != CV_8U)
+	{
+		source.convertTo(source, CV_8U, source.depth() == CV_16U ? 1.0 / 257.0 : 1.0);
+	}
+
+	// Raw images are uploaded without decoding, format and mipmaps don't apply
+	if(settings.container == "lyr")
+	{
+		fs::create_directories(output.parent_path());
+		raw_image::write(output.string(), source);
+		return fs::file_size(output);
+	}
+
+	target_format format = settings.format;
+	if(format == target_format::automatic)
+	{
+		format = source.channels() == 4 ? target_format::bc3 : target_format::bc1;
+	}
+
+	cv::Mat rgba;
+	switch(source.channels())
+	{
+		case 1:
+			cv::cvtColor(source, rgba, cv::COLOR_GRAY2RGBA);
+			break;
+		case 3:
+			cv::cvtColor(source, rgba, cv::COLOR_BGR2RGBA);
+			break;
+		default:
+			cv::cvtColor(source, rgba, cv::COLOR_BGRA2RGBA);
+			break;
+	}
+
+	// Levels are stored top row first like any KTX/DDS file, the loaders flip them
+
+	gli::texture2d::extent_type extent(rgba.cols, rgba.rows);
+	gli::texture2d texture(to_gli_format(format), extent, settings.mipmaps ? gli::levels(extent) : 1);
+
+	cv::Mat level_image = rgba;
+	for(std::size_t level = 0; level < texture.levels(); level++)
+	{
+		gli::texture2d::extent_type level_extent = texture.extent(level);
+		if(level > 0)
+		{
+			// Each level from the base, INTER_AREA averages all covered texels
+			cv::resize(rgba, level_image, cv::Size(level_extent.x, level_extent.y), 0, 0, cv::INTER_AREA);
+		}
+		if(!level_image.isContinuous())
+		{
+			level_image = level_image.clone();
+		}
+
+		std::uint8_t *destination = static_cast<std::uint8_t *>(texture.data(0, 0, level));
+		switch(format)
+		{
+			case target_format::rgba8:
+				std::memcpy(destination, level_image.data, level_image.total() * level_image.elemSize());
+				break;
+			case target_format::bc1:
+				compress_bc1(level_image.data, level_image.cols, level_image.rows, destination);
+				break;
+			default:
+				compress_bc3(level_image.data, level_image.cols, level_image.rows, destination);
+				break;
+		}
+	}
+
+	fs::create_directories(output.parent_path());
+	if(!gli::save(texture, output.string()))
+	{
+		throw std::runtime_error("Can't write " + output.string());
+	}
+
+	return fs::file_size(output);
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		options settings = parse_options(argc, argv);
+
+		// (input, output) pairs, a directory keeps its layout under the output directory
+		std::vector<std::pair<fs::path, fs::path>> jobs;
+		std::string extension = "." + settings.container;
+		if(fs::is_directory(settings.input))
+		{
+			for(const fs::directory_entry &entry : fs::recursive_directory_iterator(settings.input))
+			{
+				if(entry.is_regular_file() && is_image_file(entry.path()))
+				{
+					fs::path relative = fs::relative(entry.path(), settings.input);
+					jobs.emplace_back(entry.path(), (settings.output / relative).replace_extension(extension));
+				}
+			}
+		}
+		else
+		{
+			jobs.emplace_back(settings.input, (settings.output / settings.input.filename()).replace_extension(extension));
+		}
+
+		std::size_t converted	 = 0;
+		std::size_t skipped		 = 0;
+		std::size_t failed		 = 0;
+		std::uintmax_t bytes_in	 = 0;
+		std::uintmax_t bytes_out = 0;
+
+		for(const auto &[input, output] : jobs)
+		{
+			if(!settings.force && fs::exists(output) && fs::last_write_time(output) >= fs::last_write_time(input))
+			{
+				skipped++;
+				continue;
+			}
+
+			try
+			{
+				std::uintmax_t written = convert_file(input, output, settings);
+				bytes_in += fs::file_size(input);
+				bytes_out += written;
+				converted++;
+				spdlog::info("{} -> {} ({} bytes)", input.string(), output.string(), written);
+			}
+			catch(const std::exception &e)
+			{
+				failed++;
+				spdlog::error("Error: {}", e.what());
+			}
+		}
+
+		spdlog::info(
+			"Converted {} files ({} -> {} bytes), {} up to date, {} failed", converted, bytes_in, bytes_out, skipped, failed);
+
+		return failed == 0 ? 0 : 1;
+	}
+	catch(const std::exception &e)
+	{
+		spdlog::error("Error: {}", e.what());
+	}
+
+	return 1;
+}
\ No newline at end of file
@@ -0,0 +1,4 @@
+#ifndef TEXTURE_CONVERTER_H
+#define TEXTURE_CONVERTER_H
+
+#endif // TEXTURE_CONVERTER_H
\ No newline at end of file
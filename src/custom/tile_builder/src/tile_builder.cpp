@@ -0,0 +1,107 @@
+#include "tile_builder.h"
+
+#include "core/raw_image.h"
+#include "core/tiled_image.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <opencv2/core.hpp>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct options
+{
+	int tile_size = 256;
+	std::string input;
+	std::string output;
+};
+
+void print_usage()
+{
+	spdlog::info("Usage: tile_builder [options] <input image> <output .lyt>");
+	spdlog::info("  -t, --tile-size <pixels>  tile side without the border, default 256");
+	spdlog::info("OpenCV refuses images over 2^30 pixels, export OPENCV_IO_MAX_IMAGE_PIXELS=<pixels> for larger panoramas");
+}
+
+options parse_options(int argc, char *argv[])
+{
+	options result;
+	std::vector<std::string> positional;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if((argument == "-t" || argument == "--tile-size") && i + 1 < argc)
+		{
+			result.tile_size = std::stoi(argv[++i]);
+		}
+		else
+		{
+			positional.push_back(argument);
+		}
+	}
+
+	if(positional.size() != 2)
+	{
+		print_usage();
+		throw std::runtime_error("Expected an input and an output path");
+	}
+
+	result.input  = positional[0];
+	result.output = positional[1];
+	return result;
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		options settings = parse_options(argc, argv);
+
+		auto start = std::chrono::steady_clock::now();
+		cv::Mat source;
+		try
+		{
+			source = read_image(settings.input);
+		}
+		catch(const std::exception &e)
+		{
+			// OpenCV reads its pixel limit once when it is loaded, it has to come from the environment
+			if(!std::getenv("OPENCV_IO_MAX_IMAGE_PIXELS"))
+			{
+				throw std::runtime_error(
+					std::string(e.what()) + " (images over 2^30 pixels need OPENCV_IO_MAX_IMAGE_PIXELS exported)");
+			}
+			throw;
+		}
+		if(source.depth() != CV_8U)
+		{
+			source.convertTo(source, CV_8U, source.depth() == CV_16U ? 1.0 / 257.0 : 1.0);
+		}
+
+		tiled_image::write(settings.output, source, settings.tile_size);
+
+		tiled_image result(settings.output);
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+		spdlog::info(
+			"{} -> {}: {}x{}, {} levels of {} px tiles in {} ms",
+			settings.input,
+			settings.output,
+			result.get_width(),
+			result.get_height(),
+			result.get_level_count(),
+			result.get_tile_size(),
+			elapsed.count());
+
+		return 0;
+	}
+	catch(const std::exception &e)
+	{
+		spdlog::error("Error: {}", e.what());
+	}
+
+	return 1;
+}
\ No newline at end of file
@@ -0,0 +1,4 @@
+#ifndef TILE_BUILDER_H
+#define TILE_BUILDER_H
+
+#endif // TILE_BUILDER_H
\ No newline at end of file